@@ -0,0 +1,23 @@
+# Fails if AVR firmware calls soft-float library. Run as script:
+#     cmake -DNM=<path to avr-nm> -DELF=<firmware .elf> -P check_no_float.cmake
+# avr-gcc has no flag to forbid floating point code, so calls of soft-float routines (addition, multiplication,
+# division, comparison and conversions of float) are searched in symbols of the linked firmware.
+if(NOT NM OR NOT ELF)
+    message(FATAL_ERROR "NM and ELF should be set")
+endif()
+
+execute_process(COMMAND "${NM}" "${ELF}"
+                OUTPUT_VARIABLE symbols
+                ERROR_VARIABLE  error
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${NM} failed: ${error}")
+endif()
+
+string(REGEX MATCHALL "__(add|sub|mul|div)sf3|__(cmp|unord|eq|ne|lt|le|gt|ge)sf2|__fix(uns)?sf[sd]i|__float(un)?[sd]isf"
+       float_symbols "${symbols}")
+if(float_symbols)
+    list(REMOVE_DUPLICATES float_symbols)
+    message(FATAL_ERROR "Firmware contains floating point code: ${float_symbols}")
+endif()
+message(STATUS "No floating point code in ${ELF}")
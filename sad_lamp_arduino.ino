@@ -17,41 +17,10 @@ setup()
     lamp_controller.Setup();
 }
 
-void
-print_performance(uint32_t delta)
-{
-    static bool     measurements_started = false;
-    static uint32_t runc_count           = 0;
-    static uint32_t avg_delta            = 0;
-
-    // Start measuring only from 100th iteration
-    if ((++runc_count >= 100) || measurements_started) {
-        if (!measurements_started) {
-            runc_count           = 1;
-            measurements_started = true;
-        }
-
-        avg_delta += delta;
-    }
-
-    if ((runc_count & 0x7FFF) == 0) {
-        Serial.print(F("Main loop execution time: "));
-        Serial.print(avg_delta / runc_count);
-        Serial.print(F(" us"));
-        Serial.println();
-
-        avg_delta  = 0;
-        runc_count = 0;
-    }
-}
-
 void
 loop()
 {
-    auto start_time = micros();
     lamp_controller.Loop();
-    // auto delta = micros() - start_time;
-    // print_performance(delta);
 
     // test_dout_30hz_pwm_duty_cycles();
 }
@@ -0,0 +1,204 @@
+#include "config_store.h"
+
+#include <Arduino.h>
+#include <string.h>
+#include <util/crc16.h>
+
+#include "devices/eeprom_map.h"
+
+namespace
+{
+constexpr uint8_t  kVersion{3};
+constexpr uint32_t kQuietPeriodMs{5000};
+constexpr uint32_t kCheckPeriodMs{1000};
+
+struct Slot
+{
+    uint8_t             sequence;
+    uint8_t             version;
+    ConfigStore::Config config;
+    uint16_t            crc;  // Of version and config
+};
+constexpr uint8_t kNumOfSlots{kConfigStoreSize / sizeof(Slot)};
+
+// Layout of legacy_settings_address. Erased cell (0xFF) means that setting was never written
+struct LegacySettings
+{
+    uint8_t  alarm_dow;
+    uint8_t  alarm_minute;
+    uint8_t  alarm_hour;
+    uint8_t  is_alarm_enabled;  // 1 - enabled
+    uint16_t sunrise_duration_min;
+    uint16_t fan_pwm_frequency;
+    uint8_t  fan_pwm_steps_number;
+    uint8_t  dimming_curve;
+};
+static_assert(sizeof(LegacySettings) == kLegacySettingsSize, "Legacy settings should fill their EEPROM area");
+
+static_assert(kNumOfSlots >= 2, "Config store should have at least 2 slots");
+static_assert(sizeof(Timer::AlarmData) == 8, "AlarmData should not have padding bytes, they break comparison");
+static_assert(sizeof(ConfigStore::Config) == sizeof(ThermalController::FanControlSettings) + 2 * sizeof(uint16_t)
+                                                 + sizeof(Timer::AlarmData) * Timer::kMaxNumOfAlarms + 4,
+              "Config should not have padding bytes, they break comparison");
+
+Slot*
+GetSlotAddress(uint8_t slot)
+{
+    return reinterpret_cast<Slot*>(config_store_address) + slot;
+}
+
+uint16_t
+CalculateCrc(const Slot& slot)
+{
+    uint16_t crc{_crc16_update(0xFFFF, slot.version)};
+    auto     data = reinterpret_cast<const uint8_t*>(&slot.config);
+    for (uint8_t i = 0; i < sizeof(slot.config); ++i) {
+        crc = _crc16_update(crc, data[i]);
+    }
+    return crc;
+}
+}  // namespace
+
+ConfigStore::ConfigStore()
+  : config_{}
+  , slot_{kNumOfSlots - 1}
+  , sequence_{0xFF}
+  , is_dirty_{false}
+  , last_update_time_{0}
+{
+}
+
+void
+ConfigStore::Run()
+{
+    if (is_dirty_ && (millis() - last_update_time_ >= kQuietPeriodMs)) {
+        Commit();
+    }
+}
+
+uint32_t
+ConfigStore::GetPeriodMs() const
+{
+    return kCheckPeriodMs;
+}
+
+bool
+ConfigStore::Load(Config& config)
+{
+    // Only sequence numbers are scanned, config itself is read by one block read
+    uint8_t newest{kNumOfSlots - 1};
+    uint8_t sequence{eeprom_read_byte(&GetSlotAddress(0)->sequence)};
+    for (uint8_t slot = 1; slot < kNumOfSlots; ++slot) {
+        uint8_t next_sequence{eeprom_read_byte(&GetSlotAddress(slot)->sequence)};
+        if (next_sequence != static_cast<uint8_t>(sequence + 1)) {
+            newest = slot - 1;
+            break;
+        }
+        sequence = next_sequence;
+    }
+
+    // Normally the newest slot is valid. Older ones are tried in case it was damaged
+    for (uint8_t i = 0; i < kNumOfSlots; ++i) {
+        uint8_t slot = (newest >= i) ? (newest - i) : (newest + kNumOfSlots - i);
+        Config  stored;
+        if (ReadSlot(slot, stored)) {
+            slot_     = slot;
+            sequence_ = eeprom_read_byte(&GetSlotAddress(slot)->sequence);
+            config_   = stored;
+            config    = stored;
+            return true;
+        }
+    }
+
+    // Nothing is valid, so config will be written after the newest slot
+    slot_     = newest;
+    sequence_ = eeprom_read_byte(&GetSlotAddress(newest)->sequence);
+    return false;
+}
+
+void
+ConfigStore::Update(const Config& config)
+{
+    if (memcmp(&config, &config_, sizeof(config_)) == 0) {
+        return;
+    }
+    config_           = config;
+    is_dirty_         = true;
+    last_update_time_ = millis();
+}
+
+bool
+ConfigStore::LoadLegacy(Config& config)
+{
+    LegacySettings legacy;
+    eeprom_read_block(&legacy, legacy_settings_address, sizeof(legacy));
+
+    bool is_found{false};
+    if (legacy.alarm_hour != 0xFF) {
+        config.alarms[0] = Timer::AlarmData{
+            legacy.alarm_hour, legacy.alarm_minute, static_cast<Timer::DaysOfWeek>(legacy.alarm_dow)};
+        is_found = true;
+    }
+    if (legacy.is_alarm_enabled != 0xFF) {
+        config.is_alarm_enabled = (legacy.is_alarm_enabled == 1);
+        is_found                = true;
+    }
+    if (legacy.sunrise_duration_min != 0xFFFF) {
+        config.sunrise_duration_min = legacy.sunrise_duration_min;
+        is_found                    = true;
+    }
+    if (legacy.fan_pwm_frequency != 0xFFFF) {
+        config.fan_pwm_frequency = legacy.fan_pwm_frequency;
+        is_found                 = true;
+    }
+    if (legacy.fan_pwm_steps_number != 0xFF) {
+        config.fan_pwm_steps_number = legacy.fan_pwm_steps_number;
+        is_found                    = true;
+    }
+    if (legacy.dimming_curve != 0xFF) {
+        config.dimming_curve = static_cast<DimmingCurve>(legacy.dimming_curve);
+        is_found             = true;
+    }
+    return is_found;
+}
+
+void
+ConfigStore::Commit()
+{
+    is_dirty_ = false;
+
+    // Config could be changed and then changed back during quiet period
+    Config stored;
+    if (ReadSlot(slot_, stored) && (memcmp(&stored, &config_, sizeof(config_)) == 0)) {
+        return;
+    }
+
+    slot_ = (slot_ + 1 == kNumOfSlots) ? 0 : (slot_ + 1);
+    ++sequence_;
+
+    Slot slot;
+    slot.sequence = sequence_;
+    slot.version  = kVersion;
+    slot.config   = config_;
+    slot.crc      = CalculateCrc(slot);
+
+    // Sequence number is written last, so partially written slot is never treated as the newest one
+    auto address = GetSlotAddress(slot_);
+    eeprom_update_block(&slot.version, &address->version, sizeof(slot) - sizeof(slot.sequence));
+    eeprom_update_byte(&address->sequence, slot.sequence);
+
+    Serial.print(F("Config is stored to EEPROM slot "));
+    Serial.println(slot_);
+}
+
+bool
+ConfigStore::ReadSlot(uint8_t slot, Config& config) const
+{
+    Slot stored;
+    eeprom_read_block(&stored, GetSlotAddress(slot), sizeof(stored));
+    if ((stored.version != kVersion) || (stored.crc != CalculateCrc(stored))) {
+        return false;
+    }
+    config = stored.config;
+    return true;
+}
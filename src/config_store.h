@@ -0,0 +1,63 @@
+#ifndef CONFIG_STORE_H_
+#define CONFIG_STORE_H_
+
+#include <stdint.h>
+
+#include "devices/thermalcontroller.hpp"
+#include "devices/timer.h"
+#include "dimming_curve.h"
+#include "scheduler.h"
+
+// Keeps user settings in EEPROM as one versioned struct protected by CRC-16.
+//
+// EEPROM cell survives ~100000 writes, and WebUI can send a new value many times per second (e.g. while slider is
+// moved). So settings are written only after they have not changed for kQuietPeriodMs, and several changes are
+// coalesced into one write. Config, which is equal to the stored one, is not written at all.
+//
+// Each commit goes to the next slot of a ring, so wear is spread over all slots. Slot is:
+//     <sequence number> <version> <config> <CRC-16 of version and config>
+// Sequence number of each slot is the previous one plus 1, so the newest slot is the one, which is not followed by
+// its successor. Sequence number is written last: if power is lost in the middle of a write, the slot is not
+// recognized as the newest one, and the previous config is used.
+class ConfigStore : public Scheduler::Task
+{
+public:
+    // Struct is stored as is, so any change of it should increment kVersion
+    struct Config
+    {
+        ThermalController::FanControlSettings fan_control;
+        uint16_t                              sunrise_duration_min;
+        uint16_t                              fan_pwm_frequency;  // DoutPwm settings
+        Timer::AlarmData                      alarms[Timer::kMaxNumOfAlarms];
+        bool                                  is_alarm_enabled;
+        DimmingCurve                          dimming_curve;
+        uint8_t                               fan_pwm_steps_number;
+        uint8_t                               reserved;  // Keeps size even, so there is no padding. Always 0
+    };
+
+    ConfigStore();
+    void     Run() override;  // Commits config after quiet period
+    uint32_t GetPeriodMs() const override;
+
+    // Reads the newest valid config. Returns false, if there is no one (EEPROM is erased, or config has other version)
+    bool Load(Config& config);
+    // Schedules commit of config, if it differs from the current one
+    void Update(const Config& config);
+
+    // Firmware before ConfigStore kept alarm, sunrise duration, fan PWM and dimming curve in fixed EEPROM cells. It is
+    // called, when Load() finds no config, e.g. on the first start after upgrade. Overwrites fields of config, which
+    // were written there, and returns false, if there are none. Values are not validated
+    static bool LoadLegacy(Config& config);
+
+private:
+    void Commit();
+    bool ReadSlot(uint8_t slot, Config& config) const;  // Returns false, if CRC or version is wrong
+
+    Config   config_;
+    uint8_t  slot_;      // Slot of the newest stored config
+    uint8_t  sequence_;  // And its sequence number
+    bool     is_dirty_;  // config_ is not committed yet
+    uint32_t last_update_time_;
+};
+
+#endif  // CONFIG_STORE_H_
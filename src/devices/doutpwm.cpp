@@ -1,15 +1,14 @@
 #include "doutpwm.h"
 
 #include <Arduino.h>
-#include "eeprom_map.h"
 
-#include "..\utils.h"
+#include "../utils.h"
 
 DoutPwm::DoutPwm(uint8_t pin1, uint8_t pin2)
   : pin1_{pin1}
   , pin2_{pin2}
-  , frequency_{3}
-  , num_of_steps_{10}
+  , frequency_{kDefaultFrequency}
+  , num_of_steps_{kDefaultNumOfSteps}
   , on_time_us_{0}
   , off_time_us_{0}
   , current_output_signal_{false}
@@ -24,17 +23,6 @@ DoutPwm::Setup()
     pinMode(pin1_, OUTPUT);
     pinMode(pin2_, OUTPUT);
     SetOutput(false);
-
-    uint16_t frequency{eeprom_read_word(&fan_pwm_frequency_address)};
-    SetPwmFrequency(frequency);
-    uint8_t steps_number{eeprom_read_byte(&fan_pwm_steps_number_address)};
-    SetPwmStepsNumber(steps_number);
-
-    Serial.print(F("Read from EEPROM: fan PWM frequency ("));
-    Serial.print(frequency);
-    Serial.print(F(") and steps number ("));
-    Serial.print((int)steps_number);
-    Serial.println(F(")"));
 }
 
 void
@@ -87,11 +75,7 @@ DoutPwm::SetPwmFrequency(const String& str)
     Serial.println(str);
 
     uint16_t frequency{(uint16_t)str.substring(0).toInt()};
-    eeprom_write_word(&fan_pwm_frequency_address, frequency);
     SetPwmFrequency(frequency);
-
-    Serial.print(F("Stored to EEPROM fan PWM frequency "));
-    Serial.println(frequency);
 }
 
 void
@@ -108,11 +92,7 @@ DoutPwm::SetPwmStepsNumber(const String& str)
     Serial.println(str);
 
     uint8_t steps_number{(uint8_t)str.substring(0).toInt()};
-    eeprom_write_byte(&fan_pwm_steps_number_address, steps_number);
     SetPwmStepsNumber(steps_number);
-
-    Serial.print(F("Stored to EEPROM fan PWM steps number "));
-    Serial.println((int)steps_number);
 }
 
 void
@@ -15,6 +15,9 @@
 class DoutPwm : public IComponent
 {
 public:
+    static constexpr uint16_t kDefaultFrequency{3};
+    static constexpr uint8_t  kDefaultNumOfSteps{10};
+
     DoutPwm(uint8_t pin1, uint8_t pin2);
     void Setup() override;
     void Loop();
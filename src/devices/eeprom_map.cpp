@@ -1,9 +1,5 @@
 #include "eeprom_map.h"
 
-uint8_t EEMEM  fan_pwm_steps_number_address;
-uint16_t EEMEM fan_pwm_frequency_address;
-uint16_t EEMEM  sunraise_duration_minutes_address;
-uint8_t EEMEM  is_alarm_on_address;
-uint8_t EEMEM  alarm_hours_address;
-uint8_t EEMEM  alarm_minutes_address;
-uint8_t EEMEM  alarm_dow_address;
+uint8_t EEMEM config_store_address[kConfigStoreSize];
+uint8_t EEMEM thermo_sensors_calibration_address[kThermoSensorsCalibrationTableSize];
+uint8_t EEMEM legacy_settings_address[kLegacySettingsSize];
@@ -6,14 +6,16 @@
 // EEMEM macro will automatically give addresses in EEPROM memory.
 // BUT it will give lower addresses to variables lower in this file
 
-extern uint8_t EEMEM  fan_pwm_steps_number_address;  // 8
-extern uint16_t EEMEM fan_pwm_frequency_address;     // 6-7
+constexpr uint16_t kConfigStoreSize{352};
+constexpr uint8_t  kThermoSensorsCalibrationTableSize{96};
+constexpr uint8_t  kLegacySettingsSize{10};
 
-extern uint16_t EEMEM sunraise_duration_minutes_address;  // 4-5
+extern uint8_t EEMEM config_store_address[kConfigStoreSize];  // 106-457
 
-extern uint8_t EEMEM is_alarm_on_address;    // 3
-extern uint8_t EEMEM alarm_hours_address;    // 2
-extern uint8_t EEMEM alarm_minutes_address;  // 1
-extern uint8_t EEMEM alarm_dow_address;      // 0
+extern uint8_t EEMEM thermo_sensors_calibration_address[kThermoSensorsCalibrationTableSize];  // 10-105
+
+// Alarm, sunrise duration, fan PWM and dimming curve were stored here before ConfigStore. They are moved to ConfigStore
+// on the first start after upgrade, see ConfigStore::LoadLegacy()
+extern uint8_t EEMEM legacy_settings_address[kLegacySettingsSize];  // 0-9
 
 #endif  // EEPROM_MAP_H_
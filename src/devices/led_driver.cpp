@@ -2,80 +2,44 @@
 
 #include <Arduino.h>
 
-#include "eeprom_map.h"
+#include "../utils.h"
 
 namespace
 {
-// TODO: there are many different options on dimming functions:
-//       https://blog.moonsindustries.com/2018/12/02/what-are-dimming-curves-and-how-to-choose/)
-//       Most popular (should try):
-//       1. logarithmyc
-//       2. DALI logarithmic
-//       3. Gamma
-
-constexpr PROGMEM uint16_t brightness_levels[] = {
-    1,   2,   4,   6,   9,   12,  16,  20,  25,  30,  36,  42,  49,  56,  64,  72,  81,  90,  100, 110, 121, 132,
-    144, 156, 169, 182, 196, 210, 225, 240, 256, 272, 289, 306, 324, 342, 361, 380, 400, 420, 441, 462, 484, 506,
-    529, 552, 576, 600, 625, 650, 676, 702, 729, 756, 784, 812, 841, 870, 900, 930, 961, 992, 992, 992};
-constexpr uint8_t num_of_levels{sizeof(brightness_levels) / sizeof(brightness_levels[0])};
-
-// For debugging.
-// constexpr PROGMEM uint16_t brightness_levels[num_of_levels] = {
-//     1,   2,   3,   4,   5,   6,   7,   8,   9,   10,  11,  12,  13,  14,  15,  16,  17,  18,  19,  20,
-//     21,  22,  23,  24,  25,  26,  27,  28,  29,  30,  31,  32,  33,  34,  35,  36,  37,  38,  39,  40,
-//     41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  51,  52,  53,  54,  55,  56,  57,  58,  59,  60,
-//     61,  62,  63,  64,  65,  66,  67,  68,  69,  70,  71,  72,  73,  74,  75,  76,  77,  78,  79,  80,
-//     81,  82,  83,  84,  85,  86,  87,  88,  89,  90,  91,  92,  93,  94,  95,  96,  97,  98,  99,  100,
-//     101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111, 112, 113, 114, 115, 116, 117, 118, 119, 120};
-
-
-// const uint8_t PROGMEM brightness_levels_gamma8_remapped[] = {
-//     0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
-//     0,   0,   0,   0,   0,   0,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,
-//     2,   2,   2,   2,   2,   3,   3,   3,   3,   3,   3,   3,   4,   4,   4,   4,   4,   5,   5,   5,   5,   6,
-//     6,   6,   6,   7,   7,   7,   7,   8,   8,   8,   9,   9,   9,   10,  10,  10,  11,  11,  11,  12,  12,  13,
-//     13,  13,  14,  14,  15,  15,  16,  16,  17,  17,  18,  18,  19,  19,  20,  20,  21,  21,  22,  22,  23,  24,
-//     24,  25,  25,  26,  27,  27,  28,  29,  29,  30,  31,  32,  32,  33,  34,  35,  35,  36,  37,  38,  39,  39,
-//     40,  41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  50,  51,  52,  54,  55,  56,  57,  58,  59,  60,  61,
-//     62,  63,  64,  66,  67,  68,  69,  70,  72,  73,  74,  75,  77,  78,  79,  81,  82,  83,  85,  86,  87,  89,
-//     90,  92,  93,  95,  96,  98,  99,  101, 102, 104, 105, 107, 109, 110, 112, 114, 115, 117, 119, 120, 122, 124,
-//     126, 127, 129, 131, 133, 135, 137, 138, 140, 142, 144, 146, 148, 150, 152, 154, 156, 158, 160, 162, 164, 167,
-//     169, 171, 173, 175, 177, 180, 182, 184, 186, 189, 191, 193, 196, 198, 200, 203, 205, 208, 210, 213, 215, 218,
-//     220, 223, 225, 228, 231, 233, 236, 239, 241, 244, 247, 249, 252, 255};
-
-// constexpr PROGMEM uint8_t gammaCorrect[] = {
-//     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-//     0x00, 0x00, 0x00, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x02, 0x02, 0x02, 0x02, 0x02,
-//     0x02, 0x02, 0x02, 0x03, 0x03, 0x03, 0x03, 0x03, 0x04, 0x04, 0x04, 0x04, 0x04, 0x05, 0x05, 0x05, 0x05, 0x06, 0x06,
-//     0x06, 0x06, 0x07, 0x07, 0x07, 0x07, 0x08, 0x08, 0x08, 0x09, 0x09, 0x09, 0x0A, 0x0A, 0x0A, 0x0B, 0x0B, 0x0C, 0x0C,
-//     0x0C, 0x0D, 0x0D, 0x0E, 0x0E, 0x0F, 0x0F, 0x0F, 0x10, 0x10, 0x11, 0x11, 0x12, 0x12, 0x13, 0x13, 0x14, 0x14, 0x15,
-//     0x16, 0x16, 0x17, 0x17, 0x18, 0x19, 0x19, 0x1A, 0x1A, 0x1B, 0x1C, 0x1C, 0x1D, 0x1E, 0x1E, 0x1F, 0x20, 0x21, 0x21,
-//     0x22, 0x23, 0x24, 0x24, 0x25, 0x26, 0x27, 0x28, 0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2E, 0x2F, 0x30, 0x31,
-//     0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F, 0x40, 0x41, 0x43, 0x44, 0x45,
-//     0x46, 0x47, 0x48, 0x49, 0x4B, 0x4C, 0x4D, 0x4E, 0x50, 0x51, 0x52, 0x53, 0x55, 0x56, 0x57, 0x59, 0x5A, 0x5B, 0x5D,
-//     0x5E, 0x5F, 0x61, 0x62, 0x63, 0x65, 0x66, 0x68, 0x69, 0x6B, 0x6C, 0x6E, 0x6F, 0x71, 0x72, 0x74, 0x75, 0x77, 0x79,
-//     0x7A, 0x7C, 0x7D, 0x7F, 0x81, 0x82, 0x84, 0x86, 0x87, 0x89, 0x8B, 0x8D, 0x8E, 0x90, 0x92, 0x94, 0x96, 0x97, 0x99,
-//     0x9B, 0x9D, 0x9F, 0xA1, 0xA3, 0xA5, 0xA6, 0xA8, 0xAA, 0xAC, 0xAE, 0xB0, 0xB2, 0xB4, 0xB6, 0xB8, 0xBA, 0xBD, 0xBF,
-//     0xC1, 0xC3, 0xC5, 0xC7, 0xC9, 0xCC, 0xCE, 0xD0, 0xD2, 0xD4, 0xD7, 0xD9, 0xDB, 0xDD, 0xE0, 0xE2, 0xE4, 0xE7, 0xE9,
-//     0xEB, 0xEE, 0xF0, 0xF3, 0xF5, 0xF8, 0xFA, 0xFD, 0xFF};
-
-uint8_t
-InvertLevel(uint8_t level)
-{
-    return 255 - level;
+// Sunrise is split into 2^kSunriseStepBits steps of equal duration. Brightness is changed at the start of each step
+constexpr uint8_t  kSunriseStepBits{12};
+constexpr uint16_t kNumOfSunriseSteps{1 << kSunriseStepBits};
+constexpr auto     kDefaultDimmingCurve{DimmingCurve::kCie1931};
+constexpr uint16_t kDefaultSunriseDurationMin{30};
+constexpr uint16_t kMaxSunriseDurationMin{1440};  // One day
+constexpr uint32_t kMinUpdatingPeriodMs{1};
+constexpr uint16_t kMaxBrightness{1023};
+
+// Replicates high bits into low ones, so 1023 becomes 0xFFFF
+uint16_t
+BrightnessToLevel(uint16_t brightness)
+{
+    return (brightness << 6) | (brightness >> 4);
 }
-
 }  // namespace
 
-LedDriver::LedDriver(uint8_t pin, Pwm::PWMSpeed pwm_speed, uint32_t updating_period_ms)
-  : pwm_{pin, pwm_speed, false}
+LedDriver::LedDriver(uint8_t pin, uint16_t pwm_top, uint32_t updating_period_ms)
+  : pwm_{pin, pwm_top}
   , initial_updating_period_ms_{updating_period_ms}
   , adjusted_updating_period_ms_(updating_period_ms)
   , is_sunrise_in_progress_{false}
-  , sunrise_start_time_{0}
-  , sunrise_duration_sec_{0}
+  , sunrise_duration_min_{0}
+  , sunrise_brightness_{kMaxBrightness}
+  , sunrise_level_{0xFFFF}
+  , step_duration_ms_{0}
+  , step_remainder_ms_{0}
+  , sunrise_step_{0}
+  , step_error_{0}
+  , next_step_time_{0}
   , current_brightness_{0}
-  , thermal_factor_{1.0}
+  , current_level_{0}
+  , thermal_factor_{kQ8_8One}
+  , dimming_curve_{kDefaultDimmingCurve}
 {
 }
 
@@ -83,156 +47,247 @@ void
 LedDriver::Setup()
 {
     pwm_.Setup();
-    uint16_t duration_min{(uint16_t)eeprom_read_word(&sunraise_duration_minutes_address)};
-    SetSunriseDuration(duration_min);
+    // Settings are restored from ConfigStore by LampController
+    sunrise_duration_min_ = kDefaultSunriseDurationMin;
     SetBrightness(0);
-
-    Serial.print(F("Read from EEPROM: Sunrise duration "));
-    Serial.print(duration_min);
-    Serial.println(F(" minutes"));
 }
 
 void
-LedDriver::RunSunrise()
+LedDriver::Run()
 {
     if (!is_sunrise_in_progress_) {
         return;
     }
 
-    // Do not execute too often
-    static uint32_t last_updating_time{0};
-    auto            now = millis();
-    if ((now - last_updating_time) < adjusted_updating_period_ms_) {
-        return;
+    // Only steps, which time has come, are made. Usually it is one step or none
+    auto     now = millis();
+    uint16_t previous_step{sunrise_step_};
+    while ((sunrise_step_ < kNumOfSunriseSteps) && (static_cast<int32_t>(now - next_step_time_) >= 0)) {
+        ++sunrise_step_;
+        ScheduleNextSunriseStep();
     }
-    last_updating_time = now;
 
-    uint32_t delta_time_ms{(now - sunrise_start_time_)};
-    if (delta_time_ms >= (sunrise_duration_sec_ * 1000)) {
+    if (sunrise_step_ >= kNumOfSunriseSteps) {
         // Sunrise is finished
-        SetBrightness(1023);  // Keep lamp turned on
+        SetBrightness(sunrise_brightness_);  // Keep lamp turned on
         return;
     }
+    if (sunrise_step_ != previous_step) {
+        ApplyLevel(MapSunriseStepToLevel(sunrise_step_));
+    }
+}
 
-    pwm_.SetDuty(static_cast<uint16_t>(thermal_factor_ * MapSunriseTimeToLevel(delta_time_ms)));
+uint32_t
+LedDriver::GetPeriodMs() const
+{
+    // Do not execute too often
+    return adjusted_updating_period_ms_;
 }
 
-void
-LedDriver::SetSunriseDurationStr(const String& str)
+bool
+LedDriver::SetSunriseDurationStr(const char* str)
 {
     Serial.print(F("Received command 'Set Sunrise duration' "));
     Serial.println(str);
 
-    uint16_t duration_min{(uint16_t)str.substring(0, 4).toInt()};
-    eeprom_write_word(&sunraise_duration_minutes_address, duration_min);
-    SetSunriseDuration(duration_min);
+    return SetSunriseDurationMin(ParseDecimal(str, 4));
+}
+
+bool
+LedDriver::SetSunriseDurationMin(uint16_t duration_min)
+{
+    if ((duration_min == 0) || (duration_min > kMaxSunriseDurationMin)) {
+        return false;
+    }
+    sunrise_duration_min_ = duration_min;
 
-    Serial.print(F("Stored to EEPROM Sunrise duration "));
+    Serial.print(F("Sunrise duration is "));
     Serial.print(duration_min);
     Serial.println(F(" minutes"));
+    return true;
 }
 
-String
-LedDriver::GetSunriseDurationStr() const
+uint16_t
+LedDriver::GetSunriseDurationMin() const
+{
+    return sunrise_duration_min_;
+}
+
+void
+LedDriver::WriteSunriseDuration(ResponseWriter& writer) const
 {
     // MMMM
-    char str[5];
-    // A terminating null character is automatically appended by snprintf
-    snprintf_P(str, 5, PSTR("%04d"), sunrise_duration_sec_ / 60);
-    return String(str);
+    writer.WriteDecimal(GetSunriseDurationMin(), 4);
 }
 
 void
-LedDriver::StartSunrise()
+LedDriver::StartSunrise(uint16_t duration_min, uint16_t brightness)
 {
+    SetSunriseDuration((duration_min != 0) ? duration_min : sunrise_duration_min_);
+    sunrise_brightness_ = brightness;
+    sunrise_level_      = BrightnessToLevel(brightness);
+
     is_sunrise_in_progress_ = true;
-    sunrise_start_time_     = millis();
+    sunrise_step_           = 0;
+    step_error_             = 0;
+    next_step_time_         = millis();
+    ScheduleNextSunriseStep();
+    ApplyLevel(MapSunriseStepToLevel(0));
 }
 
 void
 LedDriver::StopSunrise()
 {
-    is_sunrise_in_progress_ = false;
+    is_sunrise_in_progress_      = false;
+    adjusted_updating_period_ms_ = initial_updating_period_ms_;
 }
 
 void
 LedDriver::SetBrightness(uint16_t level)
 {
-    StopSunrise();  // Manual control of brightness cancells sunrise
-    pwm_.SetDuty(static_cast<uint16_t>(thermal_factor_ * MapManualControlToLevel(level)));
+    SetManualLevel(BrightnessToLevel(level));
+}
 
-Serial.print(String(F("LAMBIN LedDriver::SetBrightness(): k = ")) + String(thermal_factor_, 2));
-Serial.println(String(F("; scaled brightness = ")) + String((thermal_factor_ * current_brightness_ / 1024.0 * 100), 2));
+void
+LedDriver::SetManualLevel(uint16_t level)
+{
+    StopSunrise();  // Manual control of brightness cancells sunrise
+    ApplyLevel(MapManualControlToLevel(level));
 }
 
 void
-LedDriver::SetBrightnessStr(const String& str)
+LedDriver::SetBrightnessStr(const char* str)
 {
     Serial.print(F("Received command 'Set brightness' "));
     Serial.println(str);
 
-    uint16_t brightness{(uint16_t)str.substring(0, 4).toInt()};
+    uint16_t brightness{ParseDecimal(str, 4)};
     SetBrightness(brightness);
 }
 
-String
-LedDriver::GetBrightnessStr() const
+uint16_t
+LedDriver::GetBrightness() const
+{
+    return current_brightness_;
+}
+
+void
+LedDriver::WriteBrightness(ResponseWriter& writer) const
 {
     // BBBB
-    char str[5];
-    // A terminating null character is automatically appended by snprintf
-    snprintf_P(str, 5, PSTR("%04d"), current_brightness_);
-    return String(str);
+    writer.WriteDecimal(current_brightness_, 4);
+}
+
+bool
+LedDriver::SetDimmingCurve(DimmingCurve curve)
+{
+    if (curve >= DimmingCurve::kNumOfCurves) {
+        return false;
+    }
+    dimming_curve_ = curve;
+    return true;
+}
+
+bool
+LedDriver::SetDimmingCurveStr(const char* str)
+{
+    if ((str[0] < '0') || (str[0] > '9')) {
+        return false;
+    }
+    uint16_t curve{ParseDecimal(str, 3)};
+    if (curve >= static_cast<uint8_t>(DimmingCurve::kNumOfCurves)) {
+        return false;
+    }
+    return SetDimmingCurve(static_cast<DimmingCurve>(curve));
+}
+
+DimmingCurve
+LedDriver::GetDimmingCurve() const
+{
+    return dimming_curve_;
 }
 
 void
-LedDriver::SetThermalFactor(float thermal_factor)
+LedDriver::WriteDimmingCurve(ResponseWriter& writer) const
 {
-    thermal_factor = constrain(thermal_factor, 0.0, 1.0);
-    thermal_factor_ = thermal_factor;
+    // C
+    writer.WriteDecimal(static_cast<uint8_t>(dimming_curve_));
+}
+
+void
+LedDriver::SetThermalFactor(Q8_8 thermal_factor)
+{
+    thermal_factor_ = constrain(thermal_factor, 0, kQ8_8One);
     // Update brightness based on received thermal_factor
-    pwm_.SetDuty(static_cast<uint16_t>(thermal_factor_ * current_brightness_));
+    ApplyLevel(current_level_);
+}
 
-Serial.print(String(F("LAMBIN LedDriver::SetThermalFactor(): k = ")) + String(thermal_factor_, 2));
-Serial.println(String(F("; scaled brightness = ")) + String((thermal_factor_ * current_brightness_ / 1024.0) * 100, 2));
+Q8_8
+LedDriver::GetThermalFactor() const
+{
+    return thermal_factor_;
+}
+
+uint16_t
+LedDriver::GetOutputLevel() const
+{
+    return MultiplyQ8_8(current_level_, thermal_factor_);
+}
+
+void
+LedDriver::ApplyLevel(uint16_t level)
+{
+    current_level_ = level;
+
+    // Scale [0, 0xFFFF] to [0, max duty] without division
+    uint16_t max_duty{pwm_.GetMaxDuty()};
+    uint16_t duty = (static_cast<uint32_t>(MultiplyQ8_8(level, thermal_factor_)) * (max_duty + 1UL)) >> 16;
+
+    // Inverted PWM duty cycle is used, because 100% duty cycle makes 0 ohm on DIM input of LED driver, which
+    // corresponds to 0% brightness
+    pwm_.SetDuty(max_duty - duty);
 }
 
 void
 LedDriver::SetSunriseDuration(uint16_t duration_m)
 {
-    sunrise_duration_sec_ = (uint32_t)duration_m * 60;
+    // Divisor is power of 2, so quotient and remainder are just parts of duration
+    uint32_t duration_ms{duration_m * 60000UL};
+    step_duration_ms_  = duration_ms >> kSunriseStepBits;
+    step_remainder_ms_ = duration_ms & (kNumOfSunriseSteps - 1);
 
-    // Adjust updating period
-    adjusted_updating_period_ms_ = min(initial_updating_period_ms_, (sunrise_duration_sec_ * 1000) / num_of_levels);
+    // Adjust updating period. It is restored, when sunrise is stopped
+    adjusted_updating_period_ms_ = max(kMinUpdatingPeriodMs, min(initial_updating_period_ms_, step_duration_ms_));
 }
 
-uint8_t
-LedDriver::MapSunriseTimeToLevel(uint32_t delta_time_ms)
+void
+LedDriver::ScheduleNextSunriseStep()
 {
-    // Avoid overflow
-    uint8_t index;
-    if (delta_time_ms <= 0xFFFFFF) {
-        // This will not cause overflow
-        index = (delta_time_ms * num_of_levels) / (sunrise_duration_sec_ * 1000);
-    }
-    else {
-        // Max delta is 24 hours = 24*60*60*1000. So, this code will not cause overflow
-        index = ((delta_time_ms / 1000) * num_of_levels) / sunrise_duration_sec_;
+    // Bresenham's algorithm: remainder of the division of duration by number of steps is spread evenly over steps,
+    // so the last step ends exactly at the end of sunrise
+    next_step_time_ += step_duration_ms_;
+    step_error_ += step_remainder_ms_;
+    if (step_error_ >= kNumOfSunriseSteps) {
+        step_error_ -= kNumOfSunriseSteps;
+        ++next_step_time_;
     }
+}
 
-    uint16_t brightness_level{pgm_read_word(&brightness_levels[index])};
-    uint8_t  mapped_level{map(brightness_level, 1, 992, 0, 255)};
-    current_brightness_ = mapped_level << 2;
-
-    // Return inverted PWM duty cycle, because current 100% duty cycle makes 0 ohm on DIM input of LED driver, which
-    // corresponds to 0% brightness
-    return InvertLevel(mapped_level);
+uint16_t
+LedDriver::MapSunriseStepToLevel(uint16_t step)
+{
+    // Curve is scaled, so it ends at target level
+    uint16_t level = (static_cast<uint32_t>(ApplyDimmingCurve(dimming_curve_, step << (16 - kSunriseStepBits)))
+                      * (sunrise_level_ + 1UL))
+                     >> 16;
+    current_brightness_ = level >> 6;
+    return level;
 }
 
-uint8_t
+uint16_t
 LedDriver::MapManualControlToLevel(uint16_t manual_level)
 {
-    current_brightness_ = manual_level;
+    current_brightness_ = manual_level >> 6;
 
     // manual_level is read from potentiometer. Usually dependency of potentiometer's resistance from rotation angle is
     // not lineral, so this function's goal is to provide mapping between real readings from potentiometer and LED
@@ -242,8 +297,5 @@ LedDriver::MapManualControlToLevel(uint16_t manual_level)
     // In practice - I don't see any difference between mapping functions.
     // Probably we don't need mapping here. User is setting brightness manually, so he will choose brightness as he
     // wants by changing angle of potentiometer.
-
-    // Return inverted PWM duty cycle, because current 100% duty cycle makes 0 ohm on DIM input of LED driver, which
-    // corresponds to 0% brightness
-    return InvertLevel(manual_level >> 2);
+    return manual_level;
 }
@@ -3,43 +3,78 @@
 
 #include "IComponent.h"
 
-#include <WString.h>
 #include <stdint.h>
 
+#include "../dimming_curve.h"
+#include "../fixed_point.h"
+#include "../response_writer.h"
+#include "../scheduler.h"
 #include "pwm.h"
 
-// Controls current driver for powerful LED
-class LedDriver : public IComponent
+// Controls current driver for powerful LED. Brightness is mapped to 16-bit Timer1 PWM, so even the first steps of
+// sunrise are smooth.
+class LedDriver
+  : public IComponent
+  , public Scheduler::Task
 {
 public:
-    LedDriver(uint8_t pin, Pwm::PWMSpeed pwm_speed, uint32_t updating_period_ms = 1000);
-    void Setup() override;
-    void RunSunrise();
+    // pin should be connected to Timer1 (9 or 10), see Pwm for meaning of pwm_top
+    LedDriver(uint8_t pin, uint16_t pwm_top, uint32_t updating_period_ms = 1000);
+    void     Setup() override;
+    void     Run() override;  // Runs sunrise
+    uint32_t GetPeriodMs() const override;
 
-    void   SetSunriseDurationStr(const String& str);
-    String GetSunriseDurationStr() const;
+    // Default duration of sunrise. It is applied to the next sunrise. Returns false, if duration is out of range
+    // [1..1440] minutes
+    bool     SetSunriseDurationMin(uint16_t duration_min);
+    bool     SetSunriseDurationStr(const char* str);
+    uint16_t GetSunriseDurationMin() const;
+    void     WriteSunriseDuration(ResponseWriter& writer) const;  // MMMM
 
-    void   SetBrightness(uint16_t level);  // level is in range [0..1023]
-    void   SetBrightnessStr(const String& str);
-    String GetBrightnessStr() const;
-    void   SetThermalFactor(float thermal_factor);
+    void     SetBrightness(uint16_t level);   // level is in range [0..1023]
+    void     SetManualLevel(uint16_t level);  // Full scale 16-bit level, for finer control than brightness
+    void     SetBrightnessStr(const char* str);
+    uint16_t GetBrightness() const;
+    void     WriteBrightness(ResponseWriter& writer) const;  // BBBB
+    void     SetThermalFactor(Q8_8 thermal_factor);  // Factor in range [0, 1] scales brightness
+    Q8_8     GetThermalFactor() const;
+    uint16_t GetOutputLevel() const;  // Full scale 16-bit level of PWM, after thermal factor
 
-    void StartSunrise();
+    // Curve is used for sunrise. Manual brightness is linear: user chooses it by eyes anyway
+    bool         SetDimmingCurve(DimmingCurve curve);  // Returns false for unknown curve
+    bool         SetDimmingCurveStr(const char* str);
+    DimmingCurve GetDimmingCurve() const;
+    void         WriteDimmingCurve(ResponseWriter& writer) const;  // C
+
+    // Sunrise goes along dimming curve up to <brightness> [0..1023]. Duration 0 means duration set by
+    // SetSunriseDurationMin()
+    void StartSunrise(uint16_t duration_min, uint16_t brightness);
     void StopSunrise();
 
 private:
-    void    SetSunriseDuration(uint16_t duration_m);
-    uint8_t MapSunriseTimeToLevel(uint32_t delta_time_ms);
-    uint8_t MapManualControlToLevel(uint16_t manual_level);
+    // Levels are full scale 16-bit values: 0 is off, 0xFFFF is maximal brightness
+    void     SetSunriseDuration(uint16_t duration_m);
+    void     ScheduleNextSunriseStep();   // Calculates start time of the step after the current one
+    void     ApplyLevel(uint16_t level);  // Sets PWM for given brightness level, taking into account thermal factor
+    uint16_t MapSunriseStepToLevel(uint16_t step);
+    uint16_t MapManualControlToLevel(uint16_t manual_level);  // manual_level is full scale 16-bit
 
     Pwm            pwm_;
     const uint32_t initial_updating_period_ms_;
     uint32_t       adjusted_updating_period_ms_;
     bool           is_sunrise_in_progress_;
-    uint32_t       sunrise_start_time_;
-    uint32_t       sunrise_duration_sec_;
-    uint16_t       current_brightness_;
-    float          thermal_factor_;
+    uint16_t       sunrise_duration_min_;  // Default duration
+    uint16_t       sunrise_brightness_;    // Brightness at the end of the current sunrise
+    uint16_t       sunrise_level_;         // And its level
+    uint32_t       step_duration_ms_;   // Duration of sunrise divided by number of steps...
+    uint16_t       step_remainder_ms_;  // ...and remainder of this division
+    uint16_t       sunrise_step_;       // Current step of sunrise
+    uint16_t       step_error_;         // Accumulated remainder, see ScheduleNextSunriseStep()
+    uint32_t       next_step_time_;
+    uint16_t       current_brightness_;  // [0..1023]
+    uint16_t       current_level_;       // Level before applying thermal factor
+    Q8_8           thermal_factor_;
+    DimmingCurve   dimming_curve_;
 };
 
 #endif  // LED_DRIVER_H_
@@ -1,252 +1,88 @@
 #include "potentiometer.h"
 
 #include <Arduino.h>
+#include <avr/interrupt.h>
 
-Potentiometer::Potentiometer(uint8_t pin, uint32_t sampling_ms)
-  : pin_{pin}
-  , sampling_ms_{sampling_ms}
-  , current_sampe_index_{0}
-  , running_average_value_{0}
-  , running_average_int_value_{0}
-  , current_value_{0}
+namespace
 {
-    for (auto& sample : samples) {
-        sample = 0;
-    }
-}
+constexpr uint8_t kOversamplingBits{Potentiometer::kOversamplingBits};
+constexpr uint8_t kNumOfOversamples{1 << (2 * kOversamplingBits)};
+static_assert(kNumOfOversamples * 1023UL <= UINT16_MAX, "Sum of oversamples should fit 16 bits");
 
-void
-Potentiometer::Setup()
-{
-    pinMode(pin_, INPUT);
-}
+uint16_t          adc_sum{0};  // Used only by interrupt
+uint8_t           adc_num_of_samples{0};
+volatile uint16_t adc_value{0};  // The latest decimated value
+volatile bool     is_adc_value_ready{false};
+}  // namespace
 
-void
-Potentiometer::Loop()
+ISR(ADC_vect)
 {
-    static uint32_t last_sampling_time{0};
-    auto            now = millis();
-    if ((now - last_sampling_time) < sampling_ms_) {
-        return;
+    adc_sum += ADC;
+    if (++adc_num_of_samples == kNumOfOversamples) {
+        adc_value          = adc_sum >> kOversamplingBits;
+        is_adc_value_ready = true;
+        adc_sum            = 0;
+        adc_num_of_samples = 0;
     }
-    last_sampling_time = now;
-
-    current_value_ = Filter(analogRead(pin_));
 }
 
-uint16_t
-Potentiometer::Read() const
+template <typename Filter>
+BasicPotentiometer<Filter>::BasicPotentiometer(uint8_t pin, uint32_t sampling_ms)
+  : pin_{pin}
+  , sampling_ms_{sampling_ms}
+  , filter_{}
+  , current_value_{0}
 {
-    return current_value_;
 }
 
-uint16_t
-Potentiometer::Filter(uint16_t new_value)
+template <typename Filter>
+void
+BasicPotentiometer<Filter>::Setup()
 {
-    // PrintprintDebug(new_value);
+    pinMode(pin_, INPUT);
 
-    return (uint16_t)FilterRunningAverageAdaptive(FilterMedian3(new_value));
+    // AVcc reference like analogRead(). 125 kHz ADC clock, so conversion takes 104 us
+    ADMUX  = _BV(REFS0) | ((pin_ - A0) << MUX0);
+    ADCSRB = _BV(ADTS2);  // Trigger by Timer0 overflow. Its flag is cleared by millis() interrupt
+    ADCSRA = _BV(ADEN) | _BV(ADATE) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
 }
 
-uint16_t
-Potentiometer::FilterMedianN(uint16_t new_value)
-{
-    samples[current_sampe_index_] = new_value;
-    if ((current_sampe_index_ < samples_size_ - 1) &&
-        (samples[current_sampe_index_] > samples[current_sampe_index_ + 1])) {
-        for (int i = current_sampe_index_; i < samples_size_ - 1; ++i) {
-            if (samples[i] > samples[i + 1]) {
-                // Swap. Swapping via XOR is slowlier
-                uint16_t tmp   = samples[i];
-                samples[i]     = samples[i + 1];
-                samples[i + 1] = tmp;
-            }
-        }
-    }
-    else {
-        if ((current_sampe_index_ > 0) && (samples[current_sampe_index_ - 1] > samples[current_sampe_index_])) {
-            for (int i = current_sampe_index_; i > 0; --i) {
-                if (samples[i] < samples[i - 1]) {
-                    // Swap. Swapping via XOR is slowlier
-                    uint16_t tmp   = samples[i];
-                    samples[i]     = samples[i - 1];
-                    samples[i - 1] = tmp;
-                }
-            }
-        }
-    }
-    if (++current_sampe_index_ >= samples_size_) {
-        current_sampe_index_ = 0;
-    }
-    return samples[samples_size_ / 2];
-}
-
-// Fast version of median filter for 3 samples. Can give good results in combination with running average filter
-uint16_t
-Potentiometer::FilterMedian3(uint16_t new_value)
+template <typename Filter>
+void
+BasicPotentiometer<Filter>::Run()
 {
-    samples[current_sampe_index_] = new_value;
-    if (++current_sampe_index_ >= 3) {
-        current_sampe_index_ = 0;
-    }
-
-    uint16_t& a = samples[0];
-    uint16_t& b = samples[1];
-    uint16_t& c = samples[2];
-    if ((a <= b) && (a <= c)) {
-        return (b <= c) ? b : c;
+    uint8_t sreg = SREG;
+    cli();
+    bool     is_ready  = is_adc_value_ready;
+    uint16_t value     = adc_value;
+    is_adc_value_ready = false;
+    SREG               = sreg;
+
+    // New value is decimated once per kNumOfOversamples Timer0 periods (16 ms), Run() can be called more often
+    if (is_ready) {
+        current_value_ = filter_.Apply(value);
     }
-    else {
-        if ((b <= a) && (b <= c)) {
-            return (a <= c) ? a : c;
-        }
-        else {
-            return (a <= b) ? a : b;
-        }
-    }
-}
-
-float
-Potentiometer::FilterRunningAverage(float new_value, float k = 0.5f)
-{
-    running_average_value_ += (new_value - running_average_value_) * k;
-    return running_average_value_;
 }
 
-// Int version is slightly slowlier, but looks the same precise.
-// Performance: 8-10 times faster
-// Memory: 5674/462 -> 5630/464. Surprisingly it requires 2 more bytes or RAM. But 44 less bytes of flash
-int16_t
-Potentiometer::FilterRunningAverageInt(int16_t new_value)
+template <typename Filter>
+uint32_t
+BasicPotentiometer<Filter>::GetPeriodMs() const
 {
-    running_average_int_value_ += (new_value - running_average_int_value_) / 2;
-    return running_average_int_value_;
+    return sampling_ms_;
 }
 
-// https://alexgyver.ru/lessons/filters/
-// This filter better adapts to fast changes of value
-float
-Potentiometer::FilterRunningAverageAdaptive(float new_value, float k_slow, float k_fast, float threshold)
+template <typename Filter>
+uint16_t
+BasicPotentiometer<Filter>::Read() const
 {
-    float k;
-    // Speed of filter depends on absolute value of difference
-    if (abs(new_value - running_average_value_) > threshold)
-        k = k_fast;
-    else
-        k = k_slow;
-
-    running_average_value_ += (new_value - running_average_value_) * k;
-    return running_average_value_;
+    return current_value_;
 }
 
-// Int version the same fast as float version. It looks like litle bit less precise. Ex. it is always 2-3 higher or
-// lower than original signal or float filter value. Idk why. Sometimes it doesn't react on signal change.
-// Ex. signal = 8, int_filter = 6, then signal = 4, int_filter = 6
-// This is because of division on 10. Small changes will be invisible for int version, but anyway it is still quite
-// precise
-// Performance: 2.5-2.8 times faster
-// Memory: 5746/470 -> 5760/472. Surprisingly it requires 2 more bytes or RAM. AND 16 more bytes of flash!
-int16_t
-Potentiometer::FilterRunningAverageAdaptiveInt(int16_t new_value,
-                                               int8_t  k_slow    = 3,
-                                               int8_t  k_fast    = 9,
-                                               int8_t  threshold = 10)
+template <typename Filter>
+uint16_t
+BasicPotentiometer<Filter>::ToLevel(uint16_t value)
 {
-    int8_t k;
-    // Speed of filter depends on absolute value of difference
-    if (abs(new_value - running_average_int_value_) > threshold)
-        k = k_fast;
-    else
-        k = k_slow;
-
-    running_average_int_value_ += ((new_value - running_average_int_value_) * k) / 10;
-    return running_average_int_value_;
+    return (value << (16 - kResolutionBits)) | (value >> (2 * kResolutionBits - 16));
 }
 
-// void
-// Potentiometer::PrintprintDebug(uint16_t new_value)
-// {
-//     auto     start_time          = micros();
-//     uint16_t median_10gyver_val  = filterMedianN(new_value);
-//     auto     median_10gyver_time = micros() - start_time;
-//     start_time                   = micros();
-//     uint16_t median_3gyver_val   = filterMedian3(new_value);
-//     auto     median_3gyver_time  = micros() - start_time;
-//     start_time                   = micros();
-
-//     uint16_t avg_val  = (uint16_t)(filterRunningAverage(median_3gyver_val));
-//     auto     avg_time = micros() - start_time;
-//     start_time        = micros();
-//     // uint16_t avg_int_val  = filterRunningAverageInt(median_3gyver_val);
-//     // auto     avg_int_time = micros() - start_time;
-//     // start_time            = micros();
-
-//     uint16_t avg_adp_val  = (uint16_t)(filterRunningAverageAdaptive(median_3gyver_val));
-//     auto     avg_adp_time = micros() - start_time;
-//     start_time            = micros();
-//     // uint16_t avg_adp_int_val  = filterRunningAverageAdaptiveInt(median_3gyver_val);
-//     // auto     avg_adp_int_time = micros() - start_time;
-//     // start_time                = micros();
-
-//     Serial.print("NotFiltered:");
-//     Serial.print(new_value);
-//     // Serial.print(", median10Gyver:");
-//     // Serial.print(median_10gyver_val);
-//     // Serial.print(", median3Gyver:");
-//     // Serial.print(median_3gyver_val);
-//     Serial.print(", median3GyverAvg:");
-//     Serial.print(avg_val);
-//     // Serial.print(", median3GyverAvgInt:");
-//     // Serial.print(avg_int_val);
-//     Serial.print(", median3GyverAvgAdaptive:");
-//     Serial.print(avg_adp_val);
-//     // Serial.print(", median3GyverAvgAdaptiveInt:");
-//     // Serial.print(avg_adp_int_val);
-//     // Serial.print(", medianNth:");
-//     // Serial.print(median_nth_val);
-//     Serial.println();
-
-//     // Print performance
-//     // Serial.print("median_10gyver_time:");
-//     // Serial.print(median_10gyver_time);
-//     // Serial.println();
-
-//     // Print avg performance
-//     // static uint32_t runc_count = 0;
-//     // ++runc_count;
-//     // static uint32_t median_10gyver_avg_time     = 0;
-//     // static uint32_t median_3gyver_avg_time = 0;
-//     // static uint32_t avg_avg_time     = 0;
-//     // static uint32_t avg_int_avg_time = 0;
-//     // static uint32_t avg_adp_avg_time     = 0;
-//     // static uint32_t avg_adp_int_avg_time = 0;
-
-//     // static bool reset_made = false;
-//     // if ((runc_count >= 100) || reset_made) {
-//     //     if (!reset_made) {
-//     //         runc_count = 1;
-//     //         reset_made = true;
-//     //     }
-
-//     //     median_10gyver_avg_time += median_10gyver_time;
-//     //     median_3gyver_avg_time += median_3gyver_time;
-//     //     avg_avg_time += avg_time;
-//     //     avg_int_avg_time += avg_int_time;
-//     //     avg_adp_avg_time += avg_adp_time;
-//     //     avg_adp_int_avg_time += avg_adp_int_time;
-//     // }
-
-//     // Serial.print("median_gyver_avg_time:");
-//     // Serial.print(median_10gyver_avg_time / runc_count);
-//     // Serial.print(", median_gyver_opt_avg_time:");
-//     // Serial.print(median_3gyver_avg_time / runc_count);
-//     // Serial.print("avg_avg_time:");
-//     // Serial.print(avg_avg_time / runc_count);
-//     // Serial.print(", avg_int_avg_time:");
-//     // Serial.print(avg_int_avg_time / runc_count);
-//     // Serial.print("avg_adp_avg_time:");
-//     // Serial.print(avg_adp_avg_time / runc_count);
-//     // Serial.print(", avg_adp_int_avg_time:");
-//     // Serial.print(avg_adp_int_avg_time / runc_count);
-//     // Serial.println();
-// }
+template class BasicPotentiometer<PotentiometerFilter>;
@@ -5,44 +5,42 @@
 
 #include <stdint.h>
 
-class Potentiometer : public IComponent
+#include "../filter_chain.h"
+#include "../scheduler.h"
+
+// ADC converts potentiometer in background: conversion is triggered by Timer0 overflow (once per 1024 us), and
+// interrupt accumulates 4^kOversamplingBits samples and decimates them to one value with kOversamplingBits more bits.
+// So the loop never waits for conversion, and noise of the input dithers resolution above 10 bits. Run() only filters
+// the latest decimated value by Filter, see filter_chain.h. ADC is used only by potentiometer, analogRead() should not
+// be called.
+template <typename Filter>
+class BasicPotentiometer
+  : public IComponent
+  , public Scheduler::Task
 {
 public:
-    Potentiometer(uint8_t pin, uint32_t sampling_ms);
+    static constexpr uint8_t  kOversamplingBits{2};
+    static constexpr uint8_t  kResolutionBits{10 + kOversamplingBits};
+    static constexpr uint16_t kMaxValue{(1 << kResolutionBits) - 1};
+
+    BasicPotentiometer(uint8_t pin, uint32_t sampling_ms);  // pin is analog one (A0..A7)
     void     Setup() override;
-    void     Loop();
-    uint16_t Read() const;
+    void     Run() override;
+    uint32_t GetPeriodMs() const override;
+    uint16_t Read() const;  // In range [0..kMaxValue]
 
-private:
-    uint16_t Filter(uint16_t new_value);
-
-    // Different filters. You can experiment with settigns of each filter and with their combinations
-    uint16_t FilterMedianN(uint16_t new_value);
-    uint16_t FilterMedian3(uint16_t new_value);
-    float    FilterRunningAverage(float new_value, float k = 0.5f);
-    float    FilterRunningAverageAdaptive(float new_value,
-                                          float k_slow    = 0.3f,
-                                          float k_fast    = 0.9f,
-                                          float threshold = 10.0f);
-    // Int versions of RunningAverage. They are faster, but requires almost the same memory. More details in .cpp
-    int16_t FilterRunningAverageInt(int16_t new_value);
-    int16_t FilterRunningAverageAdaptiveInt(int16_t new_value,
-                                            int8_t  k_slow    = 3,
-                                            int8_t  k_fast    = 9,
-                                            int8_t  threshold = 10);
+    static uint16_t ToLevel(uint16_t value);  // Maps value, which is read, to full scale 16-bit
 
+private:
     const uint8_t  pin_;
     const uint32_t sampling_ms_;
-
-    static constexpr uint8_t samples_size_ = 10;
-    uint16_t                 samples[samples_size_];
-    uint8_t                  current_sampe_index_;
-    float                    running_average_value_;
-    int16_t                  running_average_int_value_;
-    uint16_t                 current_value_;
-
-    // This is for debugging and confuguring filters
-    // void PrintprintDebug(uint16_t new_value);
+    Filter         filter_;
+    uint16_t       current_value_;
 };
 
+// Median removes single spikes, and adaptive EMA smooths noise, but quickly follows rotation. Threshold is 10 steps of
+// 10-bit value. Chain, which is used here, should be instantiated in .cpp
+using PotentiometerFilter = FilterChain<Median<3>, AdaptiveEma<3, 9, 40>>;
+using Potentiometer       = BasicPotentiometer<PotentiometerFilter>;
+
 #endif  // POTENTIOMETER_H_
@@ -15,12 +15,26 @@ Pwm::Pwm(uint8_t pin, Pwm::PWMSpeed pwm_speed, bool double_pwm)
   : pin_{pin}
   , pwm_speed_{pwm_speed}
   , double_pwm_{double_pwm}
+  , top_{0}
+{
+}
+
+Pwm::Pwm(uint8_t pin, uint16_t top)
+  : pin_{pin}
+  , pwm_speed_{PWMSpeed::HZ_31372}
+  , double_pwm_{false}
+  , top_{top}
 {
 }
 
 void
 Pwm::Setup()
 {
+    if (top_ != 0) {
+        SetupTimer1HighResolution();
+        return;
+    }
+
     auto res = GetSpeedMask();
     if (res.mask == 0) {
         Serial.print(F("ERROR: not supported pin for PWM: "));
@@ -55,9 +69,55 @@ Pwm::Setup()
 }
 
 void
-Pwm::SetDuty(uint8_t duty)
+Pwm::SetDuty(uint16_t duty)
+{
+    if (top_ == 0) {
+        analogWrite(pin_, duty);
+        return;
+    }
+
+    // Double buffered by hardware, new value is applied at BOTTOM, so period is never broken
+    if (pin_ == 9) {
+        OCR1A = duty;
+    }
+    else {
+        OCR1B = duty;
+    }
+}
+
+uint16_t
+Pwm::GetMaxDuty() const
 {
-    analogWrite(pin_, duty);
+    return (top_ == 0) ? 255 : top_;
+}
+
+void
+Pwm::SetupTimer1HighResolution()
+{
+    uint8_t compare_output_mode;
+    switch (pin_) {
+    case 9:
+        compare_output_mode = _BV(COM1A1);  // Non-inverting PWM on OC1A
+        OCR1A               = 0;
+        break;
+    case 10:
+        compare_output_mode = _BV(COM1B1);  // Non-inverting PWM on OC1B
+        OCR1B               = 0;
+        break;
+    default:
+        Serial.print(F("ERROR: not supported pin for 16-bit PWM: "));
+        Serial.println(pin_);
+        return;
+    }
+
+    pinMode(pin_, OUTPUT);
+    // Stop timer while it is reconfigured. Other channel of Timer1 keeps its compare output mode.
+    TCCR1B = 0;
+    TCCR1A = (TCCR1A & ~(_BV(WGM11) | _BV(WGM10))) | compare_output_mode;
+    ICR1   = top_;
+    TCNT1  = 0;
+    // Mode 8: phase and frequency correct PWM, TOP = ICR1. No prescaler
+    TCCR1B = _BV(WGM13) | _BV(CS10);
 }
 
 Pwm::GetSpeedMaskResult
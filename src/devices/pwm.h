@@ -27,8 +27,18 @@ public:
      * \param [in] double_pwm Should we double PWM speed (use fast pwm) or not (use phase correct pwm)
      */
     Pwm(uint8_t pin, PWMSpeed pwm_speed, bool double_pwm);
-    void Setup() override;
-    void SetDuty(uint8_t duty);
+
+    /*!
+     * \brief Generate 16-bit PWM with Timer1 in phase and frequency correct mode (ICR1 is TOP, no prescaler)
+     * \param [in] pin Pin to generate PWM. Possible values are 9 or 10 (Timer1)
+     * \param [in] top Value of ICR1. Duty is in range [0, top], frequency is F_CPU / (2 * top), e.g. top = 8000
+     * gives 1 kHz with 13-bit resolution at 16 MHz
+     */
+    Pwm(uint8_t pin, uint16_t top);
+
+    void     Setup() override;
+    void     SetDuty(uint16_t duty);  // duty is in range [0, GetMaxDuty()]
+    uint16_t GetMaxDuty() const;
 
 private:
     struct GetSpeedMaskResult
@@ -39,9 +49,12 @@ private:
 
     GetSpeedMaskResult GetSpeedMask() const;
 
+    void SetupTimer1HighResolution();
+
     const uint8_t  pin_;
     const PWMSpeed pwm_speed_;
     bool           double_pwm_;
+    const uint16_t top_;  // 0 in 8-bit mode
 };
 
 #endif  // PWM_H_
@@ -1,18 +1,125 @@
 #include "serial_command_reader.h"
 
 #include <Arduino.h>
+#include <avr/interrupt.h>
+#include <util/crc16.h>
+
+#include "../ring_buffer.h"
 
 namespace
 {
 const char         esp_prefix[] PROGMEM = "ESP:";
 const char         reset_esp[] PROGMEM  = "RESETESP";
 constexpr uint32_t serial_speed         = 9600L;
+constexpr uint8_t  kCommandOffset{5};  // Command follows "ESP: " prefix
+
+// Binary frame: <kStartOfFrame> <payload length> <command id> <sequence number> <payload> <CRC-8>
+constexpr uint8_t kStartOfFrame{0xA5};
+constexpr uint8_t kBinaryHeaderLength{3};  // Received part of the header: length, command id and sequence number
+constexpr uint8_t kBinaryCrcLength{1};
+
+// Arduino core owns USART RX interrupt and keeps received bytes in its own 64-byte buffer. Its content is moved to
+// this ring from Timer0 compare match interrupt, which fires every 1024 us independently of main loop. So bytes are
+// not lost, when main loop is blocked for a long time (e.g. by OneWire), and each loss is detected and counted.
+// There is only one Serial, so there is only one ring.
+RingBuffer<128> rx_ring;
+
+struct CommandName
+{
+    char                                      name[8];
+    SerialCommandReader::Command::CommandType type;
+};
+
+// Should be sorted by name. It is checked at compile time
+constexpr CommandName kCommands[] PROGMEM = {
+    {"connect", SerialCommandReader::Command::CommandType::CONNECT},
+    {"ea", SerialCommandReader::Command::CommandType::ENABLE_ALARM},
+    {"ga", SerialCommandReader::Command::CommandType::GET_ALARM},
+    {"gb", SerialCommandReader::Command::CommandType::GET_BRIGHTNESS},
+    {"gdc", SerialCommandReader::Command::CommandType::GET_DIMMING_CURVE},
+    {"gfc", SerialCommandReader::Command::CommandType::GET_FAN_CONTROL},
+    {"gsd", SerialCommandReader::Command::CommandType::GET_SUNRISE_DURATION},
+    {"gt", SerialCommandReader::Command::CommandType::GET_TIME},
+    {"gtr", SerialCommandReader::Command::CommandType::GET_THERMAL_TREND},
+    {"perf", SerialCommandReader::Command::CommandType::GET_PERFORMANCE},
+    {"rx", SerialCommandReader::Command::CommandType::GET_RX_STATISTICS},
+    {"sa", SerialCommandReader::Command::CommandType::SET_ALARM},
+    {"sb", SerialCommandReader::Command::CommandType::SET_BRIGHTNESS},
+    {"sdc", SerialCommandReader::Command::CommandType::SET_DIMMING_CURVE},
+    {"sfc", SerialCommandReader::Command::CommandType::SET_FAN_CONTROL},
+    {"sff", SerialCommandReader::Command::CommandType::SET_FAN_PWM_FREQUENCY},
+    {"sfs", SerialCommandReader::Command::CommandType::SET_FAN_PWM_STEPS_NUMBER},
+    {"ssd", SerialCommandReader::Command::CommandType::SET_SUNRISE_DURATION},
+    {"st", SerialCommandReader::Command::CommandType::SET_TIME},
+    {"ta", SerialCommandReader::Command::CommandType::TOGGLE_ALARM},
+    {"tc", SerialCommandReader::Command::CommandType::SET_THERMAL_CALIBRATION},
+    {"tl", SerialCommandReader::Command::CommandType::GET_THERMAL_SENSORS},
+    {"tm", SerialCommandReader::Command::CommandType::GET_TELEMETRY}};
+constexpr uint8_t kNumOfCommands{sizeof(kCommands) / sizeof(kCommands[0])};
+
+constexpr bool
+IsLess(const char* l, const char* r)
+{
+    return (*l == *r) ? ((*l != 0) && IsLess(l + 1, r + 1)) : (*l < *r);
+}
+
+constexpr bool
+AreCommandsSorted(uint8_t index = 0)
+{
+    return (index + 1 >= kNumOfCommands) ||
+           (IsLess(kCommands[index].name, kCommands[index + 1].name) && AreCommandsSorted(index + 1));
+}
+static_assert(AreCommandsSorted(), "kCommands should be sorted by name for binary search");
+
+SerialCommandReader::Command::CommandType
+FindCommandType(const char* command_str)
+{
+    uint8_t left{0};
+    uint8_t right{kNumOfCommands};
+    while (left < right) {
+        uint8_t middle = (left + right) / 2;
+        int     result = strcmp_P(command_str, kCommands[middle].name);
+        if (result == 0) {
+            return static_cast<SerialCommandReader::Command::CommandType>(pgm_read_byte(&kCommands[middle].type));
+        }
+        if (result < 0) {
+            right = middle;
+        }
+        else {
+            left = middle + 1;
+        }
+    }
+    return SerialCommandReader::Command::CommandType::INVALID;
+}
+
+bool
+IsKnownCommandType(uint8_t type)
+{
+    for (const auto& command : kCommands) {
+        if (pgm_read_byte(&command.type) == type) {
+            return true;
+        }
+    }
+    return false;
+}
 }  // namespace
 
+ISR(TIMER0_COMPA_vect)
+{
+    // Core's buffer can hold up to 63 bytes, so at 9600 baud it is drained long before it overflows
+    while (Serial.available() > 0) {
+        rx_ring.Push(Serial.read());
+    }
+}
+
 void
 SerialCommandReader::Setup()
 {
     Serial.begin(serial_speed);
+
+    // Timer0 is already running for millis(). Compare match interrupt fires once per its period at any OCR0A value
+    OCR0A = 0xAF;
+    TIMSK0 |= _BV(OCIE0A);
 }
 
 void
@@ -20,107 +127,213 @@ SerialCommandReader::Loop()
 {
     HandleSerialInactivity();
 
-    while (Serial.available() > 0) {
+    // Do not overwrite buffer until received command is read
+    uint8_t ch;
+    bool    is_after_gap;
+    while ((command_length_ == 0) && rx_ring.Pop(ch, is_after_gap)) {
         last_received_symbol_time_ = millis();
-        char ch                    = Serial.read();
+        if (is_after_gap) {
+            // Some bytes of current frame were lost
+            DropFrame();
+        }
+        if (is_binary_frame_) {
+            ReceiveBinaryByte(ch);
+            continue;
+        }
+        if (is_binary_mode_ && (ch == kStartOfFrame) && (current_buf_position_ == 0) && !is_dropping_frame_) {
+            is_binary_frame_ = true;
+            binary_crc_      = 0;
+            continue;
+        }
         if (ch == '\r') {
             // Ignore this line ending. If ESP doesn't use println() for communication with Arduino,
             // it should never happen.
             continue;
         }
         if (ch != '\n') {
+            if (is_dropping_frame_) {
+                continue;
+            }
+            if (current_buf_position_ >= buffer_size_ - 1) {
+                // Line is too long. Keep space for terminating 0
+                DropFrame();
+                continue;
+            }
             buffer_[current_buf_position_++] = ch;
             continue;
         }
 
+        if (is_dropping_frame_) {
+            // End of dropped line. Next line is received normally
+            is_dropping_frame_ = false;
+            continue;
+        }
+
         buffer_[current_buf_position_] = 0;
-        auto command_length            = current_buf_position_;
+        auto line_length               = current_buf_position_;
         current_buf_position_          = 0;
 
-        if ((command_length < 4) || strncmp_P(buffer_, esp_prefix, 4)) {
+        if ((line_length <= kCommandOffset) || strncmp_P(buffer_, esp_prefix, 4)) {
             // Ignore all short lines and lines without prefix
             continue;
         }
 
-        input_data_ = &buffer_[5];
+        command_length_    = line_length;
+        is_binary_command_ = false;
     }
 }
 
+void
+SerialCommandReader::ReceiveBinaryByte(uint8_t byte)
+{
+    if ((current_buf_position_ == 0) && (byte > buffer_size_ - kBinaryHeaderLength - kBinaryCrcLength)) {
+        // Frame doesn't fit into the buffer, so it is certainly broken
+        DropFrame();
+        return;
+    }
+
+    buffer_[current_buf_position_++] = byte;
+    binary_crc_                      = _crc8_ccitt_update(binary_crc_, byte);
+    uint8_t frame_length             = static_cast<uint8_t>(buffer_[0]) + kBinaryHeaderLength + kBinaryCrcLength;
+    if (current_buf_position_ < frame_length) {
+        return;
+    }
+
+    // CRC of data followed by its CRC is 0
+    if (binary_crc_ != 0) {
+        DropFrame();
+        return;
+    }
+
+    command_length_       = current_buf_position_;
+    is_binary_command_    = true;
+    is_binary_frame_      = false;
+    current_buf_position_ = 0;
+}
+
 bool
 SerialCommandReader::IsCommandReady() const
 {
-    return (input_data_.length() != 0);
+    return (command_length_ != 0);
+}
+
+bool
+SerialCommandReader::HasPendingInput() const
+{
+    // Loop() does not take bytes from the ring, while the received command is not read
+    return (command_length_ == 0) && !rx_ring.IsEmpty();
 }
 
 SerialCommandReader::Command
 SerialCommandReader::ReadCommand()
 {
-    String input_string{input_data_};
-    input_data_ = "";
+    if (is_binary_command_) {
+        command_length_ = 0;
 
-    String command_str;
-    String arguments;
-    auto   space_index = input_string.indexOf(' ');
-    if (space_index == -1) {
-        command_str = input_string;
-    }
-    else {
-        command_str = input_string.substring(0, space_index);
-        arguments   = input_string.substring(space_index + 1);
+        uint8_t type = buffer_[1];
+        return {IsKnownCommandType(type) ? static_cast<Command::CommandType>(type) : Command::CommandType::INVALID,
+                &buffer_[kBinaryHeaderLength],
+                static_cast<uint8_t>(buffer_[0]),
+                true,
+                static_cast<uint8_t>(buffer_[2])};
     }
 
-    Command::CommandType type;
-    if (command_str == "st") {
-        type = Command::CommandType::SET_TIME;
-    }
-    else if (command_str == "gt") {
-        type = Command::CommandType::GET_TIME;
-    }
-    else if (command_str == "sa") {
-        type = Command::CommandType::SET_ALARM;
-    }
-    else if (command_str == "ga") {
-        type = Command::CommandType::GET_ALARM;
-    }
-    else if (command_str == "ea") {
-        type = Command::CommandType::ENABLE_ALARM;
-    }
-    else if (command_str == "ta") {
-        type = Command::CommandType::TOGGLE_ALARM;
-    }
-    else if (command_str == "ssd") {
-        type = Command::CommandType::SET_SUNRISE_DURATION;
-    }
-    else if (command_str == "gsd") {
-        type = Command::CommandType::GET_SUNRISE_DURATION;
-    }
-    else if (command_str == "sb") {
-        type = Command::CommandType::SET_BRIGHTNESS;
-    }
-    else if (command_str == "gb") {
-        type = Command::CommandType::GET_BRIGHTNESS;
-    }
-    else if (command_str == "sff") {
-        type = Command::CommandType::SET_FAN_PWM_FREQUENCY;
+    char*   command_str    = &buffer_[kCommandOffset];
+    uint8_t command_length = command_length_ - kCommandOffset;
+    command_length_        = 0;
+
+    // Split command and arguments in place
+    char* arguments   = command_str + command_length;  // Points to terminating 0, if there are no arguments
+    auto  space_index = static_cast<char*>(memchr(command_str, ' ', command_length));
+    if (space_index != nullptr) {
+        *space_index = 0;
+        arguments    = space_index + 1;
     }
-    else if (command_str == "sfs") {
-        type = Command::CommandType::SET_FAN_PWM_STEPS_NUMBER;
+
+    auto type = FindCommandType(command_str);
+    if (type == Command::CommandType::INVALID) {
+        return {type, command_str, static_cast<uint8_t>(strlen(command_str)), false, 0};
     }
-    else if (command_str == "connect") {
-        type = Command::CommandType::CONNECT;
+    return {type, arguments, static_cast<uint8_t>(command_str + command_length - arguments), false, 0};
+}
+
+void
+SerialCommandReader::SetBinaryModeEnabled(bool is_enabled)
+{
+    is_binary_mode_ = is_enabled;
+}
+
+bool
+SerialCommandReader::IsBinaryModeEnabled() const
+{
+    return is_binary_mode_;
+}
+
+void
+SerialCommandReader::WriteBinaryReply(const Command& command,
+                                      BinaryStatus   status,
+                                      const uint8_t* payload,
+                                      uint8_t        payload_length)
+{
+    const uint8_t header[] = {static_cast<uint8_t>(payload_length + 1),
+                              static_cast<uint8_t>(command.type),
+                              command.sequence_number,
+                              static_cast<uint8_t>(status)};
+
+    uint8_t crc{0};
+    Serial.write(kStartOfFrame);
+    for (auto byte : header) {
+        crc = _crc8_ccitt_update(crc, byte);
+        Serial.write(byte);
     }
-    else {
-        return {Command::CommandType::INVALID, input_string};
+    for (uint8_t i = 0; i < payload_length; ++i) {
+        crc = _crc8_ccitt_update(crc, payload[i]);
+        Serial.write(payload[i]);
     }
-
-    return {type, arguments};
+    Serial.write(crc);
 }
 
 void
 SerialCommandReader::HandleSerialInactivity()
 {
     constexpr uint32_t serial_inactivity_timeout = 1000;
-    if ((current_buf_position_ != 0) && ((millis() - last_received_symbol_time_) >= serial_inactivity_timeout)) {
+    if (((current_buf_position_ != 0) || is_dropping_frame_ || is_binary_frame_) &&
+        ((millis() - last_received_symbol_time_) >= serial_inactivity_timeout)) {
+        // Frame was not finished. Do not wait for its end anymore
+        if (!is_dropping_frame_) {
+            ++num_of_dropped_frames_;
+        }
         current_buf_position_ = 0;
+        is_dropping_frame_    = false;
+        is_binary_frame_      = false;
     }
 }
+
+void
+SerialCommandReader::DropFrame()
+{
+    if (!is_dropping_frame_) {
+        ++num_of_dropped_frames_;
+    }
+    current_buf_position_ = 0;
+    // Binary frame has length prefix, so receiver is synchronized again at the next start of frame. Text line is
+    // dropped until its end.
+    is_dropping_frame_ = !is_binary_frame_;
+    is_binary_frame_   = false;
+}
+
+uint16_t
+SerialCommandReader::GetNumOfDroppedBytes() const
+{
+    uint8_t sreg = SREG;
+    cli();
+    auto result = rx_ring.GetNumOfDropped();
+    SREG        = sreg;
+    return result;
+}
+
+uint16_t
+SerialCommandReader::GetNumOfDroppedFrames() const
+{
+    return num_of_dropped_frames_;
+}
@@ -3,13 +3,54 @@
 
 #include "IComponent.h"
 
-#include <WString.h>
+#include <stdint.h>
 
+// Receives commands from ESP. Two protocols are supported at the same time:
+//
+// 1. Text: one command per line, "ESP: <command> <arguments>\n".
+//
+// 2. Binary. It is enabled by "ESP: connect B" and disabled by "ESP: connect". Binary frame may start only between
+//    text lines. All multibyte values are little-endian:
+//        <0xA5> <payload length> <command id> <sequence number> <payload> <CRC-8>
+//    Command id is value of Command::CommandType. CRC-8 (polynomial 0x07, initial value 0) covers all bytes of the
+//    frame except the first one. Reply is sent in the same frame format with the same command id and sequence
+//    number, and its payload starts with BinaryStatus. Payloads of requests -> replies (after status):
+//        st  uint32 time_t                            -> none
+//        gt  none                                     -> uint32 time_t
+//        sa  uint8 index, uint8 hour, uint8 minute, uint8 dow mask, uint16 sunrise minutes, uint16 brightness -> none
+//        ga  uint8 index                              -> uint8 is enabled, sa payload without index
+//        ea  uint8 is enabled                         -> none
+//        ssd uint16 minutes                           -> none
+//        gsd none                                     -> uint16 minutes
+//        sb  uint16 brightness [0..1023]              -> none
+//        gb  none                                     -> uint8 is manual mode, uint16 brightness
+//        sff uint16 fan PWM frequency, Hz (> 0)       -> none
+//        sfs uint8 fan PWM steps number (> 0)         -> none
+//        rx  none                                     -> uint16 dropped bytes, uint16 dropped frames
+//        sdc uint8 curve (DimmingCurve)               -> none
+//        gdc none                                     -> uint8 curve
+//        tl  uint8 sensor index                       -> uint8 number of sensors, 8 bytes ROM, int16 T, int16 raw T
+//        tc  uint8 index, uint8 point, int16 raw T, int16 reference T -> none
+//        sfc uint8 mode, int16 target T, int16 KP, int16 KI, int16 KD, uint8 FF -> none
+//        gfc none                                     -> sfc payload, uint8 fan speed
+//        gtr none                                     -> int16 predicted T, uint8 number of sensors, int16 slopes
+//    Temperatures, slopes and PID gains in binary protocol are Q8.8 (1/256 C, 1/256 C per second, 1/256 of fan speed).
+//    Other commands have no payload. Debug messages are still printed as text, so ESP should look for the start of
+//    the frame and check its CRC.
 class SerialCommandReader : public IComponent
 {
 public:
+    enum class BinaryStatus : uint8_t
+    {
+        kOk = 0,
+        kBadPayload,
+        kRejected,  // Command is not allowed in current state
+        kUnsupported
+    };
+
     struct Command
     {
+        // Values are used as command ids in binary protocol, so they should not be changed
         enum class CommandType : uint8_t
         {
             SET_TIME = 0,
@@ -25,10 +66,27 @@ public:
             SET_FAN_PWM_FREQUENCY,
             SET_FAN_PWM_STEPS_NUMBER,
             CONNECT,
+            GET_PERFORMANCE,
+            GET_RX_STATISTICS,
             RESET_ESP,
+            SET_DIMMING_CURVE,
+            GET_DIMMING_CURVE,
+            GET_THERMAL_SENSORS,
+            SET_THERMAL_CALIBRATION,
+            SET_FAN_CONTROL,
+            GET_FAN_CONTROL,
+            GET_THERMAL_TREND,
+            GET_TELEMETRY,
             INVALID = 255
         } type;
-        String arguments;
+
+        // Points to command's arguments inside reader's buffer (for INVALID command - to command itself).
+        // It is valid only until next call of SerialCommandReader::Loop(). Text arguments are null-terminated,
+        // binary ones are not.
+        const char* arguments;
+        uint8_t     arguments_length;
+        bool        is_binary;
+        uint8_t     sequence_number;  // Only for binary command
     };
 
     SerialCommandReader() = default;
@@ -36,16 +94,39 @@ public:
     void Loop();
 
     bool    IsCommandReady() const;
-    Command ReadCommand();
+    Command ReadCommand();  // Parses command in place, without copying it
+    bool    HasPendingInput() const;  // There are received bytes, which Loop() has not processed yet
+
+    void SetBinaryModeEnabled(bool is_enabled);
+    bool IsBinaryModeEnabled() const;
+
+    // Replies to binary command
+    static void WriteBinaryReply(const Command& command,
+                                 BinaryStatus   status,
+                                 const uint8_t* payload        = nullptr,
+                                 uint8_t        payload_length = 0);
+
+    // Bytes lost because receive buffer was full, and lines dropped because they were damaged by such loss, were
+    // too long or were not finished in time
+    uint16_t GetNumOfDroppedBytes() const;
+    uint16_t GetNumOfDroppedFrames() const;
 
 private:
     void HandleSerialInactivity();
+    void DropFrame();  // Discards current frame. Text line is discarded until its end
+    void ReceiveBinaryByte(uint8_t byte);
 
     static constexpr uint8_t buffer_size_{64};
     char                     buffer_[buffer_size_];
     uint16_t                 current_buf_position_{0};
+    uint8_t                  command_length_{0};  // Length of received command. 0 if there is no command
+    bool                     is_dropping_frame_{false};
+    bool                     is_binary_mode_{false};
+    bool                     is_binary_frame_{false};    // Binary frame is being received
+    bool                     is_binary_command_{false};  // Received command is binary
+    uint8_t                  binary_crc_{0};
+    uint16_t                 num_of_dropped_frames_{0};
 
-    String   input_data_;
     uint32_t last_received_symbol_time_{0};
 };
 
@@ -1,13 +1,15 @@
 #include "thermalcontroller.hpp"
 
+#include "../progmem_table.h"
+
 #ifndef _DEBUG
 #include <Arduino.h>
-#include "../Utils.h"
+#include "../response_writer.h"
+#include "../utils.h"
 #endif
 
 namespace
 {
-constexpr uint8_t kNumOfSensors{2};
 struct TempGraphPoint
 {
     uint8_t temperature;
@@ -31,58 +33,91 @@ struct TempGraphPoint
  *     L---------------------------------------------------------------> Temperature
  *           20     30     40     50     60     70     80     90     100
  */
-// In graph last point should always contain speed 255
 // TODO1: temp sensor is quite isolated from heatsink by glue. Also it is quite far from LED. So, I would set shutdown
 // temperature to 75, max temperature on graph to 65
 // TODO2: uncomment after debugging is finished
 // constexpr TempGraphPoint temperature_graph[] = {{30.0, 25}, {40.0, 76}, {50.0, 153}, {60.0, 230}, {70.0,
 // 255}};
-// NOTE: storing this aggay in PROGMEM will decrease flash size on 200 bytes, but will give only 24 bytes of ram.
-// Moreover to read this data from PROGMEM you will have to spend more RAM at runtime (you will need to read 2
-// structures TempGraphPoint).
+// The graph is used only at compile time to build FanCurve table, so it does not occupy memory.
 constexpr TempGraphPoint temperature_graph[] = {{27, 25}, {29, 76}, {35, 153}, {40, 230}, {45, 255}};
 constexpr uint8_t        kNumOfTempgraphLevels{sizeof(temperature_graph) / sizeof(temperature_graph[0])};
+constexpr uint8_t        kMinTemperature{temperature_graph[0].temperature};
 constexpr uint8_t        kMaxTemperature{temperature_graph[kNumOfTempgraphLevels - 1].temperature};
 constexpr uint8_t        kShutDownTemperatureRange{10};
+constexpr uint8_t        kAttentionMargin{3};  // Sensors are read faster this number of degrees below kMaxTemperature
 constexpr uint32_t       kControllTimeout{1000};
+constexpr uint8_t        kPredictionHorizon{30};  // Control periods
+
+// PID output is in 1/256 of fan speed
+constexpr int32_t kMaxPidOutput{255L << kQ8_8FractionalBits};
+
+// Curve mode is the default, PID gains are a starting point for tuning
+constexpr ThermalController::FanControlSettings kDefaultFanControl{
+    IntToQ8_8(35), IntToQ8_8(20), ToQ8_8(1.0), IntToQ8_8(40), 64, ThermalController::FanControlMode::kCurve};
+
+constexpr bool
+IsTemperatureGraphMonotonic(uint8_t index = 0)
+{
+    return (index + 1 >= kNumOfTempgraphLevels) ||
+           ((temperature_graph[index].temperature < temperature_graph[index + 1].temperature) &&
+            (temperature_graph[index].speed <= temperature_graph[index + 1].speed) &&
+            IsTemperatureGraphMonotonic(index + 1));
+}
+static_assert(IsTemperatureGraphMonotonic(), "Temperature and speed in temperature_graph should grow");
+static_assert(temperature_graph[kNumOfTempgraphLevels - 1].speed == 255, "Last point of graph should have speed 255");
 
 // TODO: make kShutDownTemperatureRange and kNumOfTempgraphLevels configurable via WebUI
 
-// For given temperature this function should check temperature_graph and get appropriate temperature
+// Fan speed for every 1/kStepsPerDegree C in range [kMinTemperature, kMaxTemperature). Speed changes gradually (linear
+// interpolation) between points of temperature_graph.
+struct FanCurve
+{
+    using ValueType = uint8_t;
+
+    static constexpr uint8_t  kStepsPerDegree{4};  // 0.25 C
+    static constexpr uint16_t kSize{(kMaxTemperature - kMinTemperature) * kStepsPerDegree};
+
+    static constexpr uint8_t
+    Value(uint16_t index, uint8_t segment = 0)
+    {
+        return (ToSteps(0) + index >= ToSteps(segment + 1))
+                   ? Value(index, segment + 1)
+                   : temperature_graph[segment].speed +
+                         (temperature_graph[segment + 1].speed - temperature_graph[segment].speed) *
+                             (ToSteps(0) + index - ToSteps(segment)) / (ToSteps(segment + 1) - ToSteps(segment));
+    }
+
+    // Temperature of graph point in steps
+    static constexpr uint16_t
+    ToSteps(uint8_t point)
+    {
+        return temperature_graph[point].temperature * kStepsPerDegree;
+    }
+};
+
+// For given temperature returns fan speed from temperature graph
 uint8_t
-MapTemperatureToFanSpeed(float temperature)
+MapTemperatureToFanSpeed(Q8_8 temperature)
 {
     // Edge cases
-    if (temperature < temperature_graph[0].temperature) {
+    if (temperature < IntToQ8_8(kMinTemperature)) {
         return 0;
     }
-    else if (temperature >= kMaxTemperature) {
+    else if (temperature >= IntToQ8_8(kMaxTemperature)) {
         return 255;
     }
 
-    for (uint8_t current_index = 0; current_index < (kNumOfTempgraphLevels - 1); ++current_index) {
-        // NOTE! It doesn't worth storing temperature_graph in PROGMEM. But in case you will decide to do it, use
-        // following code to read data from it.
-        // TempGraphPoint current_point;
-        // TempGraphPoint next_point;
-        // memcpy_P(&current_point, &temperature_graph[current_index], sizeof(TempGraphPoint));
-        // memcpy_P(&next_point, &temperature_graph[current_index + 1], sizeof(TempGraphPoint));
-
-        if ((temperature_graph[current_index].temperature <= temperature) &&
-            (temperature < temperature_graph[current_index + 1].temperature)) {
-            // Make gradual transitions for speed.
-            const uint8_t current_range_speed       = temperature_graph[current_index].speed;
-            const uint8_t next_range_speed          = temperature_graph[current_index + 1].speed;
-            const uint8_t current_range_temperature = temperature_graph[current_index].temperature;
-            const uint8_t next_range_temperature    = temperature_graph[current_index + 1].temperature;
-            return current_range_speed +
-                   static_cast<uint8_t>((float)(next_range_speed - current_range_speed) *
-                                        ((float)(temperature - (float)current_range_temperature) /
-                                         (float)(next_range_temperature - current_range_temperature)));
-        }
-    }
+    constexpr Q8_8 kTemperatureStep{kQ8_8One / FanCurve::kStepsPerDegree};
+    uint16_t       index = static_cast<uint16_t>(temperature - IntToQ8_8(kMinTemperature)) / kTemperatureStep;
+    return pgm_read_byte(&ProgmemTable<FanCurve>::kValues[index]);
+}
 
-    return 255;
+bool
+IsValid(const ThermalController::FanControlSettings& settings)
+{
+    return (settings.mode < ThermalController::FanControlMode::kNumOfModes) && (settings.target_temperature > 0)
+           && (settings.target_temperature < IntToQ8_8(kMaxTemperature)) && (settings.proportional_gain >= 0)
+           && (settings.integral_gain >= 0) && (settings.derivative_gain >= 0);
 }
 
 }  // namespace
@@ -91,48 +126,116 @@ ThermalController::ThermalController(ThermoSensors& thermo_sensors, FanPWM& fan,
   : thermo_sensors_{thermo_sensors}
   , fan_{fan}
   , led_driver_{led_driver}
+  , predicted_temperature_{ThermoSensors::kInvalidTemperature}
+  , settings_(kDefaultFanControl)
+  , integral_{0}
+  , previous_temperature_{ThermoSensors::kInvalidTemperature}
   , last_fan_speed_{0}
   , is_max_fan_speed_enabled_{false}
+  , is_derating_{false}
 {
+    thermo_sensors_.SetAttentionTemperature(IntToQ8_8(kMaxTemperature - kAttentionMargin));
 }
 
 void
-ThermalController::Loop()
+ThermalController::Run()
 {
-    // Run controll logic only once per kControllTimeout milliseconds
-    static uint32_t last_controll_time{0};
-    auto            now = millis();
-    if ((now - last_controll_time) < kControllTimeout) {
-        return;
+    // The hottest sensor defines cooling. If no sensor is read, kInvalidTemperature is far below any threshold
+    Q8_8 max_current_temp{ThermoSensors::kInvalidTemperature};
+    predicted_temperature_ = ThermoSensors::kInvalidTemperature;
+    for (uint8_t i = 0; i < thermo_sensors_.GetNumOfSensors(); ++i) {
+        auto temperature = thermo_sensors_.GetTemperature(i);
+        if (temperature == ThermoSensors::kInvalidTemperature) {
+            Serial.print(F("Error: Could not read temperature data from sensor "));
+            Serial.println(i);
+            trends_[i].Reset();
+        }
+        else {
+            trends_[i].AddSample(temperature);
+            // Only heating is extrapolated, so cooling never delays protection
+            Q8_8    slope{trends_[i].GetSlope()};
+            int32_t rise{(slope > 0) ? static_cast<int32_t>(slope) * kPredictionHorizon : 0};
+            predicted_temperature_ = max(predicted_temperature_, SaturateQ8_8(temperature + rise));
+        }
+        max_current_temp = max(max_current_temp, temperature);
     }
-    last_controll_time = now;
 
-    float temperatures[kNumOfSensors];
-    thermo_sensors_.GetTemperatures(temperatures);
-    if (temperatures[0] == ThermoSensors::kInvalidTemperature) {
-        Serial.println(String(F("Error: Could not read temperature data from sensor ")) + String(0));
+    auto control_temperature = (predicted_temperature_ >= IntToQ8_8(kMaxTemperature)) ? predicted_temperature_
+                                                                                        : max_current_temp;
+    AdjustFanSpeed(max_current_temp, control_temperature);
+    AdjustTemperatureFactor(max_current_temp, control_temperature);
+}
+
+uint32_t
+ThermalController::GetPeriodMs() const
+{
+    // Run controll logic only once per kControllTimeout milliseconds
+    return kControllTimeout;
+}
+
+bool
+ThermalController::SetFanControl(const FanControlSettings& settings)
+{
+    if (!IsValid(settings)) {
+        return false;
     }
-    if (temperatures[1] == ThermoSensors::kInvalidTemperature) {
-        Serial.println(String(F("Error: Could not read temperature data from sensor ")) + String(1));
+    if (settings.mode != settings_.mode) {
+        is_max_fan_speed_enabled_ = false;
+        ResetPid();
     }
-    auto max_current_temp = max(temperatures[0], temperatures[1]);
+    settings_ = settings;
+    return true;
+}
+
+const ThermalController::FanControlSettings&
+ThermalController::GetFanControl() const
+{
+    return settings_;
+}
+
+uint8_t
+ThermalController::GetFanSpeed() const
+{
+    return last_fan_speed_;
+}
 
-    Serial.println(String(F("LAMBIN max_current_temp = ")) + String(max_current_temp, 2));
+Q8_8
+ThermalController::GetSlope(uint8_t index) const
+{
+    // Samples are taken once per kControllTimeout
+    static_assert(kControllTimeout == 1000, "Slope should be converted to C per second");
+    return trends_[index].GetSlope();
+}
 
-    AdjustFanSpeed(max_current_temp);
-    AdjustTemperatureFactor(max_current_temp);
+Q8_8
+ThermalController::GetPredictedTemperature() const
+{
+    return predicted_temperature_;
 }
 
 void
-ThermalController::AdjustFanSpeed(float temperature)
+ThermalController::AdjustFanSpeed(Q8_8 measured_temperature, Q8_8 control_temperature)
 {
+    if (settings_.mode == FanControlMode::kPid) {
+        if (measured_temperature == ThermoSensors::kInvalidTemperature) {
+            // Keep current speed until sensors are read again
+            ResetPid();
+            return;
+        }
+        auto fan_speed = CalculatePid(measured_temperature);
+        if (fan_speed != last_fan_speed_) {
+            last_fan_speed_ = fan_speed;
+            fan_.SetSpeed(fan_speed);
+        }
+        return;
+    }
+
     if (is_max_fan_speed_enabled_) {
-        // If we are in max fan speed mode, no need to calculate speed again.
-        // Skip expensive calculations with float point
+        // If we are in max fan speed mode, no need to calculate speed again
         return;
     }
 
-    auto fan_speed = MapTemperatureToFanSpeed(temperature);
+    auto fan_speed = MapTemperatureToFanSpeed(control_temperature);
     if (fan_speed != last_fan_speed_) {
         last_fan_speed_ = fan_speed;
         fan_.SetSpeed(fan_speed);
@@ -141,17 +244,62 @@ ThermalController::AdjustFanSpeed(float temperature)
         }
     }
 }
+
+uint8_t
+ThermalController::CalculatePid(Q8_8 temperature)
+{
+    // All terms are in 1/256 of fan speed. Positive error means that lamp is too hot, so fan should be faster
+    int32_t error{SaturateQ8_8(static_cast<int32_t>(temperature) - settings_.target_temperature)};
+    int32_t proportional{MultiplyQ8_8(error, settings_.proportional_gain)};
+    // LED level is full scale 16-bit value, so product is shifted by 8 bits only to get 1/256 of fan speed
+    int32_t feed_forward = (static_cast<uint32_t>(led_driver_.GetOutputLevel()) * settings_.feed_forward_gain) >> 8;
+
+    // Derivative of temperature instead of error, so change of target does not kick the fan
+    int32_t derivative{0};
+    if (previous_temperature_ == ThermoSensors::kInvalidTemperature) {
+        // Bumpless start: PID continues from the current fan speed
+        integral_ = (static_cast<int32_t>(last_fan_speed_) << kQ8_8FractionalBits) - proportional - feed_forward;
+        integral_ = constrain(integral_, -kMaxPidOutput, kMaxPidOutput);
+    }
+    else {
+        derivative = MultiplyQ8_8(SaturateQ8_8(static_cast<int32_t>(temperature) - previous_temperature_),
+                                  settings_.derivative_gain);
+    }
+    previous_temperature_ = temperature;
+
+    // Anti-windup: integral is not accumulated, while output is saturated and error pushes it further
+    int32_t output{proportional + integral_ + derivative + feed_forward};
+    int32_t increment{MultiplyQ8_8(error, settings_.integral_gain)};
+    if (!((output >= kMaxPidOutput) && (increment > 0)) && !((output <= 0) && (increment < 0))) {
+        integral_ = constrain(integral_ + increment, -kMaxPidOutput, kMaxPidOutput);
+        output    = proportional + integral_ + derivative + feed_forward;
+    }
+
+    output = constrain(output, 0, kMaxPidOutput);
+    return (output + kQ8_8One / 2) >> kQ8_8FractionalBits;
+}
+
+void
+ThermalController::ResetPid()
+{
+    integral_             = 0;
+    previous_temperature_ = ThermoSensors::kInvalidTemperature;
+}
+
 void
-ThermalController::AdjustTemperatureFactor(float temperature)
+ThermalController::AdjustTemperatureFactor(Q8_8 measured_temperature, Q8_8 control_temperature)
 {
-    if (temperature >= (kMaxTemperature + kShutDownTemperatureRange)) {
-        led_driver_.SetThermalFactor(0.0);
+    constexpr uint8_t kShutDownTemperature{kShutDownTemperatureRange + kMaxTemperature};
+    if (control_temperature >= IntToQ8_8(kShutDownTemperature)) {
+        is_derating_ = true;
+        led_driver_.SetThermalFactor(0);
     }
-    else if (temperature >= kMaxTemperature) {
-        // Both calcualtions are the same, but 2nd is faster
-        // led_driver_.SetThermalFactor(1.0F - (temperature - kMaxTemperature) / kShutDownTemperatureRange);
-        constexpr uint8_t kShutDownTemperature{kShutDownTemperatureRange + kMaxTemperature};
-        led_driver_.SetThermalFactor(((float)kShutDownTemperature - temperature) / (float)kShutDownTemperatureRange);
+    else if (control_temperature >= IntToQ8_8(kMaxTemperature)) {
+        is_derating_ = true;
+        // k = 1 - (T - kMaxTemperature) / kShutDownTemperatureRange =
+        //   = (kShutDownTemperature - T) / kShutDownTemperatureRange
+        led_driver_.SetThermalFactor((IntToQ8_8(kShutDownTemperature) - control_temperature)
+                                     / kShutDownTemperatureRange);
 
 
         // TODO: in case fans are running on 100% but temperature is still too hot, we should reduce power of
@@ -173,10 +321,102 @@ ThermalController::AdjustTemperatureFactor(float temperature)
         // power and fans will be able to remove amount of head preventing LEDs from heating up higher.
     }
     else {
+        if (is_derating_) {
+            is_derating_ = false;
+            led_driver_.SetThermalFactor(kQ8_8One);  // Restore original thermal factor
+        }
         if (is_max_fan_speed_enabled_) {
             is_max_fan_speed_enabled_ = false;
-            led_driver_.SetThermalFactor(1.0);  // Restore original thermal factor
-            AdjustFanSpeed(temperature);        // Adjust fan speed according to temperature
+            AdjustFanSpeed(measured_temperature, control_temperature);  // Adjust fan speed according to temperature
+        }
+    }
+}
+
+// Text protocol is not available in desktop tests
+#ifndef _DEBUG
+namespace
+{
+Q8_8
+FromHundredths(uint16_t value)
+{
+    return SaturateQ8_8(((static_cast<int32_t>(value) << kQ8_8FractionalBits) + 50) / 100);
+}
+
+void
+WriteSignedDecimal(ResponseWriter& writer, int32_t value)
+{
+    if (value < 0) {
+        writer.Write('-');
+        value = -value;
+    }
+    writer.WriteDecimal(value);
+}
+
+void
+WriteHundredths(ResponseWriter& writer, Q8_8 value)
+{
+    WriteSignedDecimal(writer, (static_cast<int32_t>(value) * 100 + kQ8_8One / 2) >> kQ8_8FractionalBits);
+}
+}  // namespace
+
+bool
+ThermalController::SetFanControlStr(const char* str)
+{
+    // M T KP KI KD FF. Temperature and gains are in 0.01 units
+    Serial.print(F("Received command 'Set fan control' "));
+    Serial.println(str);
+
+    constexpr uint8_t kNumOfFields{6};
+    uint16_t          fields[kNumOfFields];
+    for (auto& field : fields) {
+        if ((str == nullptr) || (*str < '0') || (*str > '9')) {
+            return false;
+        }
+        field = ParseDecimal(str, 5);
+        str   = strchr(str, ' ');
+        if (str != nullptr) {
+            ++str;
         }
     }
+    if ((fields[0] >= static_cast<uint8_t>(FanControlMode::kNumOfModes)) || (fields[5] > 255)) {
+        return false;
+    }
+
+    FanControlSettings settings;
+    settings.mode               = static_cast<FanControlMode>(fields[0]);
+    settings.target_temperature = FromHundredths(fields[1]);
+    settings.proportional_gain  = FromHundredths(fields[2]);
+    settings.integral_gain      = FromHundredths(fields[3]);
+    settings.derivative_gain    = FromHundredths(fields[4]);
+    settings.feed_forward_gain  = fields[5];
+    return SetFanControl(settings);
+}
+
+void
+ThermalController::WriteFanControl(ResponseWriter& writer) const
+{
+    // M T KP KI KD FF SPEED
+    writer.WriteDecimal(static_cast<uint8_t>(settings_.mode)).Write(' ');
+    WriteHundredths(writer, settings_.target_temperature);
+    writer.Write(' ');
+    WriteHundredths(writer, settings_.proportional_gain);
+    writer.Write(' ');
+    WriteHundredths(writer, settings_.integral_gain);
+    writer.Write(' ');
+    WriteHundredths(writer, settings_.derivative_gain);
+    writer.Write(' ').WriteDecimal(settings_.feed_forward_gain).Write(' ').WriteDecimal(last_fan_speed_);
 }
+
+void
+ThermalController::WriteTrend(ResponseWriter& writer) const
+{
+    // P N S S ...
+    WriteHundredths(writer, predicted_temperature_);
+    writer.Write(' ').WriteDecimal(thermo_sensors_.GetNumOfSensors());
+    for (uint8_t i = 0; i < thermo_sensors_.GetNumOfSensors(); ++i) {
+        int32_t slope{(static_cast<int32_t>(GetSlope(i)) * 100 * 60 + kQ8_8One / 2) >> kQ8_8FractionalBits};
+        writer.Write(' ');
+        WriteSignedDecimal(writer, slope);
+    }
+}
+#endif
@@ -3,6 +3,10 @@
 
 #include <stdint.h>
 
+#include "../fixed_point.h"
+#include "../scheduler.h"
+#include "../trend_estimator.h"
+
 #ifdef _DEBUG
 #include "../../tests/tests/thermalcontrollermocks.h"
 #else
@@ -11,22 +15,81 @@
 #include "thermosensors.hpp"
 #endif
 
-class ThermalController
+class ResponseWriter;
+
+// Controls fan speed by temperature of the hottest sensor and reduces LED power, when fan can't cope with heat.
+//
+// Fan speed is controlled in one of two modes:
+// - curve: speed is mapped from temperature by fixed graph. It is simple, but fan reacts only after temperature has
+//   changed, and speed hunts between points of the graph;
+// - PID: speed is adjusted to keep target temperature. Heat load is known from LED power before sensors see it, so it
+//   is added to PID output as feed-forward.
+// In both modes LED power is reduced above kMaxTemperature.
+//
+// Rate of change of every sensor is estimated by linear regression over the last seconds. If the hottest sensor is
+// predicted to reach kMaxTemperature within prediction horizon, fan curve and LED power are controlled by predicted
+// temperature, so protection starts before the limit is crossed. PID always gets measured temperature: switching
+// between predicted and measured one is a step, which would kick its derivative term.
+class ThermalController : public Scheduler::Task
 {
 public:
+    // Values are used in serial protocol and stored in EEPROM, so they should not be changed
+    enum class FanControlMode : uint8_t
+    {
+        kCurve = 0,
+        kPid,
+        kNumOfModes
+    };
+
+    // Gains are in units of fan speed [0..255]. Controller runs once per second, so it is also unit of time
+    struct FanControlSettings
+    {
+        Q8_8           target_temperature;
+        Q8_8           proportional_gain;  // Speed per C of error
+        Q8_8           integral_gain;      // Speed per C of error per second
+        Q8_8           derivative_gain;    // Speed per C/s of temperature change
+        uint8_t        feed_forward_gain;  // Speed at full LED power
+        FanControlMode mode;
+    };
+
     ThermalController(ThermoSensors& thermo_sensors, FanPWM& fan, LedDriver& led_driver);
-    void Loop();
+    void     Run() override;
+    uint32_t GetPeriodMs() const override;
+
+    // Returns false for unknown mode, negative gain or target temperature out of range
+    bool                      SetFanControl(const FanControlSettings& settings);
+    bool                      SetFanControlStr(const char* str);
+    const FanControlSettings& GetFanControl() const;
+    void                      WriteFanControl(ResponseWriter& writer) const;  // M T KP KI KD FF SPEED
+    uint8_t                   GetFanSpeed() const;
+
+    Q8_8 GetSlope(uint8_t index) const;             // C per second. 0 until enough samples are collected
+    Q8_8 GetPredictedTemperature() const;           // The hottest temperature at the end of prediction horizon
+    void WriteTrend(ResponseWriter& writer) const;  // P N S S ..., P is in 0.01 C, slopes are in 0.01 C per minute
 
 private:
-    void AdjustFanSpeed(float temperature);
-    void AdjustTemperatureFactor(float temperature);
+    // Control temperature is predicted one near the limit, otherwise it is measured one
+    void    AdjustFanSpeed(Q8_8 measured_temperature, Q8_8 control_temperature);
+    uint8_t CalculatePid(Q8_8 temperature);
+    void    ResetPid();
+    void    AdjustTemperatureFactor(Q8_8 measured_temperature, Q8_8 control_temperature);
+
+    static constexpr uint8_t kNumOfTrendSamples{8};
 
     ThermoSensors& thermo_sensors_;
     FanPWM&        fan_;
     LedDriver&     led_driver_;
 
+    TrendEstimator<kNumOfTrendSamples> trends_[ThermoSensors::kMaxNumOfSensors];
+    Q8_8                               predicted_temperature_;
+
+    FanControlSettings settings_;
+    int32_t            integral_;              // Integral term of PID in 1/256 of fan speed
+    Q8_8               previous_temperature_;  // For derivative term. kInvalidTemperature after reset
+
     uint8_t last_fan_speed_;
     bool    is_max_fan_speed_enabled_;
+    bool    is_derating_;  // LED power is reduced
 };
 
 #endif  // THERMALCONTROLLER_H_
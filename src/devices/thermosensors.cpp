@@ -3,9 +3,49 @@
 #include <HardwareSerial.h>
 #include <Streaming.h>
 
+#include "../utils.h"
+#include "eeprom_map.h"
+
 namespace
 {
-// Calibration data:
+// DS18B20 commands
+constexpr uint8_t kMatchRomCommand{0x55};
+constexpr uint8_t kSkipRomCommand{0xCC};
+constexpr uint8_t kConvertTCommand{0x44};
+constexpr uint8_t kReadScratchpadCommand{0xBE};
+constexpr uint8_t kWriteScratchpadCommand{0x4E};
+// TH and TL alarm registers are not used, so they are written with factory defaults. Write scratchpad command is sent
+// to all sensors at once, so values can't be taken from the scratchpad of any of them
+constexpr uint8_t kAlarmHighRegister{0x4B};
+constexpr uint8_t kAlarmLowRegister{0x46};
+
+// Resolution scheduling. Rates are in C per second and are compared with strict inequality, so change of the hottest
+// temperature by one LSB in a window is not treated as rise: 0.5 C for 9 bit, 0.25 C for 10 bit
+constexpr uint8_t  kMinResolution{9};
+constexpr uint8_t  kMaxResolution{12};
+constexpr uint32_t kRateWindowMs{1000};
+constexpr Q8_8     kFastRiseRate{ToQ8_8(1.0)};  // 9 bit above this rate
+constexpr Q8_8     kRiseRate{ToQ8_8(0.25)};     // 10 bit above this rate
+constexpr uint8_t  kNumOfStableWindowsFor12Bit{5};
+
+// Record of calibration table in EEPROM
+struct CalibrationRecord
+{
+    DeviceAddress address;  // Erased record has 0xFF in the first byte (family code)
+    Q8_8          raw[2];   // Low and high calibration points
+    Q8_8          reference[2];
+};
+constexpr uint8_t kNumOfCalibrationRecords{kThermoSensorsCalibrationTableSize / sizeof(CalibrationRecord)};
+constexpr uint8_t kEmptyRecordMark{0xFF};
+constexpr uint8_t kGainFractionalBits{14};
+// Calibration, which is far from identity, is a mistake (e.g. points are swapped or one of them is not set yet).
+// Gain is Q2.14, so it is always below 2
+constexpr int32_t kMinGain{1L << (kGainFractionalBits - 1)};  // 0.5
+constexpr int32_t kMaxGain{INT16_MAX};                        // 2 - 1/16384
+constexpr Q8_8    kMinCalibrationRange{ToQ8_8(5.0)};          // Between raw readings of points
+
+// Calibration of sensors, which were installed in the lamp before calibration was stored in EEPROM. It is used until
+// calibration of the sensor is changed by command.
 //
 // 1 sensor (28B61675D0013CA2 - orange wires):
 // 37.0 on medical thermometer -> 36.31 on sensor
@@ -14,100 +54,471 @@ namespace
 // 2 sensor (287B2275D0013CEC - blue wires):
 // 37.0 on medical thermometer -> 36.7 on sensor
 // Boiling water (100) -> 98.25, but water in boiling pan can have different temperatures in different areas!
-const PROGMEM DeviceAddress kSensorAddress1  = {0x28, 0xB6, 0x16, 0x75, 0xD0, 0x01, 0x3C, 0xA2};
-constexpr float             kRawHigh1        = 97.25;
-constexpr float             kReferenceHigh1  = 100.0;
-constexpr float             kRawLow1         = 35.92;  // 36.31
-constexpr float             kReferenceLow1   = 36.7;   // 37.0
-constexpr float             kRawRange1       = kRawHigh1 - kRawLow1;
-constexpr float             kReferenceRange1 = kReferenceHigh1 - kReferenceLow1;
-const PROGMEM DeviceAddress kSensorAddress2  = {0x28, 0x7B, 0x22, 0x75, 0xD0, 0x01, 0x3C, 0xEC};
-constexpr float             kRawHigh2        = 98.25;
-constexpr float             kReferenceHigh2  = 100.0;
-constexpr float             kRawLow2         = 36.7;
-constexpr float             kReferenceLow2   = 37.0;
-constexpr float             kRawRange2       = kRawHigh2 - kRawLow2;
-constexpr float             kReferenceRange2 = kReferenceHigh2 - kReferenceLow2;
+const CalibrationRecord kDefaultCalibrations[] PROGMEM = {
+    {{0x28, 0xB6, 0x16, 0x75, 0xD0, 0x01, 0x3C, 0xA2},
+     {ToQ8_8(35.92), ToQ8_8(97.25)},  // 36.31
+     {ToQ8_8(36.7), ToQ8_8(100.0)}},  // 37.0
+    {{0x28, 0x7B, 0x22, 0x75, 0xD0, 0x01, 0x3C, 0xEC},
+     {ToQ8_8(36.7), ToQ8_8(98.25)},
+     {ToQ8_8(37.0), ToQ8_8(100.0)}}};
 
-bool
-AreSensorAddressesEqual(DeviceAddress const& l, DeviceAddress const& r)
+int16_t
+ToCentiCelsius(Q8_8 temperature)
 {
-    for (uint8_t i = 0; i < 8; ++i) {
-        if (l[i] != pgm_read_byte(&r[i])) {
-            return false;
-        }
+    return (static_cast<int32_t>(temperature) * 100) >> kQ8_8FractionalBits;
+}
+
+Q8_8
+FromCentiCelsius(uint16_t temperature)
+{
+    return SaturateQ8_8((static_cast<int32_t>(temperature) << kQ8_8FractionalBits) / 100);
+}
+
+void
+WriteCentiCelsius(ResponseWriter& writer, Q8_8 temperature)
+{
+    auto value = ToCentiCelsius(temperature);
+    if (value < 0) {
+        writer.Write('-');
+        value = -value;
     }
-    return true;
+    writer.WriteDecimal(value);
 }
 
+CalibrationRecord*
+GetRecordAddress(uint8_t index)
+{
+    return reinterpret_cast<CalibrationRecord*>(thermo_sensors_calibration_address) + index;
+}
+
+// Returns index of record with given address, or of the first empty record if there is no such record.
+// Returns kNumOfCalibrationRecords if table is full.
+uint8_t
+FindCalibrationRecord(DeviceAddress const& address)
+{
+    uint8_t empty_record{kNumOfCalibrationRecords};
+    for (uint8_t i = 0; i < kNumOfCalibrationRecords; ++i) {
+        DeviceAddress record_address;
+        eeprom_read_block(record_address, GetRecordAddress(i), sizeof(record_address));
+        if (memcmp(record_address, address, sizeof(record_address)) == 0) {
+            return i;
+        }
+        if ((record_address[0] == kEmptyRecordMark) && (empty_record == kNumOfCalibrationRecords)) {
+            empty_record = i;
+        }
+    }
+    return empty_record;
+}
 }  // namespace
 
-ThermoSensors::ThermoSensors(uint8_t pin)
+template <typename Filter>
+BasicThermoSensors<Filter>::BasicThermoSensors(uint8_t pin)
   : pin_{pin}
   , oneWire_{}
   , sensors_{}
-  , last_temperatures_{kInvalidTemperature, kInvalidTemperature}
+  , num_of_sensors_{0}
+  , addresses_{}
+  , resolution_{kMaxResolution}
+  , conversion_timeout_{750}
+  , gains_{}
+  , offsets_{}
+  , raw_temperatures_{}
+  , last_temperatures_{}
+  , filters_{}
+  , bus_state_{BusState::kResetForConversion}
+  , is_converting_{false}
+  , sensor_index_{0}
+  , byte_index_{0}
+  , scratchpad_{}
+  , attention_temperature_{IntToQ8_8(125)}
+  , reference_temperature_{kInvalidTemperature}
+  , reference_time_{0}
+  , is_rising_fast_{false}
+  , is_rising_{false}
+  , num_of_stable_windows_{0}
 {
 }
 
+template <typename Filter>
 void
-ThermoSensors::Setup()
+BasicThermoSensors<Filter>::Setup()
 {
     oneWire_.begin(pin_);
     sensors_.setOneWire(&oneWire_);
     sensors_.begin();
 
     Serial << F("Found ") << sensors_.getDeviceCount() << F(" thermal sensors.\n");
-    if (sensors_.getDeviceCount() < kNumOfSensors_) {
-        Serial << F("ERROR: expected number of sensors is ") << kNumOfSensors_ << endl;
+    if (sensors_.getDeviceCount() > kMaxNumOfSensors) {
+        Serial << F("ERROR: max supported number of sensors is ") << kMaxNumOfSensors << endl;
     }
 
-    for (int i = 0; i < kNumOfSensors_; ++i) {
-        if (sensors_.getAddress(addresses_[i], i)) {
-            sensors_.setResolution(addresses_[i], resolution_);
+    num_of_sensors_ = 0;
+    for (uint8_t i = 0; (i < sensors_.getDeviceCount()) && (num_of_sensors_ < kMaxNumOfSensors); ++i) {
+        if (sensors_.getAddress(addresses_[num_of_sensors_], i)) {
+            sensors_.setResolution(addresses_[num_of_sensors_], resolution_);
+            last_temperatures_[num_of_sensors_] = kInvalidTemperature;
+            raw_temperatures_[num_of_sensors_]  = kInvalidTemperature;
+            LoadCalibration(num_of_sensors_++);
         }
         else {
             Serial << F("Unable to get address for Device ") << i << endl;
         }
     }
 
+    SetResolution(kMaxResolution);
     sensors_.setResolution(resolution_);
     sensors_.setWaitForConversion(false);
     sensors_.requestTemperatures();
+    // Continue from reading of results
+    bus_state_     = BusState::kResetForRead;
+    is_converting_ = true;
+    sensor_index_  = 0;
 }
 
+template <typename Filter>
 void
-ThermoSensors::Loop()
+BasicThermoSensors<Filter>::Run()
 {
-    static uint32_t last_reading_time{0};
-    auto            now = millis();
-    if ((now - last_reading_time) < conversion_timeout_) {
-        return;
+    is_converting_ = false;
+
+    switch (bus_state_) {
+    case BusState::kResetForConversion:
+        oneWire_.reset();
+        bus_state_ = BusState::kSkipRom;
+        break;
+    case BusState::kSkipRom:
+        oneWire_.write(kSkipRomCommand);
+        bus_state_ = BusState::kConvert;
+        break;
+    case BusState::kConvert:
+        oneWire_.write(kConvertTCommand);
+        is_converting_ = true;
+        sensor_index_  = 0;
+        bus_state_     = (num_of_sensors_ != 0) ? BusState::kResetForRead : BusState::kResetForConversion;
+        break;
+    case BusState::kResetForRead:
+        if (oneWire_.reset()) {
+            bus_state_ = BusState::kMatchRom;
+        }
+        else {
+            // Nobody answered
+            FinishSensorReading(kInvalidTemperature);
+        }
+        break;
+    case BusState::kMatchRom:
+        oneWire_.write(kMatchRomCommand);
+        byte_index_ = 0;
+        bus_state_  = BusState::kWriteRom;
+        break;
+    case BusState::kWriteRom:
+        oneWire_.write(addresses_[sensor_index_][byte_index_]);
+        if (++byte_index_ == sizeof(DeviceAddress)) {
+            bus_state_ = BusState::kReadScratchpadCommand;
+        }
+        break;
+    case BusState::kReadScratchpadCommand:
+        oneWire_.write(kReadScratchpadCommand);
+        byte_index_ = 0;
+        bus_state_  = BusState::kReadScratchpad;
+        break;
+    case BusState::kReadScratchpad:
+        scratchpad_[byte_index_] = oneWire_.read();
+        if (++byte_index_ == sizeof(ScratchPad)) {
+            FinishSensorReading(DecodeScratchpad());
+        }
+        break;
+    case BusState::kResetForConfiguration:
+        oneWire_.reset();
+        bus_state_ = BusState::kSkipRomForConfiguration;
+        break;
+    case BusState::kSkipRomForConfiguration:
+        oneWire_.write(kSkipRomCommand);
+        bus_state_ = BusState::kWriteScratchpadCommand;
+        break;
+    case BusState::kWriteScratchpadCommand:
+        oneWire_.write(kWriteScratchpadCommand);
+        byte_index_ = 0;
+        bus_state_  = BusState::kWriteScratchpad;
+        break;
+    case BusState::kWriteScratchpad:
+        if (byte_index_ == 0) {
+            oneWire_.write(kAlarmHighRegister);
+        }
+        else if (byte_index_ == 1) {
+            oneWire_.write(kAlarmLowRegister);
+        }
+        else {
+            oneWire_.write(((resolution_ - kMinResolution) << 5) | 0x1F);
+        }
+        if (++byte_index_ == 3) {
+            bus_state_ = BusState::kResetForConversion;
+        }
+        break;
     }
-    last_reading_time = now;
+}
 
-    last_temperatures_[0] = ConvertByCalibration(sensors_.getTempC(addresses_[0]), addresses_[0]);
-    last_temperatures_[1] = ConvertByCalibration(sensors_.getTempC(addresses_[1]), addresses_[1]);
-    sensors_.requestTemperatures();
+template <typename Filter>
+uint32_t
+BasicThermoSensors<Filter>::GetPeriodMs() const
+{
+    // Wait for conversion, otherwise continue transaction as soon as possible
+    return is_converting_ ? conversion_timeout_ : 0;
+}
+
+template <typename Filter>
+void
+BasicThermoSensors<Filter>::SetAttentionTemperature(Q8_8 temperature)
+{
+    attention_temperature_ = temperature;
+}
+
+template <typename Filter>
+uint8_t
+BasicThermoSensors<Filter>::GetNumOfSensors() const
+{
+    return num_of_sensors_;
+}
+
+template <typename Filter>
+Q8_8
+BasicThermoSensors<Filter>::GetTemperature(uint8_t index) const
+{
+    return (index < num_of_sensors_) ? last_temperatures_[index] : kInvalidTemperature;
+}
+
+template <typename Filter>
+Q8_8
+BasicThermoSensors<Filter>::GetRawTemperature(uint8_t index) const
+{
+    return (index < num_of_sensors_) ? raw_temperatures_[index] : kInvalidTemperature;
+}
+
+template <typename Filter>
+const DeviceAddress&
+BasicThermoSensors<Filter>::GetAddress(uint8_t index) const
+{
+    return addresses_[index];
 }
 
+template <typename Filter>
 void
-ThermoSensors::GetTemperatures(float (&temperatures)[2]) const
+BasicThermoSensors<Filter>::WriteSensors(ResponseWriter& writer) const
 {
-    temperatures[0] = last_temperatures_[0];
-    temperatures[1] = last_temperatures_[1];
+    // N ROM T RAW ROM T RAW ...
+    writer.WriteDecimal(num_of_sensors_);
+    for (uint8_t i = 0; i < num_of_sensors_; ++i) {
+        writer.Write(' ');
+        for (auto byte : addresses_[i]) {
+            writer.WriteHex(byte, 2);
+        }
+        writer.Write(' ');
+        WriteCentiCelsius(writer, last_temperatures_[i]);
+        writer.Write(' ');
+        WriteCentiCelsius(writer, raw_temperatures_[i]);
+    }
 }
 
-float
-ThermoSensors::ConvertByCalibration(float T, DeviceAddress const& sensor_address) const
+template <typename Filter>
+bool
+BasicThermoSensors<Filter>::SetCalibrationPoint(uint8_t index, uint8_t point, Q8_8 raw, Q8_8 reference)
 {
-    if (AreSensorAddressesEqual(sensor_address, kSensorAddress1)) {
-        return (((T - kRawLow1) * kReferenceRange1) / kRawRange1) + kReferenceLow1;
+    if ((index >= num_of_sensors_) || (point > 1)) {
+        return false;
+    }
+
+    auto record_index = FindCalibrationRecord(addresses_[index]);
+    if (record_index == kNumOfCalibrationRecords) {
+        Serial.println(F("ERROR: calibration table is full"));
+        return false;
+    }
+
+    // Sensor, which is calibrated first time, starts from its current calibration, so points can be changed one by one
+    CalibrationRecord record;
+    eeprom_read_block(&record, GetRecordAddress(record_index), sizeof(record));
+    if (record.address[0] == kEmptyRecordMark) {
+        memcpy(record.address, addresses_[index], sizeof(record.address));
+        record.raw[0]       = 0;
+        record.reference[0] = offsets_[index];
+        record.raw[1]       = IntToQ8_8(100);
+        record.reference[1] = (static_cast<int32_t>(record.raw[1]) * gains_[index] >> kGainFractionalBits)
+                              + offsets_[index];
     }
-    else if (AreSensorAddressesEqual(sensor_address, kSensorAddress2)) {
-        return (((T - kRawLow2) * kReferenceRange2) / kRawRange2) + kReferenceLow2;
+    record.raw[point]       = raw;
+    record.reference[point] = reference;
+    if (!CalculateCalibration(index, record.raw, record.reference)) {
+        Serial.println(F("ERROR: calibration points give too small range or wrong gain"));
+        return false;
+    }
+    eeprom_update_block(&record, GetRecordAddress(record_index), sizeof(record));
+    return true;
+}
+
+template <typename Filter>
+bool
+BasicThermoSensors<Filter>::SetCalibrationPointStr(const char* str)
+{
+    // I P RAW REF
+    Serial.print(F("Received command 'Set calibration point' "));
+    Serial.println(str);
+
+    if ((strlen(str) < 7) || (str[1] != ' ') || (str[3] != ' ')) {
+        return false;
+    }
+    auto raw_str       = str + 4;
+    auto reference_str = strchr(raw_str, ' ');
+    if (reference_str == nullptr) {
+        return false;
+    }
+    return SetCalibrationPoint(ParseDecimal(str, 1),
+                               ParseDecimal(str + 2, 1),
+                               FromCentiCelsius(ParseDecimal(raw_str, 5)),
+                               FromCentiCelsius(ParseDecimal(reference_str + 1, 5)));
+}
+
+template <typename Filter>
+void
+BasicThermoSensors<Filter>::FinishSensorReading(Q8_8 raw_temperature)
+{
+    raw_temperatures_[sensor_index_] = raw_temperature;
+    if (raw_temperature == kInvalidTemperature) {
+        last_temperatures_[sensor_index_] = kInvalidTemperature;
+        filters_[sensor_index_].Reset();
+    }
+    else {
+        last_temperatures_[sensor_index_] = filters_[sensor_index_].Apply(SaturateQ8_8(
+            (static_cast<int32_t>(raw_temperature) * gains_[sensor_index_] >> kGainFractionalBits)
+            + offsets_[sensor_index_]));
+    }
+
+    if (++sensor_index_ < num_of_sensors_) {
+        bus_state_ = BusState::kResetForRead;
+        return;
+    }
+
+    auto resolution = ChooseResolution();
+    if (resolution != resolution_) {
+        SetResolution(resolution);
+        bus_state_ = BusState::kResetForConfiguration;
     }
     else {
-        return T;
+        bus_state_ = BusState::kResetForConversion;
+    }
+}
+
+template <typename Filter>
+Q8_8
+BasicThermoSensors<Filter>::DecodeScratchpad() const
+{
+    // Disconnected sensor returns all ones, which also fails CRC check
+    if (OneWire::crc8(scratchpad_, 8) != scratchpad_[8]) {
+        return kInvalidTemperature;
+    }
+
+    // Raw value is in 1/16 C, so Q8.8 value is 16 times bigger. Low bits are undefined for lower resolutions
+    int16_t raw = (static_cast<int16_t>(scratchpad_[1]) << 8) | scratchpad_[0];
+    raw &= ~((1 << (12 - resolution_)) - 1);
+    return SaturateQ8_8(static_cast<int32_t>(raw) * 16);
+}
+
+template <typename Filter>
+uint8_t
+BasicThermoSensors<Filter>::ChooseResolution()
+{
+    Q8_8 hottest{kInvalidTemperature};
+    for (uint8_t i = 0; i < num_of_sensors_; ++i) {
+        hottest = max(hottest, last_temperatures_[i]);
+    }
+    if (hottest == kInvalidTemperature) {
+        return kMaxResolution;
     }
+
+    auto     now = millis();
+    uint32_t elapsed_ms{now - reference_time_};
+    if (elapsed_ms >= kRateWindowMs) {
+        if (reference_temperature_ != kInvalidTemperature) {
+            // rise / elapsed > rate, without division
+            int32_t rise{(static_cast<int32_t>(hottest) - reference_temperature_) * 1000};
+            int32_t elapsed{static_cast<int32_t>(elapsed_ms)};
+            is_rising_fast_ = rise > kFastRiseRate * elapsed;
+            is_rising_      = rise > kRiseRate * elapsed;
+            if (is_rising_) {
+                num_of_stable_windows_ = 0;
+            }
+            else if (num_of_stable_windows_ < kNumOfStableWindowsFor12Bit) {
+                ++num_of_stable_windows_;
+            }
+        }
+        reference_temperature_ = hottest;
+        reference_time_        = now;
+    }
+
+    if (is_rising_fast_) {
+        return kMinResolution;
+    }
+    if (is_rising_ || (hottest >= attention_temperature_)) {
+        return kMinResolution + 1;
+    }
+    if (num_of_stable_windows_ >= kNumOfStableWindowsFor12Bit) {
+        return kMaxResolution;
+    }
+    return resolution_;
+}
+
+template <typename Filter>
+void
+BasicThermoSensors<Filter>::SetResolution(uint8_t resolution)
+{
+    // Conversion time is rounded up: 94, 188, 375, 750 ms
+    uint8_t shift{static_cast<uint8_t>(kMaxResolution - resolution)};
+    resolution_         = resolution;
+    conversion_timeout_ = (750 + (1 << shift) - 1) >> shift;
+}
+
+template <typename Filter>
+void
+BasicThermoSensors<Filter>::LoadCalibration(uint8_t index)
+{
+    CalibrationRecord record;
+    auto              record_index = FindCalibrationRecord(addresses_[index]);
+    if (record_index != kNumOfCalibrationRecords) {
+        eeprom_read_block(&record, GetRecordAddress(record_index), sizeof(record));
+        // Record, which was stored before calibration was checked, can be wrong. Then defaults are used
+        if ((record.address[0] != kEmptyRecordMark) && CalculateCalibration(index, record.raw, record.reference)) {
+            return;
+        }
+    }
+
+    for (const auto& default_calibration : kDefaultCalibrations) {
+        memcpy_P(&record, &default_calibration, sizeof(record));
+        if ((memcmp(record.address, addresses_[index], sizeof(record.address)) == 0)
+            && CalculateCalibration(index, record.raw, record.reference)) {
+            return;
+        }
+    }
+
+    // Not calibrated sensor
+    gains_[index]   = 1 << kGainFractionalBits;
+    offsets_[index] = 0;
 }
+
+template <typename Filter>
+bool
+BasicThermoSensors<Filter>::CalculateCalibration(uint8_t index, const Q8_8 (&raw)[2], const Q8_8 (&reference)[2])
+{
+    // T = raw * gain + offset, where line goes through both calibration points
+    int32_t raw_range{static_cast<int32_t>(raw[1]) - raw[0]};
+    if ((raw_range < kMinCalibrationRange) && (raw_range > -kMinCalibrationRange)) {
+        return false;
+    }
+    int32_t gain{((static_cast<int32_t>(reference[1]) - reference[0]) << kGainFractionalBits) / raw_range};
+    if ((gain < kMinGain) || (gain > kMaxGain)) {
+        return false;
+    }
+
+    filters_[index].Reset();  // History was calibrated differently
+    gains_[index]   = gain;
+    offsets_[index] = SaturateQ8_8(reference[0] - (static_cast<int32_t>(raw[0]) * gain >> kGainFractionalBits));
+    return true;
+}
+
+template class BasicThermoSensors<ThermoSensorsFilter>;
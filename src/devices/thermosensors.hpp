@@ -8,8 +8,23 @@
 #include <DallasTemperature.h>
 #include <OneWire.h>
 
-// Asynchronously reads data from 2 thermal sensors. getTemperatures() returns results of last reading. Temperature is
-// read once per conversion timeout (depends on sensor precision - see below).
+#include "../filter_chain.h"
+#include "../fixed_point.h"
+#include "../response_writer.h"
+#include "../scheduler.h"
+
+// Asynchronously reads data from up to kMaxNumOfSensors thermal sensors, which are found on the bus in Setup().
+// GetTemperature() returns result of last reading. Temperature is read once per conversion timeout (depends on sensor
+// precision - see below).
+//
+// Every sensor has linear calibration, which is stored in EEPROM table keyed by ROM code of the sensor. Table keeps
+// two calibration points (raw reading -> reference temperature), gain and offset are calculated from them when sensor
+// is found or calibration is changed, so each reading costs one multiply-add.
+//
+// OneWire transactions are sliced: each Run() makes only one reset or transfers one byte (at most ~1 ms), and
+// requests to be run again as soon as possible until all scratchpads are read. So reading of sensors never stalls
+// main loop. Cycle: reset, skip ROM, convert T (all sensors at once), wait for conversion, then for each sensor:
+// reset, match ROM, 8 bytes of ROM code, read scratchpad, 9 bytes of scratchpad.
 //
 // Following table is taken from datasheet: https://pdf1.alldatasheet.com/datasheet-pdf/view/58557/DALLAS/DS18B20.html
 // Precision | Conversion timeout | Temperature precision
@@ -17,28 +32,100 @@
 // 10 bit    | 187.5 ms (tconv/4) | 0.25
 // 11 bit    | 375 ms (tconv/2)   | 0.125
 // 12 bit    | 750 ms tconv       | 0.0625
-class ThermoSensors : public IComponent
+//
+// Precision is chosen at runtime after each reading of all sensors. When the hottest sensor heats fast, it is 9 bit,
+// so ThermalController reacts ~8 times faster. Near attention temperature (see SetAttentionTemperature()) or when
+// temperature grows slower, it is 10 bit. When readings are stable for several seconds, it returns to 12 bit.
+//
+// Calibrated temperature of each sensor goes through its own Filter, see filter_chain.h. Raw temperature is not
+// filtered. Filter is reset, when sensor is not read.
+template <typename Filter>
+class BasicThermoSensors
+  : public IComponent
+  , public Scheduler::Task
 {
 public:
-    ThermoSensors(uint8_t pin);
-    void Setup() override;
-    void Loop();
+    BasicThermoSensors(uint8_t pin);
+    void     Setup() override;
+    void     Run() override;
+    uint32_t GetPeriodMs() const override;
+
+    static constexpr uint8_t kMaxNumOfSensors{4};
+    static constexpr Q8_8    kInvalidTemperature{IntToQ8_8(DEVICE_DISCONNECTED_C)};
 
-    void GetTemperatures(float (&temperatures)[2]) const;
+    // Sensors are read faster, when the hottest one is above this temperature
+    void SetAttentionTemperature(Q8_8 temperature);
 
-    static constexpr float kInvalidTemperature{DEVICE_DISCONNECTED_C};
+    uint8_t              GetNumOfSensors() const;
+    Q8_8                 GetTemperature(uint8_t index) const;     // C. kInvalidTemperature if sensor is not read
+    Q8_8                 GetRawTemperature(uint8_t index) const;  // The same, but before calibration
+    const DeviceAddress& GetAddress(uint8_t index) const;
+
+    // Format: N ROM T RAW ROM T RAW ..., ROM is hex, T and RAW (before calibration) are in 0.01 C
+    void WriteSensors(ResponseWriter& writer) const;
+
+    // Sets calibration point and stores it in EEPROM. Point 0 is low, point 1 is high.
+    // Returns false if index or point is out of range, there is no free record in EEPROM, or points are closer than
+    // 5 C (by raw reading) or give gain out of range [0.5, 2). Wrong point is not stored
+    bool SetCalibrationPoint(uint8_t index, uint8_t point, Q8_8 raw, Q8_8 reference);
+    bool SetCalibrationPointStr(const char* str);  // "I P RAW REF", RAW and REF are in 0.01 C
 
 private:
-    float ConvertByCalibration(float T, DeviceAddress const& sensor_address) const;
+    enum class BusState : uint8_t
+    {
+        kResetForConversion,
+        kSkipRom,
+        kConvert,
+        kResetForRead,
+        kMatchRom,
+        kWriteRom,
+        kReadScratchpadCommand,
+        kReadScratchpad,
+        kResetForConfiguration,
+        kSkipRomForConfiguration,
+        kWriteScratchpadCommand,
+        kWriteScratchpad
+    };
+
+    void    FinishSensorReading(Q8_8 raw_temperature);  // Stores calibrated result and moves to the next sensor
+    Q8_8    DecodeScratchpad() const;                   // Returns raw (not calibrated) temperature
+    uint8_t ChooseResolution();                         // Called after all sensors are read
+    void    SetResolution(uint8_t resolution);          // Only updates timeout, sensors are configured by Run()
+    void    LoadCalibration(uint8_t index);
+    // Returns false and keeps current calibration, if points are wrong
+    bool    CalculateCalibration(uint8_t index, const Q8_8 (&raw)[2], const Q8_8 (&reference)[2]);
 
     uint8_t                   pin_;
     OneWire                   oneWire_;
     DallasTemperature         sensors_;
-    static constexpr uint8_t  kNumOfSensors_{2};
-    DeviceAddress             addresses_[kNumOfSensors_];
-    static constexpr uint8_t  resolution_{12};  // 9 bit - 0.5 degrees precision; 12 bit - 0.06 degrees
-    static constexpr uint16_t conversion_timeout_{750 >> (12 - resolution_)};
-    float                     last_temperatures_[kNumOfSensors_];
+    uint8_t                   num_of_sensors_;
+    DeviceAddress             addresses_[kMaxNumOfSensors];
+    uint8_t                   resolution_;  // 9 bit - 0.5 degrees precision; 12 bit - 0.06 degrees
+    uint16_t                  conversion_timeout_;
+    int16_t                   gains_[kMaxNumOfSensors];    // Q2.14
+    Q8_8                      offsets_[kMaxNumOfSensors];  // Q8.8
+    Q8_8                      raw_temperatures_[kMaxNumOfSensors];
+    Q8_8                      last_temperatures_[kMaxNumOfSensors];
+    Filter                    filters_[kMaxNumOfSensors];
+
+    BusState   bus_state_;
+    bool       is_converting_;  // Conversion was started by the last Run()
+    uint8_t    sensor_index_;   // Sensor, which is being read
+    uint8_t    byte_index_;     // Byte of ROM code or scratchpad, which is being transferred
+    ScratchPad scratchpad_;
+
+    // Resolution scheduling
+    Q8_8     attention_temperature_;
+    Q8_8     reference_temperature_;  // The hottest temperature at the start of current rate measurement window
+    uint32_t reference_time_;
+    bool     is_rising_fast_;  // Rates in the last window
+    bool     is_rising_;
+    uint8_t  num_of_stable_windows_;
 };
 
+// Readings of DS18B20 are checked by CRC and change slowly, so they are not filtered. Rate of rise is smoothed by
+// ThermalController anyway. Chain, which is used here, should be instantiated in .cpp
+using ThermoSensorsFilter = FilterChain<>;
+using ThermoSensors       = BasicThermoSensors<ThermoSensorsFilter>;
+
 #endif  // THERMOSENSORS_H_
@@ -4,11 +4,45 @@
 
 #include <Arduino.h>
 #include <DS1307RTC.h>
+#include <Wire.h>
+#include <avr/interrupt.h>
 
-#include "eeprom_map.h"
+#include "../utils.h"
 
 namespace
 {
+constexpr uint8_t kDatetimeStrLength{19};  // HH:MM:SS DD/MM/YYYY
+constexpr uint8_t kAlarmStrMinLength{7};   // I HH:MM
+
+constexpr uint32_t kSyncPeriodMs{600000};  // 10 minutes
+constexpr uint32_t kSyncPollPeriodMs{20};  // Accuracy of finding start of RTC second
+constexpr uint32_t kSyncTimeoutMs{1500};   // RTC seconds do not change, e.g. oscillator is stopped
+// Drift is measured over interval long enough to make polling error small, and short enough to avoid overflow
+constexpr uint32_t kMinDriftIntervalMs{kSyncPeriodMs / 2};
+constexpr uint32_t kMaxDriftIntervalMs{SECS_PER_DAY * 1000};
+constexpr int16_t  kMaxDriftPpm{5000};  // Ceramic resonator is 0.5%. Larger difference means that time was changed
+constexpr int32_t  kMaxTimeStepS{60};   // Larger correction of clock is treated as change of time, not as drift
+constexpr time_t   kNoAlarm{0};
+
+constexpr uint8_t  kRtcSqwPin{2};  // INT0
+constexpr uint8_t  kRtcAddress{0x68};
+constexpr uint8_t  kRtcControlRegister{0x07};
+constexpr uint8_t  kRtcSqwEnable1Hz{0x10};  // SQWE bit, RS bits are 0
+constexpr uint32_t kTickTimeoutMs{2500};    // Ticks are considered lost after this time without them
+
+// Seconds counted by SQW interrupt. 32-bit value is read with interrupts disabled
+volatile uint32_t rtc_ticks{0};
+
+uint32_t
+ReadTicks()
+{
+    uint8_t sreg = SREG;
+    cli();
+    uint32_t result = rtc_ticks;
+    SREG            = sreg;
+    return result;
+}
+
 Timer::DaysOfWeek
 TimelibWDayToDOW(uint8_t c)
 {
@@ -33,210 +67,427 @@ TimelibWDayToDOW(uint8_t c)
 }
 }  // namespace
 
-Timer::Timer(uint32_t reading_period_ms = 500)
+ISR(INT0_vect)
+{
+    ++rtc_ticks;
+}
+
+Timer::Timer(uint32_t reading_period_ms, bool is_tick_mode)
   : reading_period_ms_{reading_period_ms}
-  , last_triggered_alarm_{0xFF, 0xFF, DaysOfWeek::kEveryDay}
   , is_alarm_enabled_{false}
   , alarm_handler_{nullptr}
+  , next_alarm_time_{kNoAlarm}
+  , next_alarm_index_{0}
+  , is_tick_mode_{is_tick_mode}
+  , base_time_{0}
+  , base_ms_{0}
+  , base_ticks_{0}
+  , drift_ppm_{0}
+  , is_time_valid_{false}
+  , is_second_start_{false}
+  , is_syncing_{false}
+  , sync_time_{0}
+  , sync_start_ms_{0}
+  , sync_start_ticks_{0}
+  , last_sync_ms_{0}
+  , last_ticks_{0}
+  , last_tick_ms_{0}
 {
 }
 
 void
 Timer::Setup()
 {
-    alarm_.hour       = eeprom_read_byte(&alarm_hours_address);
-    alarm_.minute     = eeprom_read_byte(&alarm_minutes_address);
-    alarm_.dow        = static_cast<Timer::DaysOfWeek>(eeprom_read_byte(&alarm_dow_address));
-    is_alarm_enabled_ = (eeprom_read_byte(&is_alarm_on_address) == 1);
-
-    Serial.print(F("Read from EEPROM: alarm time "));
-    Serial.print((int)alarm_.hour);
-    Serial.print(F(":"));
-    Serial.print((int)alarm_.minute);
-    Serial.print(F(" DoW= 0x"));
-    Serial.print((int)alarm_.dow, HEX);
-    Serial.print(F(". Alarm is "));
-    Serial.println(is_alarm_enabled_ ? F("enabled") : F("disabled"));
+    // Alarms are restored from ConfigStore by LampController.
+    // Time is read immediately, and the start of second is found by the following runs
+    if (is_tick_mode_) {
+        EnableTickMode();
+    }
+    StartSync();
 }
 
 // We are not using hardware alarm. Reason: there are only 2 alarms. They can be configured to trigger either on
 // specified day of week, either on specified day of month. But in case of SAD Lamp we want alarm to trigger every day.
-// The only option to do it is to check current hour and minute in Arduino's main loop.
+// So time of the next alarm is calculated by software and is compared with time of software clock.
 void
-Timer::CheckAlarm()
+Timer::Run()
 {
-    if ((!is_alarm_enabled_) || (alarm_handler_ == nullptr)) {
-        return;
+    if (is_tick_mode_) {
+        auto ticks = ReadTicks();
+        if (ticks != last_ticks_) {
+            last_ticks_   = ticks;
+            last_tick_ms_ = millis();
+        }
+        else if (millis() - last_tick_ms_ >= kTickTimeoutMs) {
+            Serial.println(F("ERROR: no ticks from RTC SQW output, clock is synchronized with millis()"));
+            DisableTickMode();
+            StartSync();
+        }
     }
 
-    // Do not read from RTC on every iteration of loop(). Reading 2 times per second is quite safe.
-    static uint32_t last_reading_time{0};
-    auto            now = millis();
-    if ((now - last_reading_time) < reading_period_ms_) {
-        return;
+    if (is_syncing_) {
+        PollSync();
     }
-    last_reading_time = now;
-
-    tmElements_t datetime;
-    if (!RTC.read(datetime)) {
-        return;
+    else if (!is_tick_mode_ && (millis() - last_sync_ms_ >= kSyncPeriodMs)) {
+        StartSync();
     }
 
-    bool does_dow_match{(uint8_t)alarm_.dow & (uint8_t)TimelibWDayToDOW(datetime.Wday)};
-    if (does_dow_match && (datetime.Hour == alarm_.hour) && (datetime.Minute == alarm_.minute) &&
-        (datetime.Second == 0)) {
-        // Trigger alarm only once
-        if (!(last_triggered_alarm_ == datetime)) {
-            last_triggered_alarm_ = datetime;
-            alarm_handler_->OnAlarm();
+    if ((next_alarm_time_ != kNoAlarm) && (GetTime() >= next_alarm_time_)) {
+        // Alarm is triggered once, even if it is checked late
+        uint8_t index{next_alarm_index_};
+        CalculateNextAlarm(next_alarm_time_ + 1);
+        if (alarm_handler_ != nullptr) {
+            alarm_handler_->OnAlarm(alarms_[index]);
         }
     }
 }
 
+uint32_t
+Timer::GetPeriodMs() const
+{
+    // Checking alarm 2 times per second is enough, RTC is polled more often only during synchronization
+    return is_syncing_ ? kSyncPollPeriodMs : reading_period_ms_;
+}
+
 void
 Timer::RegisterAlarmHandler(AlarmHandler* alarm_handler)
 {
     alarm_handler_ = alarm_handler;
 }
 
-String
-Timer::GetTimeStr() const
+void
+Timer::WriteTime(ResponseWriter& writer) const
 {
-    tmElements_t datetime;
-    String       result;
-    if (RTC.read(datetime)) {
-        result = DatetimeToStr(datetime);
+    // Nothing is written, if RTC has never been read
+    if (is_time_valid_) {
+        tmElements_t datetime;
+        breakTime(GetTime(), datetime);
+        WriteDatetime(writer, datetime);
     }
-    return result;
 }
 
 time_t
 Timer::GetTime() const
 {
-    return RTC.get();
+    if (is_tick_mode_) {
+        return base_time_ + static_cast<time_t>(ReadTicks() - base_ticks_);
+    }
+
+    // Elapsed time is split, so correction does not overflow even if clock is not synchronized for days
+    uint32_t elapsed_ms = millis() - base_ms_;
+    int32_t  correction_ms{static_cast<int32_t>(elapsed_ms / 1000000) * drift_ppm_};
+    correction_ms += static_cast<int32_t>(elapsed_ms % 1000000) / 1000 * drift_ppm_ / 1000;
+    return base_time_ + static_cast<time_t>((elapsed_ms + correction_ms) / 1000);
 }
 
 void
-Timer::SetTimeStr(const String& str) const
+Timer::SetTime(time_t time)
 {
     Serial.print(F("Received command 'Set time' "));
-    Serial.println(str);
+    Serial.println(time);
 
-    auto datetime{StrToDatetime(str)};
-    RTC.write(datetime);
+    StoreTime(time);
 }
 
 void
-Timer::SetAlarmStr(const String& str)
+Timer::SetTimeStr(const char* str)
+{
+    Serial.print(F("Received command 'Set time' "));
+    Serial.println(str);
+
+    if (strlen(str) < kDatetimeStrLength) {
+        Serial.println(F("ERROR: wrong datetime format"));
+        return;
+    }
+
+    StoreTime(makeTime(StrToDatetime(str)));
+}
+
+bool
+Timer::SetAlarmStr(const char* str)
 {
     Serial.print(F("Received command 'Set alarm' "));
     Serial.println(str);
 
-    alarm_ = StrToAlarm(str);
+    // I HH:MM [WW [MMMM [BBBB]]]
+    if ((strlen(str) < kAlarmStrMinLength) || (str[0] < '0') || (str[0] > '9') || (str[1] != ' ')) {
+        Serial.println(F("ERROR: wrong alarm format"));
+        return false;
+    }
+
+    return SetAlarm(str[0] - '0', StrToAlarm(str + 2));
+}
+
+bool
+Timer::SetAlarm(uint8_t index, const AlarmData& alarm)
+{
+    if ((index >= kMaxNumOfAlarms) || (alarm.hour > 23) || (alarm.minute > 59)
+        || (alarm.sunrise_duration_min > kMaxSunriseDurationMin) || (alarm.brightness > kMaxBrightness)) {
+        Serial.println(F("ERROR: wrong alarm"));
+        return false;
+    }
 
-    // Store new alarm value in EEPROM
-    eeprom_write_byte(&alarm_hours_address, alarm_.hour);
-    eeprom_write_byte(&alarm_minutes_address, alarm_.minute);
-    eeprom_write_byte(&alarm_dow_address, (uint8_t)(alarm_.dow));
+    alarms_[index]          = alarm;
+    alarms_[index].dow      = static_cast<DaysOfWeek>(static_cast<uint8_t>(alarm.dow) & 0x7F);
+    alarms_[index].reserved = 0;
+    CalculateNextAlarm(GetTime());
 
-    Serial.print(F("Stored to EEPROM alarm at "));
-    Serial.print((int)alarm_.hour);
+    Serial.print(F("Alarm "));
+    Serial.print(index);
+    Serial.print(F(" is set at "));
+    Serial.print((int)alarm.hour);
     Serial.print(F(":"));
-    Serial.print((int)alarm_.minute);
+    Serial.print((int)alarm.minute);
     Serial.print(F(" DoW= 0x"));
-    Serial.println((int)alarm_.dow, HEX);
+    Serial.println((int)alarms_[index].dow, HEX);
+    return true;
 }
 
-String
-Timer::GetAlarmStr() const
+const Timer::AlarmData&
+Timer::GetAlarm(uint8_t index) const
 {
-    // E HH:MM WW
-    char str[11];
+    return alarms_[index];
+}
 
-    str[0] = (is_alarm_enabled_) ? 'E' : 'D';
-    str[1] = ' ';
+bool
+Timer::WriteAlarm(ResponseWriter& writer, uint8_t index) const
+{
+    if (index >= kMaxNumOfAlarms) {
+        return false;
+    }
 
-    // A terminating null character is automatically appended by snprintf
-    snprintf_P(str + 2, 9, PSTR("%02d:%02d %02x"), alarm_.hour, alarm_.minute, (uint8_t)alarm_.dow);
-    return String(str);
+    // E I HH:MM WW MMMM BBBB
+    const auto& alarm = alarms_[index];
+    writer.Write(is_alarm_enabled_ ? 'E' : 'D')
+        .Write(' ')
+        .WriteDecimal(index)
+        .Write(' ')
+        .WriteDecimal(alarm.hour, 2)
+        .Write(':')
+        .WriteDecimal(alarm.minute, 2)
+        .Write(' ')
+        .WriteHex(static_cast<uint8_t>(alarm.dow), 2)
+        .Write(' ')
+        .WriteDecimal(alarm.sunrise_duration_min, 4)
+        .Write(' ')
+        .WriteDecimal(alarm.brightness, 4);
+    return true;
 }
 
 bool
-Timer::EnableAlarmStr(const String& str)
+Timer::EnableAlarmStr(const char* str)
 {
     Serial.print(F("Received command 'Enable alarm' "));
     Serial.println(str);
 
     if (str[0] == 'E') {
-        if (!is_alarm_enabled_) {
-            ToggleAlarm();
-        }
+        EnableAlarm(true);
         return true;
     }
     else if (str[0] == 'D') {
-        if (is_alarm_enabled_) {
-            ToggleAlarm();
-        }
+        EnableAlarm(false);
         return true;
     }
     return false;
 }
 
 void
-Timer::ToggleAlarm()
+Timer::EnableAlarm(bool is_enabled)
 {
-    if (is_alarm_enabled_) {
-        is_alarm_enabled_ = false;
-        eeprom_write_byte(&is_alarm_on_address, 0);
-    }
-    else {
-        is_alarm_enabled_ = true;
-        eeprom_write_byte(&is_alarm_on_address, 1);
+    if (is_enabled != is_alarm_enabled_) {
+        ToggleAlarm();
     }
+}
+
+bool
+Timer::IsAlarmEnabled() const
+{
+    return is_alarm_enabled_;
+}
+
+void
+Timer::ToggleAlarm()
+{
+    is_alarm_enabled_ = !is_alarm_enabled_;
+    CalculateNextAlarm(GetTime());
 
     Serial.print(F("Alarm is "));
     Serial.println(is_alarm_enabled_ ? F("enabled") : F("disabled"));
 }
 
 Timer::AlarmData::AlarmData()
-  : AlarmData(0, 0, Timer::DaysOfWeek::kEveryDay)
+  : AlarmData(0, 0, Timer::DaysOfWeek::kNone)
 {
 }
 
-Timer::AlarmData::AlarmData(uint8_t h, uint8_t m, DaysOfWeek dw)
-  : hour{h}
+Timer::AlarmData::AlarmData(uint8_t h, uint8_t m, DaysOfWeek dw, uint16_t duration_min, uint16_t b)
+  : sunrise_duration_min{duration_min}
+  , brightness{b}
+  , hour{h}
   , minute{m}
   , dow{dw}
+  , reserved{0}
 {
 }
 
-Timer::AlarmData&
-Timer::AlarmData::operator=(const tmElements_t& time_elements)
+void
+Timer::StoreTime(time_t time)
 {
-    hour   = time_elements.Hour;
-    minute = time_elements.Minute;
-    // Do NOT take DoW into account
-    return *this;
+    if (!RTC.set(time)) {
+        Serial.println(F("ERROR: can't write time to RTC"));
+        return;
+    }
+
+    // Writing seconds resets divider of DS1307, so its second starts now. Drift is not measured over change of time
+    is_second_start_ = false;
+    Synchronize(time, millis(), true);
 }
 
-bool
-Timer::AlarmData::operator==(const tmElements_t& time_elements) const
+void
+Timer::EnableTickMode()
+{
+    pinMode(kRtcSqwPin, INPUT_PULLUP);  // SQW is open drain output
+    EICRA = (EICRA & ~(_BV(ISC01) | _BV(ISC00))) | _BV(ISC01);  // Falling edge
+    EIMSK |= _BV(INT0);
+
+    Wire.beginTransmission(kRtcAddress);
+    Wire.write(kRtcControlRegister);
+    Wire.write(kRtcSqwEnable1Hz);
+    Wire.endTransmission();
+
+    last_ticks_   = ReadTicks();
+    last_tick_ms_ = millis();
+}
+
+void
+Timer::DisableTickMode()
+{
+    EIMSK &= ~_BV(INT0);
+    is_tick_mode_    = false;
+    is_second_start_ = false;
+    is_syncing_      = false;
+}
+
+void
+Timer::StartSync()
+{
+    auto time = RTC.get();
+    if (time == 0) {
+        Serial.println(F("ERROR: can't read time from RTC"));
+        last_sync_ms_ = millis();
+        return;
+    }
+
+    // Until the start of second is found, time is used as is
+    if (!is_time_valid_) {
+        Synchronize(time, millis(), false);
+    }
+    sync_time_        = time;
+    sync_start_ms_    = millis();
+    sync_start_ticks_ = ReadTicks();
+    is_syncing_       = true;
+}
+
+void
+Timer::PollSync()
+{
+    if (is_tick_mode_) {
+        // RTC is read right after tick, so its seconds are not changed during reading. Ticks are checked by Run()
+        if (ReadTicks() != sync_start_ticks_) {
+            auto time   = RTC.get();
+            is_syncing_ = false;
+            if (time != 0) {
+                Synchronize(time, millis(), true);
+            }
+        }
+        return;
+    }
+
+    auto time = RTC.get();
+    auto now  = millis();
+    if (time == 0) {
+        is_syncing_   = false;
+        last_sync_ms_ = now;
+    }
+    else if (time != sync_time_) {
+        is_syncing_ = false;
+        Synchronize(time, now, true);
+    }
+    else if (now - sync_start_ms_ >= kSyncTimeoutMs) {
+        is_syncing_ = false;
+        Synchronize(time, now, false);
+    }
+}
+
+void
+Timer::Synchronize(time_t time, uint32_t time_ms, bool is_second_start)
+{
+    if (!is_tick_mode_ && is_second_start && is_second_start_) {
+        // Drift is difference between time elapsed by RTC and by millis() since the previous start of second
+        uint32_t elapsed_ms = time_ms - base_ms_;
+        int32_t  elapsed_s  = static_cast<int32_t>(time - base_time_);
+        if ((elapsed_ms >= kMinDriftIntervalMs) && (elapsed_ms <= kMaxDriftIntervalMs) && (elapsed_s > 0) &&
+            (static_cast<uint32_t>(elapsed_s) <= kMaxDriftIntervalMs / 1000)) {
+            int32_t error_ms = elapsed_s * 1000L - static_cast<int32_t>(elapsed_ms);
+            if (abs(error_ms) <= static_cast<int32_t>(elapsed_ms / 1000) * kMaxDriftPpm / 1000) {
+                int32_t drift_ppm = error_ms * 1000 / static_cast<int32_t>(elapsed_ms / 1000);
+                drift_ppm_ += (drift_ppm - drift_ppm_) / 4;
+            }
+        }
+    }
+
+    bool    was_time_valid{is_time_valid_};
+    int32_t step_s = static_cast<int32_t>(time - GetTime());
+
+    base_time_       = time;
+    base_ms_         = time_ms;
+    base_ticks_      = ReadTicks();
+    is_second_start_ = is_second_start;
+    is_time_valid_   = true;
+    last_sync_ms_    = time_ms;
+
+    // Small correction keeps the next alarm, so it is triggered, even if software clock has passed it
+    if (!was_time_valid || (abs(step_s) > kMaxTimeStepS)) {
+        CalculateNextAlarm(GetTime());
+    }
+}
+
+void
+Timer::CalculateNextAlarm(time_t from)
 {
-    // Do NOT take DoW into account
-    return ((hour == time_elements.Hour) && (minute == time_elements.Minute));
+    next_alarm_time_ = kNoAlarm;
+    if (!is_alarm_enabled_ || !is_time_valid_) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < kMaxNumOfAlarms; ++i) {
+        // Alarm of the same day could be already passed, so the same day of week is checked again a week later
+        const auto& data  = alarms_[i];
+        time_t      alarm = previousMidnight(from) + data.hour * SECS_PER_HOUR + data.minute * SECS_PER_MIN;
+        for (uint8_t day = 0; day <= DAYS_PER_WEEK; ++day, alarm += SECS_PER_DAY) {
+            auto dow = static_cast<uint8_t>(TimelibWDayToDOW(dayOfWeek(alarm)));
+            if ((static_cast<uint8_t>(data.dow) & dow) && (alarm >= from)) {
+                if ((next_alarm_time_ == kNoAlarm) || (alarm < next_alarm_time_)) {
+                    next_alarm_time_  = alarm;
+                    next_alarm_index_ = i;
+                }
+                break;
+            }
+        }
+    }
 }
 
 tmElements_t
-Timer::StrToDatetime(const String& str) const
+Timer::StrToDatetime(const char* str) const
 {
     tmElements_t tm;
     // HH:MM:SS DD/MM/YYYY
-    tm.Hour   = str.substring(0, 2).toInt();
-    tm.Minute = str.substring(3, 5).toInt();
-    tm.Second = str.substring(6, 8).toInt();
-    tm.Day    = str.substring(9, 11).toInt();
-    tm.Month  = str.substring(12, 14).toInt();
-    tm.Year   = CalendarYrToTm(str.substring(15, 19).toInt());
+    tm.Hour   = ParseDecimal(str, 2);
+    tm.Minute = ParseDecimal(str + 3, 2);
+    tm.Second = ParseDecimal(str + 6, 2);
+    tm.Day    = ParseDecimal(str + 9, 2);
+    tm.Month  = ParseDecimal(str + 12, 2);
+    tm.Year   = CalendarYrToTm(ParseDecimal(str + 15, 4));
 
     // We have to set week day manually, because DS1307RTC library doesn't do it.
     // We are doing this calculation by building time_t (seconds since 19700) from input data and by converting it
@@ -248,37 +499,44 @@ Timer::StrToDatetime(const String& str) const
 }
 
 Timer::AlarmData
-Timer::StrToAlarm(const String& str) const
+Timer::StrToAlarm(const char* str) const
 {
-    // HH:MM
-    uint8_t h = str.substring(0, 2).toInt();
-    uint8_t m = str.substring(3, 5).toInt();
-
-    DaysOfWeek dow = DaysOfWeek::kEveryDay;
-    if (str.length() >= 7) {
-        auto res = strtoul(str.substring(6, 8).c_str(), 0, 16);
-        if (!((res == 0) || (res == ULONG_MAX))) {
-            dow = static_cast<Timer::DaysOfWeek>(res & 0x7F);
+    // HH:MM [WW [MMMM [BBBB]]]
+    AlarmData alarm{static_cast<uint8_t>(ParseDecimal(str, 2)), static_cast<uint8_t>(ParseDecimal(str + 3, 2)),
+                    DaysOfWeek::kEveryDay};
+
+    auto length = strlen(str);
+    if (length >= 8) {
+        // 00 means that alarm is not used
+        char dow_str[3] = {str[6], str[7], 0};
+        auto res        = strtoul(dow_str, 0, 16);
+        if (res != ULONG_MAX) {
+            alarm.dow = static_cast<Timer::DaysOfWeek>(res & 0x7F);
         }
     }
+    if (length >= 10) {
+        alarm.sunrise_duration_min = ParseDecimal(str + 9, 4);
+    }
+    if (length >= 15) {
+        alarm.brightness = ParseDecimal(str + 14, 4);
+    }
+
+    return alarm;
+}
 
-    return Timer::AlarmData{h, m, dow};
-}
-
-String
-Timer::DatetimeToStr(const tmElements_t& datetime) const
-{
-    // H:MM:SS DD/MM/YYYY
-    char str[20];
-    // A terminating null character is automatically appended by snprintf
-    snprintf_P(str,
-               20,
-               PSTR("%02d:%02d:%02d %02d/%02d/%04d"),
-               datetime.Hour,
-               datetime.Minute,
-               datetime.Second,
-               datetime.Day,
-               datetime.Month,
-               tmYearToCalendar(datetime.Year));
-    return String(str);
+void
+Timer::WriteDatetime(ResponseWriter& writer, const tmElements_t& datetime) const
+{
+    // HH:MM:SS DD/MM/YYYY
+    writer.WriteDecimal(datetime.Hour, 2)
+        .Write(':')
+        .WriteDecimal(datetime.Minute, 2)
+        .Write(':')
+        .WriteDecimal(datetime.Second, 2)
+        .Write(' ')
+        .WriteDecimal(datetime.Day, 2)
+        .Write('/')
+        .WriteDecimal(datetime.Month, 2)
+        .Write('/')
+        .WriteDecimal(tmYearToCalendar(datetime.Year), 4);
 }
@@ -4,20 +4,47 @@
 #include "IComponent.h"
 
 #include <TimeLib.h>
-#include <WString.h>
 #include <binary.h>
 
-class Timer : public IComponent
+#include "../response_writer.h"
+#include "../scheduler.h"
+
+// Time is kept by software clock, which is advanced by millis() and is synchronized with DS1307 every
+// kSyncPeriodMs, so reading time and checking alarm do not need I2C transactions.
+//
+// RTC has resolution of 1 second, so on synchronization RTC is polled until its seconds change. The moment of change
+// is the start of a second with accuracy of polling period. Difference between time elapsed by RTC and by millis()
+// between two such moments gives drift of MCU clock, which is compensated between synchronizations.
+//
+// In tick mode DS1307 outputs 1 Hz square wave on SQW pin, which should be connected to pin 2 (INT0). Interrupt on
+// its falling edge (the moment when RTC seconds are incremented) advances seconds counter, so the clock is exact
+// without drift compensation, and RTC is read only at start and after time is set. If ticks stop coming (e.g. SQW
+// is not connected), Timer falls back to synchronization with millis().
+//
+// There is a table of kMaxNumOfAlarms alarms, and all of them are switched on and off together by EnableAlarm().
+// Alarms are not compared with the current hour and minute. Time and index of the next alarm are calculated in advance,
+// when alarms or time are changed, and after each alarm. So checking is one comparison, and alarm is not missed, if
+// loop is stalled during the alarm second. If several alarms have the same time, only the first one is triggered.
+class Timer
+  : public IComponent
+  , public Scheduler::Task
 {
 public:
+    static constexpr uint8_t  kMaxNumOfAlarms{4};
+    static constexpr uint16_t kMaxSunriseDurationMin{1440};
+    static constexpr uint16_t kMaxBrightness{1023};
+
+    struct AlarmData;
+
     class AlarmHandler
     {
     public:
-        virtual void OnAlarm() = 0;
+        virtual void OnAlarm(const AlarmData& alarm) = 0;
     };
 
     enum class DaysOfWeek : uint8_t
     {
+        kNone      = B00000000,  // Alarm is not used
         kMonday    = B00000001,
         kTuesday   = B00000010,
         kWednesday = B00000100,
@@ -28,42 +55,75 @@ public:
         kEveryDay  = B01111111
     };
 
-    explicit Timer(uint32_t reading_period_ms = 500);
-    void Setup() override;
-    void CheckAlarm();
-
-    void   SetAlarmStr(const String& str);
-    String GetAlarmStr() const;
-    bool   EnableAlarmStr(const String& str);
-    void   RegisterAlarmHandler(AlarmHandler* alarm_handler);
-    void   ToggleAlarm();
-
-    void   SetTimeStr(const String& str) const;
-    String GetTimeStr() const;
-    time_t GetTime() const;
-
-private:
+    // Struct is stored by ConfigStore as is
     struct AlarmData
     {
         AlarmData();
-        AlarmData(uint8_t h, uint8_t m, DaysOfWeek dw);
-        AlarmData& operator=(const tmElements_t& time_elements);
-        bool       operator==(const tmElements_t& time_elements) const;
+        AlarmData(uint8_t h, uint8_t m, DaysOfWeek dw, uint16_t duration_min = 0, uint16_t b = kMaxBrightness);
 
+        uint16_t   sunrise_duration_min;  // 0 - default duration of LedDriver
+        uint16_t   brightness;            // Brightness at the end of sunrise [0..1023]
         uint8_t    hour;
         uint8_t    minute;
         DaysOfWeek dow;
+        uint8_t    reserved;  // Should be 0. Keeps struct without padding bytes
     };
 
-    tmElements_t StrToDatetime(const String& str) const;
-    AlarmData    StrToAlarm(const String& str) const;
-    String       DatetimeToStr(const tmElements_t& datetime) const;
+    explicit Timer(uint32_t reading_period_ms = 500, bool is_tick_mode = false);
+    void     Setup() override;  // Reads time from RTC
+    void     Run() override;    // Synchronizes clock with RTC and checks alarm
+    uint32_t GetPeriodMs() const override;
+
+    bool             SetAlarm(uint8_t index, const AlarmData& alarm);  // Returns false for wrong index or values
+    bool             SetAlarmStr(const char* str);                     // I HH:MM [WW [MMMM [BBBB]]]
+    const AlarmData& GetAlarm(uint8_t index) const;
+    bool             WriteAlarm(ResponseWriter& writer, uint8_t index) const;  // E I HH:MM WW MMMM BBBB
+    void             EnableAlarm(bool is_enabled);
+    bool             EnableAlarmStr(const char* str);
+    bool             IsAlarmEnabled() const;
+    void             RegisterAlarmHandler(AlarmHandler* alarm_handler);
+    void             ToggleAlarm();
+
+    void   SetTime(time_t time);
+    void   SetTimeStr(const char* str);
+    void   WriteTime(ResponseWriter& writer) const;  // HH:MM:SS DD/MM/YYYY
+    time_t GetTime() const;
+
+private:
+    void StoreTime(time_t time);
+    void EnableTickMode();
+    void DisableTickMode();
+    void StartSync();
+    void PollSync();  // Waits for the start of RTC second (tick in tick mode)
+    void Synchronize(time_t time, uint32_t time_ms, bool is_second_start);
+    void CalculateNextAlarm(time_t from);  // The first alarm not earlier than <from>
+
+    tmElements_t StrToDatetime(const char* str) const;
+    AlarmData    StrToAlarm(const char* str) const;  // HH:MM [WW [MMMM [BBBB]]]
+    void         WriteDatetime(ResponseWriter& writer, const tmElements_t& datetime) const;
 
     const uint32_t reading_period_ms_;
-    AlarmData      alarm_;
-    AlarmData      last_triggered_alarm_;
+    AlarmData      alarms_[kMaxNumOfAlarms];
     bool           is_alarm_enabled_;
     AlarmHandler*  alarm_handler_;
+    time_t         next_alarm_time_;  // kNoAlarm, if alarms are disabled or none of them is used
+    uint8_t        next_alarm_index_;
+
+    // Software clock: time was base_time_ at base_ms_ (millis) or at base_ticks_ in tick mode
+    bool     is_tick_mode_;
+    time_t   base_time_;
+    uint32_t base_ms_;
+    uint32_t base_ticks_;
+    int16_t  drift_ppm_;        // Positive, if millis() is slower than RTC
+    bool     is_time_valid_;    // RTC was read at least once
+    bool     is_second_start_;  // base_ms_ is the start of a second, so drift can be measured since it
+    bool     is_syncing_;       // Waiting for the start of RTC second
+    time_t   sync_time_;        // RTC time, when synchronization started
+    uint32_t sync_start_ms_;
+    uint32_t sync_start_ticks_;
+    uint32_t last_sync_ms_;
+    uint32_t last_ticks_;    // Ticks seen by the previous run...
+    uint32_t last_tick_ms_;  // ...and when they were changed
 };
 
 #endif  // TIMER_H_
@@ -0,0 +1,140 @@
+#include "dimming_curve.h"
+
+#include <Arduino.h>
+
+#include "progmem_table.h"
+
+namespace
+{
+// Math for curve generators. It is evaluated only by compiler, so precision is more important than speed.
+constexpr double kLn2{0.693147180559945309};
+constexpr double kLn10{2.302585092994045684};
+
+constexpr double
+Square(double x)
+{
+    return x * x;
+}
+
+// 2 * (z + z^3 / 3 + z^5 / 5 + ...) = ln((1 + z) / (1 - z)). It converges fast for |z| <= 1/3
+constexpr double
+LnSeries(double z2, double term, uint8_t n)
+{
+    return (n > 41) ? 0 : (term / n + LnSeries(z2, term * z2, n + 2));
+}
+
+// x should be in range (0, 1]. It is scaled to [0.5, 1] first, so series converges fast
+constexpr double
+Ln(double x)
+{
+    return (x < 0.5) ? (Ln(x * 2) - kLn2) : (2 * LnSeries(Square((x - 1) / (x + 1)), (x - 1) / (x + 1), 1));
+}
+
+constexpr double
+ExpSeries(double y, double term, uint8_t n)
+{
+    return (n > 20) ? term : (term + ExpSeries(y, term * y / n, n + 1));
+}
+
+// e^y = (e^(y / 2))^2 until |y| is small enough for Taylor series
+constexpr double
+Exp(double y)
+{
+    return ((y < -0.5) || (y > 0.5)) ? Square(Exp(y / 2)) : ExpSeries(y, 1, 1);
+}
+
+constexpr double
+Pow(double x, double power)
+{
+    return (x <= 0) ? 0 : Exp(power * Ln(x));
+}
+
+// Curves map x in range [0, 1] to relative luminance in range [0, 1]
+struct Cie1931
+{
+    static constexpr double
+    Luminance(double lightness)
+    {
+        return (lightness <= 8) ? (lightness / 903.3) : Pow((lightness + 16) / 116, 3);
+    }
+
+    static constexpr double
+    Evaluate(double x)
+    {
+        return Luminance(x * 100);
+    }
+};
+
+struct DaliLogarithmic
+{
+    // 10^(3 * (x - 1)): 0.1% at the first step, 100% at the last one. 0 is off
+    static constexpr double
+    Evaluate(double x)
+    {
+        return (x <= 0) ? 0 : Exp(3 * (x - 1) * kLn10);
+    }
+};
+
+template <uint8_t GammaTenths>
+struct Gamma
+{
+    static constexpr double
+    Evaluate(double x)
+    {
+        return Pow(x, GammaTenths / 10.0);
+    }
+};
+
+// Table of 2^SegmentBits + 1 points of the curve, for ProgmemTable
+template <typename Curve, uint8_t SegmentBits = 6>
+struct CurveTable
+{
+    using ValueType = uint16_t;
+    static constexpr uint8_t  kSegmentBits{SegmentBits};
+    static constexpr uint16_t kNumOfSegments{1 << SegmentBits};
+    static constexpr uint16_t kSize{kNumOfSegments + 1};
+
+    static constexpr ValueType
+    Value(uint16_t index)
+    {
+        return static_cast<ValueType>(Curve::Evaluate(static_cast<double>(index) / kNumOfSegments) * 0xFFFF + 0.5);
+    }
+};
+
+static_assert(CurveTable<Cie1931>::Value(0) == 0, "Curve should start from 0");
+static_assert(CurveTable<Cie1931>::Value(CurveTable<Cie1931>::kNumOfSegments) == 0xFFFF, "Curve should end at max");
+static_assert(CurveTable<DaliLogarithmic>::Value(CurveTable<DaliLogarithmic>::kNumOfSegments) == 0xFFFF,
+              "Curve should end at max");
+static_assert(CurveTable<Gamma<22>>::Value(CurveTable<Gamma<22>>::kNumOfSegments) == 0xFFFF,
+              "Curve should end at max");
+
+template <typename Table>
+uint16_t
+Interpolate(uint16_t position)
+{
+    constexpr uint8_t kFractionBits{16 - Table::kSegmentBits};
+
+    uint16_t index{static_cast<uint16_t>(position >> kFractionBits)};
+    uint16_t fraction = position & ((1U << kFractionBits) - 1);
+    uint16_t low{pgm_read_word(&ProgmemTable<Table>::kValues[index])};
+    uint16_t high{pgm_read_word(&ProgmemTable<Table>::kValues[index + 1])};
+    // Curves are monotonic, so high >= low
+    return low + ((static_cast<uint32_t>(high - low) * fraction) >> kFractionBits);
+}
+}  // namespace
+
+uint16_t
+ApplyDimmingCurve(DimmingCurve curve, uint16_t position)
+{
+    switch (curve) {
+    case DimmingCurve::kCie1931:
+        return Interpolate<CurveTable<Cie1931>>(position);
+    case DimmingCurve::kDaliLogarithmic:
+        return Interpolate<CurveTable<DaliLogarithmic>>(position);
+    case DimmingCurve::kGamma22:
+        return Interpolate<CurveTable<Gamma<22>>>(position);
+    default:
+        // Linear curve does not need a table
+        return position;
+    }
+}
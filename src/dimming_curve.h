@@ -0,0 +1,23 @@
+#ifndef DIMMING_CURVE_H_
+#define DIMMING_CURVE_H_
+
+#include <stdint.h>
+
+// Dimming curve maps linear position of brightness control (e.g. progress of sunrise) to PWM level, so eyes perceive
+// brightness as changing uniformly. Every curve is a table, which is generated at compile time and stored in flash.
+// Values between table entries are linearly interpolated.
+//
+// Values are used in serial protocol and stored in EEPROM, so they should not be changed
+enum class DimmingCurve : uint8_t
+{
+    kCie1931 = 0,      // CIE 1931 lightness
+    kDaliLogarithmic,  // Logarithmic curve of DALI standard: 0.1% .. 100%
+    kGamma22,          // Gamma 2.2
+    kLinear,
+    kNumOfCurves
+};
+
+// position and result are full scale 16-bit values: 0 is off, 0xFFFF is maximal brightness
+uint16_t ApplyDimmingCurve(DimmingCurve curve, uint16_t position);
+
+#endif  // DIMMING_CURVE_H_
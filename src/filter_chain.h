@@ -0,0 +1,151 @@
+#ifndef FILTER_CHAIN_H_
+#define FILTER_CHAIN_H_
+
+#include <stdint.h>
+
+#include "fixed_point.h"
+
+// Filters for sampled signals, e.g. raw ADC value or Q8.8 temperature. Samples are int16_t.
+//
+// Each filter stage is a class, which owns its state and has two methods:
+//     int16_t Apply(int16_t value);  // Takes new sample and returns filtered value
+//     void    Reset();               // Forgets history, the next sample is taken as is
+// Stages are combined by FilterChain, e.g. FilterChain<Median<3>, AdaptiveEma<3, 9, 10>>. Chain is chosen at
+// compile time, so all calls are inlined and there is no runtime dispatch. Stages start from the first sample, so
+// filtered value doesn't ramp up from 0 after start or Reset().
+
+// Median of the last Size samples. Removes single spikes, which are shorter than half of window
+template <uint8_t Size>
+class Median
+{
+    static_assert((Size % 2 == 1) && (Size <= 9), "Size should be odd and not greater than 9");
+
+public:
+    int16_t
+    Apply(int16_t value)
+    {
+        if (is_empty_) {
+            for (auto& sample : samples_) {
+                sample = value;
+            }
+            is_empty_ = false;
+        }
+        samples_[position_] = value;
+        if (++position_ == Size) {
+            position_ = 0;
+        }
+
+        // Window is small, so insertion sort of its copy is the fastest way
+        int16_t sorted[Size];
+        for (uint8_t i = 0; i < Size; ++i) {
+            uint8_t j = i;
+            for (; (j > 0) && (sorted[j - 1] > samples_[i]); --j) {
+                sorted[j] = sorted[j - 1];
+            }
+            sorted[j] = samples_[i];
+        }
+        return sorted[Size / 2];
+    }
+
+    void
+    Reset()
+    {
+        is_empty_ = true;
+        position_ = 0;
+    }
+
+private:
+    int16_t samples_[Size];
+    uint8_t position_{0};  // Where the next sample is written
+    bool    is_empty_{true};
+};
+
+// Exponential moving average, which adapts to fast changes of signal (https://alexgyver.ru/lessons/filters/).
+// Filtered value moves towards sample by KSlow/10 of difference, or by KFast/10 if difference is greater than
+// Threshold. So noise is smoothed, but big steps are followed quickly.
+template <uint8_t KSlow, uint8_t KFast, uint16_t Threshold>
+class AdaptiveEma
+{
+    static_assert((KSlow > 0) && (KSlow <= KFast) && (KFast <= 10), "Factors should be in range [1, 10] tenths");
+
+public:
+    int16_t
+    Apply(int16_t value)
+    {
+        int32_t target = static_cast<int32_t>(value) << kStateFractionalBits;
+        if (is_empty_) {
+            state_    = target;
+            is_empty_ = false;
+            return value;
+        }
+
+        int32_t delta = target - state_;
+        Q8_8    k{kSlow};
+        if ((delta > kThreshold) || (delta < -kThreshold)) {
+            k = kFast;
+        }
+        state_ += MultiplyQ8_8(delta, k);
+        return (state_ + (1L << (kStateFractionalBits - 1))) >> kStateFractionalBits;
+    }
+
+    void
+    Reset()
+    {
+        is_empty_ = true;
+    }
+
+private:
+    // State keeps fractional bits, so slow changes are not lost. 6 bits keep multiplication by Q8.8 factor in 32 bits
+    // for any difference of int16_t samples
+    static constexpr uint8_t kStateFractionalBits{6};
+    static constexpr int32_t kThreshold{static_cast<int32_t>(Threshold) << kStateFractionalBits};
+    static constexpr Q8_8    kSlow{(KSlow * kQ8_8One + 5) / 10};
+    static constexpr Q8_8    kFast{(KFast * kQ8_8One + 5) / 10};
+
+    int32_t state_{0};  // Filtered value with kStateFractionalBits
+    bool    is_empty_{true};
+};
+
+template <typename... Stages>
+class FilterChain;
+
+// Empty chain passes samples as is
+template <>
+class FilterChain<>
+{
+public:
+    int16_t
+    Apply(int16_t value)
+    {
+        return value;
+    }
+
+    void
+    Reset()
+    {
+    }
+};
+
+// Sample goes through First, then through the rest of stages. The rest is a base class, so empty tail takes no memory
+template <typename First, typename... Rest>
+class FilterChain<First, Rest...> : private FilterChain<Rest...>
+{
+public:
+    int16_t
+    Apply(int16_t value)
+    {
+        return FilterChain<Rest...>::Apply(first_.Apply(value));
+    }
+
+    void
+    Reset()
+    {
+        first_.Reset();
+        FilterChain<Rest...>::Reset();
+    }
+
+private:
+    First first_;
+};
+
+#endif  // FILTER_CHAIN_H_
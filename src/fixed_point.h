@@ -0,0 +1,51 @@
+#ifndef FIXED_POINT_H_
+#define FIXED_POINT_H_
+
+#include <stdint.h>
+
+// Firmware doesn't use float: ATmega328P has no FPU, so every float operation is a call into soft-float library,
+// which costs hundreds of cycles and kilobytes of flash. Fractional values are stored in Q8.8 format instead:
+// int16_t with 8 fractional bits. Range is [-128, 128), resolution is 1/256.
+//
+// Temperatures (C) and factors in range [0, 1] (ex. thermal factor of LED) use this format.
+using Q8_8 = int16_t;
+
+constexpr uint8_t kQ8_8FractionalBits{8};
+constexpr Q8_8    kQ8_8One{1 << kQ8_8FractionalBits};
+
+// Converts constant to Q8.8. It is intended for compile time only, so it should be used only for initialization of
+// constexpr values.
+constexpr Q8_8
+ToQ8_8(double value)
+{
+    return static_cast<Q8_8>((value >= 0) ? (value * kQ8_8One + 0.5) : (value * kQ8_8One - 0.5));
+}
+
+constexpr Q8_8
+IntToQ8_8(int8_t value)
+{
+    return static_cast<Q8_8>(value * kQ8_8One);
+}
+
+// Integer part, rounded towards minus infinity
+constexpr int8_t
+Q8_8ToInt(Q8_8 value)
+{
+    return static_cast<int8_t>(value >> kQ8_8FractionalBits);
+}
+
+// Multiplies integer value by Q8.8 factor. Result is truncated
+constexpr int32_t
+MultiplyQ8_8(int32_t value, Q8_8 factor)
+{
+    return (value * factor) >> kQ8_8FractionalBits;
+}
+
+// Saturates 32-bit intermediate result to Q8.8 range
+constexpr Q8_8
+SaturateQ8_8(int32_t value)
+{
+    return (value > INT16_MAX) ? INT16_MAX : ((value < INT16_MIN) ? INT16_MIN : static_cast<Q8_8>(value));
+}
+
+#endif  // FIXED_POINT_H_
@@ -1,23 +1,38 @@
 #include "lamp_controller.h"
 
 #include <Arduino.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
 
-// This macro is defined for ESP, but not defined for Arduino. It is used to get access to strings in Flash
-#define FPSTR(pstr_pointer) (reinterpret_cast<const __FlashStringHelper*>(pstr_pointer))
+#include "devices/doutpwm.h"
+#include "response_writer.h"
+#include "utils.h"
 
 namespace
 {
-constexpr uint8_t kLedDriverPin{9};
-constexpr uint8_t kPotentiometerPin{A0};
-constexpr uint8_t kFan1Pin{3};
-constexpr uint8_t kFan2Pin{4};
-constexpr uint8_t kThermalSensorsPin{5};
-
-// Manual mode is when potentiometer value is higher than 100. If its value is lower, it is treated as automatic mode.
-// Such features as sunrise, manual brightness control via WebUI (ESP) are allowed only in automatic mode.
-constexpr uint16_t kmanual_mode_level{100};
-constexpr uint16_t kmanual_mode_hysteresis{0.1 * kmanual_mode_level};
-constexpr uint16_t kmanual_mode_threshold{4};
+constexpr uint8_t  kLedDriverPin{9};
+constexpr uint16_t kLedDriverPwmTop{8000};  // 1 kHz, 13-bit resolution
+constexpr uint8_t  kPotentiometerPin{A0};
+constexpr uint8_t  kFan1Pin{3};
+constexpr uint8_t  kFan2Pin{4};
+constexpr uint8_t  kThermalSensorsPin{5};
+constexpr uint32_t kTelemetryPeriodMs{10000};
+constexpr uint32_t kAlarmCheckPeriodMs{500};
+constexpr bool     kRtcTickMode{true};  // DS1307 SQW is connected to pin 2. Timer falls back to millis() without it
+
+// The longest binary replies: GET_THERMAL_SENSORS (number of sensors, ROM code, temperature and raw temperature) and
+// GET_THERMAL_TREND (predicted temperature, number of sensors and slopes of all sensors)
+constexpr uint8_t kThermalSensorsReplySize{1 + sizeof(DeviceAddress) + 2 + 2};
+constexpr uint8_t kThermalTrendReplySize{3 + 2 * ThermoSensors::kMaxNumOfSensors};
+constexpr uint8_t kMaxBinaryReplySize{
+    (kThermalSensorsReplySize > kThermalTrendReplySize) ? kThermalSensorsReplySize : kThermalTrendReplySize};
+
+// Manual mode is when potentiometer value is higher than 100 of 1023. If its value is lower, it is treated as automatic
+// mode. Such features as sunrise, manual brightness control via WebUI (ESP) are allowed only in automatic mode.
+// Potentiometer is oversampled, so its value has more than 10 bits
+constexpr uint16_t kmanual_mode_level{100 << Potentiometer::kOversamplingBits};
+constexpr uint16_t kmanual_mode_hysteresis{kmanual_mode_level / 10};
+constexpr uint16_t kmanual_mode_threshold{4 << Potentiometer::kOversamplingBits};
 
 // To call ESP reset user should change from manual to auto mode <kreset_esp_num_of_steps> times with being in each
 // step from <kreset_esp_step_timeout_min> to <kreset_esp_step_timeout_max> milliseconds.
@@ -30,28 +45,73 @@ constexpr uint8_t  kreset_esp_num_of_steps{5};
 
 constexpr char esp_set_time_ack[] PROGMEM             = "TOESP: st ACK\n";
 constexpr char esp_get_time_ack[] PROGMEM             = "TOESP: gt ACK ";
-constexpr char esp_set_alarm_ack[] PROGMEM            = "TOESP: sa ACK\n";
+constexpr char esp_set_alarm_ack[] PROGMEM            = "TOESP: sa ACK ";
 constexpr char esp_get_alarm_ack[] PROGMEM            = "TOESP: ga ACK ";
 constexpr char esp_enable_alarm_ack[] PROGMEM         = "TOESP: ea ACK ";
 constexpr char esp_toggle_alarm_ack[] PROGMEM         = "TOESP: ta ACK\n";
-constexpr char esp_set_sunrise_duration_ack[] PROGMEM = "TOESP: ssd ACK\n";
+constexpr char esp_set_sunrise_duration_ack[] PROGMEM = "TOESP: ssd ACK ";
 constexpr char esp_get_sunrise_duration_ack[] PROGMEM = "TOESP: gsd ACK ";
 constexpr char esp_set_brightness_ack[] PROGMEM       = "TOESP: sb ACK ";
 constexpr char esp_get_brightness_ack[] PROGMEM       = "TOESP: gb ACK ";
-constexpr char esp_set_pwm_frequency_ack[] PROGMEM    = "TOESP: sff ACK\n";
-constexpr char esp_set_pwm_steps_number_ack[] PROGMEM = "TOESP: sfs ACK\n";
+constexpr char esp_set_pwm_frequency_ack[] PROGMEM    = "TOESP: sff ACK ";
+constexpr char esp_set_pwm_steps_number_ack[] PROGMEM = "TOESP: sfs ACK ";
 constexpr char esp_connect_ack[] PROGMEM              = "TOESP: connect ACK\n";
+constexpr char esp_connect_binary_ack[] PROGMEM       = "TOESP: connect ACK B\n";
+constexpr char esp_get_rx_statistics_ack[] PROGMEM    = "TOESP: rx ACK ";
+constexpr char esp_set_dimming_curve_ack[] PROGMEM    = "TOESP: sdc ACK ";
+constexpr char esp_get_dimming_curve_ack[] PROGMEM    = "TOESP: gdc ACK ";
+constexpr char esp_get_thermal_sensors_ack[] PROGMEM  = "TOESP: tl ACK ";
+constexpr char esp_set_calibration_ack[] PROGMEM      = "TOESP: tc ACK ";
+constexpr char esp_set_fan_control_ack[] PROGMEM      = "TOESP: sfc ACK ";
+constexpr char esp_get_fan_control_ack[] PROGMEM      = "TOESP: gfc ACK ";
+constexpr char esp_get_thermal_trend_ack[] PROGMEM    = "TOESP: gtr ACK ";
+constexpr char esp_get_telemetry_ack[] PROGMEM        = "TOESP: tm ACK ";
 constexpr char esp_reset_cmd[] PROGMEM                = "TOESP: RESETESP\n";
+
+constexpr uint16_t kMaxBrightness{Timer::kMaxBrightness};
+
+// Binary protocol uses little-endian values
+uint16_t
+ReadUint16(const uint8_t* data)
+{
+    return data[0] | (static_cast<uint16_t>(data[1]) << 8);
+}
+
+uint32_t
+ReadUint32(const uint8_t* data)
+{
+    return ReadUint16(data) | (static_cast<uint32_t>(ReadUint16(data + 2)) << 16);
+}
+
+uint8_t
+WriteUint16(uint8_t* data, uint16_t value)
+{
+    data[0] = value & 0xFF;
+    data[1] = value >> 8;
+    return 2;
+}
+
+uint8_t
+WriteUint32(uint8_t* data, uint32_t value)
+{
+    WriteUint16(data, value & 0xFFFF);
+    return WriteUint16(data + 2, value >> 16) + 2;
+}
 }  // namespace
 
 LampController::LampController()
-  : led_driver_(kLedDriverPin, Pwm::PWMSpeed::HZ_490)
+  : scheduler_(perf_monitor_)
+  , timer_(kAlarmCheckPeriodMs, kRtcTickMode)
+  , led_driver_(kLedDriverPin, kLedDriverPwmTop)
   , potentiometer_(kPotentiometerPin, 10)
   // TODO: need to have 1 more fan. Or adapt code of fan to control 2 fans
   , fan_(kFan1Pin, Pwm::PWMSpeed::HZ_31372)
   // , dout_pwm_(kFan1Pin, kFan2Pin)
   , thermo_sensors_(kThermalSensorsPin)
   , thermal_controller_(thermo_sensors_, fan_, led_driver_)
+  , telemetry_(*this, kTelemetryPeriodMs)
+  , fan_pwm_frequency_{DoutPwm::kDefaultFrequency}
+  , fan_pwm_steps_number_{DoutPwm::kDefaultNumOfSteps}
   , is_manual_mode_{false}
   , last_potentiometer_val_{0XFFFF}
   , last_mode_switch_time_{0}
@@ -73,23 +133,51 @@ LampController::Setup()
     fan_.Setup();
     thermo_sensors_.Setup();
 
+    ConfigStore::Config config;
+    if (config_store_.Load(config)) {
+        ApplyConfig(config);
+    }
+    else {
+        // Settings, which older firmware has not written, keep defaults
+        CollectConfig(config);
+        if (ConfigStore::LoadLegacy(config)) {
+            Serial.println(F("Config is not found in EEPROM, settings of older firmware are used"));
+            ApplyConfig(config);
+        }
+        else {
+            Serial.println(F("Config is not found in EEPROM, defaults are used"));
+        }
+    }
+    SaveConfig();
+
+    // Thermo sensors have just started conversion, so results will be ready only after their period
+    scheduler_.AddTask(&thermo_sensors_, PerfMonitor::Stage::kThermoSensors, thermo_sensors_.GetPeriodMs());
+    scheduler_.AddTask(&thermal_controller_, PerfMonitor::Stage::kThermalController, thermal_controller_.GetPeriodMs());
+    scheduler_.AddTask(&potentiometer_, PerfMonitor::Stage::kPotentiometer);
+    scheduler_.AddTask(&timer_, PerfMonitor::Stage::kAlarmCheck);
+    scheduler_.AddTask(&led_driver_, PerfMonitor::Stage::kSunrise);
+    scheduler_.AddTask(&telemetry_, PerfMonitor::Stage::kTelemetry, kTelemetryPeriodMs);
+    scheduler_.AddTask(&config_store_, PerfMonitor::Stage::kConfig);
+
     Serial.println(F("Done"));
 
     // Temp solution - use DOUT PWM. It was used before I could run PWM module on proper PWM speed.
     // With proper HW you can use regular PWM, so, this object is not required and can be deleted.
     // dout_pwm_.setup();
     // dout_pwm_.set_output(false);
-    // dout_pwm_.set_pwm_frequency(kpwm_frequency);
-    // dout_pwm_.set_pwm_steps_number(knum_of_pwm_steps);
+    // dout_pwm_.SetPwmFrequency(fan_pwm_frequency_);
+    // dout_pwm_.SetPwmStepsNumber(fan_pwm_steps_number_);
 }
 
 void
 LampController::Loop()
 {
-    thermo_sensors_.Loop();
-    thermal_controller_.Loop();
+    perf_monitor_.StartLap();
+
+    // Sensors, thermal controller, potentiometer, and in automatic mode also alarm and sunrise
+    scheduler_.Loop();
 
-    potentiometer_.Loop();
+    perf_monitor_.SkipLap();
     HandleManualMode();
 
     if (is_manual_mode_) {
@@ -97,17 +185,16 @@ LampController::Loop()
         auto potentiometer_val = potentiometer_.Read();
         if (abs(potentiometer_val - last_potentiometer_val_) >= kmanual_mode_threshold) {
             last_potentiometer_val_ = potentiometer_val;
-            led_driver_.SetBrightness(potentiometer_.Read());
+            led_driver_.SetManualLevel(Potentiometer::ToLevel(potentiometer_val));
         }
-
-        // In manual mode we are not reacting on alarm from timer and not running sunrise.
-    }
-    else {
-        timer_.CheckAlarm();
-        led_driver_.RunSunrise();
     }
+    perf_monitor_.Lap(PerfMonitor::Stage::kManualMode);
 
     ProcessCommandsFromSerial();
+    perf_monitor_.Lap(PerfMonitor::Stage::kCommands);
+
+    SleepUntilNextDeadline();
+    perf_monitor_.Lap(PerfMonitor::Stage::kIdle);
 
     // TODO: remove it. This is temporary code to show device is alive
     // static uint32_t last_printed_message_time = 0;
@@ -129,11 +216,31 @@ LampController::Loop()
 }
 
 void
-LampController::OnAlarm()
+LampController::OnAlarm(const Timer::AlarmData& alarm)
 {
+    // In manual mode alarm is skipped. Timer keeps running, so the next alarm is already scheduled
+    if (is_manual_mode_) {
+        Serial.println(F("Alarm is skipped in manual mode"));
+        return;
+    }
+
     // TODO: remove this log in production
     Serial.println(F("ALARM !!!"));
-    led_driver_.StartSunrise();
+    led_driver_.StartSunrise(alarm.sunrise_duration_min, alarm.brightness);
+}
+
+void
+LampController::FillTelemetrySample(Telemetry::Sample& sample)
+{
+    for (uint8_t i = 0; i < ThermoSensors::kMaxNumOfSensors; ++i) {
+        sample.temperatures[i] = (i < thermo_sensors_.GetNumOfSensors()) ? thermo_sensors_.GetTemperature(i)
+                                                                          : ThermoSensors::kInvalidTemperature;
+    }
+    sample.fan_speed      = thermal_controller_.GetFanSpeed();
+    sample.led_level      = led_driver_.GetOutputLevel();
+    sample.thermal_factor = led_driver_.GetThermalFactor();
+    // Bit 0 is manual mode, next bits are fan control mode
+    sample.mode = is_manual_mode_ | (static_cast<uint8_t>(thermal_controller_.GetFanControl().mode) << 1);
 }
 
 void
@@ -142,65 +249,396 @@ LampController::ProcessCommandsFromSerial()
     serial_command_reader_.Loop();
     if (serial_command_reader_.IsCommandReady()) {
         auto command{serial_command_reader_.ReadCommand()};
+        if (command.is_binary) {
+            ProcessBinaryCommand(command);
+            SaveConfig();
+            return;
+        }
+
+        ResponseWriter writer{Serial};
         switch (command.type) {
         case SerialCommandReader::Command::CommandType::SET_TIME:
             timer_.SetTimeStr(command.arguments);
-            Serial.print(String(FPSTR(esp_set_time_ack)));
+            writer.Write(FPSTR(esp_set_time_ack));
             break;
         case SerialCommandReader::Command::CommandType::GET_TIME:
-            Serial.print(String(FPSTR(esp_get_time_ack)) + timer_.GetTimeStr() + "\n");
+            writer.Write(FPSTR(esp_get_time_ack));
+            timer_.WriteTime(writer);
+            writer.Write('\n');
             break;
-        case SerialCommandReader::Command::CommandType::SET_ALARM:
-            timer_.SetAlarmStr(command.arguments);
-            Serial.print(String(FPSTR(esp_set_alarm_ack)));
+        case SerialCommandReader::Command::CommandType::SET_ALARM: {
+            bool result{timer_.SetAlarmStr(command.arguments)};
+            writer.Write(FPSTR(esp_set_alarm_ack)).Write(result ? F("DONE\n") : F("ERROR\n"));
             break;
+        }
         case SerialCommandReader::Command::CommandType::GET_ALARM:
-            Serial.print(String(FPSTR(esp_get_alarm_ack)) + timer_.GetAlarmStr() + "\n");
+            // Alarm 0, if index is not given
+            writer.Write(FPSTR(esp_get_alarm_ack));
+            if (!timer_.WriteAlarm(writer, ParseDecimal(command.arguments, 1))) {
+                writer.Write(F("ERROR"));
+            }
+            writer.Write('\n');
             break;
         case SerialCommandReader::Command::CommandType::ENABLE_ALARM: {
             bool result{timer_.EnableAlarmStr(command.arguments)};
-            Serial.print(String(FPSTR(esp_enable_alarm_ack)) + (result ? F("DONE\n") : F("ERROR\n")));
+            writer.Write(FPSTR(esp_enable_alarm_ack)).Write(result ? F("DONE\n") : F("ERROR\n"));
             break;
         }
         case SerialCommandReader::Command::CommandType::TOGGLE_ALARM:
             timer_.ToggleAlarm();
-            Serial.print(String(FPSTR(esp_toggle_alarm_ack)));
+            writer.Write(FPSTR(esp_toggle_alarm_ack));
             break;
-        case SerialCommandReader::Command::CommandType::SET_SUNRISE_DURATION:
-            led_driver_.SetSunriseDurationStr(command.arguments);
-            Serial.print(String(FPSTR(esp_set_sunrise_duration_ack)));
+        case SerialCommandReader::Command::CommandType::SET_SUNRISE_DURATION: {
+            bool result{led_driver_.SetSunriseDurationStr(command.arguments)};
+            writer.Write(FPSTR(esp_set_sunrise_duration_ack)).Write(result ? F("DONE\n") : F("ERROR\n"));
             break;
+        }
         case SerialCommandReader::Command::CommandType::GET_SUNRISE_DURATION:
-            Serial.print(String(FPSTR(esp_get_sunrise_duration_ack)) + led_driver_.GetSunriseDurationStr() + "\n");
+            writer.Write(FPSTR(esp_get_sunrise_duration_ack));
+            led_driver_.WriteSunriseDuration(writer);
+            writer.Write('\n');
             break;
         case SerialCommandReader::Command::CommandType::SET_BRIGHTNESS:
             if (is_manual_mode_) {
-                Serial.print(String(FPSTR(esp_set_brightness_ack)) + F("ERROR: manual mode\n"));
+                writer.Write(FPSTR(esp_set_brightness_ack)).Write(F("ERROR: manual mode\n"));
                 break;
             }
             led_driver_.SetBrightnessStr(command.arguments);
-            Serial.print(String(FPSTR(esp_set_brightness_ack)) + F("DONE\n"));
+            writer.Write(FPSTR(esp_set_brightness_ack)).Write(F("DONE\n"));
             break;
         case SerialCommandReader::Command::CommandType::GET_BRIGHTNESS:
-            Serial.print(String(FPSTR(esp_get_brightness_ack)) + (is_manual_mode_ ? "M " : "A ") +
-                         led_driver_.GetBrightnessStr() + "\n");
+            writer.Write(FPSTR(esp_get_brightness_ack)).Write(is_manual_mode_ ? F("M ") : F("A "));
+            led_driver_.WriteBrightness(writer);
+            writer.Write('\n');
             break;
-        case SerialCommandReader::Command::CommandType::SET_FAN_PWM_FREQUENCY:
-            // dout_pwm_.set_pwm_frequency(command.arguments);
-            Serial.print(String(FPSTR(esp_set_pwm_frequency_ack)));
+        case SerialCommandReader::Command::CommandType::SET_FAN_PWM_FREQUENCY: {
+            bool result{SetFanPwmFrequency(ParseDecimal(command.arguments, 4))};
+            writer.Write(FPSTR(esp_set_pwm_frequency_ack)).Write(result ? F("DONE\n") : F("ERROR\n"));
             break;
-        case SerialCommandReader::Command::CommandType::SET_FAN_PWM_STEPS_NUMBER:
-            // dout_pwm_.set_pwm_steps_number(command.arguments);
-            Serial.print(String(FPSTR(esp_set_pwm_steps_number_ack)));
+        }
+        case SerialCommandReader::Command::CommandType::SET_FAN_PWM_STEPS_NUMBER: {
+            bool result{SetFanPwmStepsNumber(ParseDecimal(command.arguments, 3))};
+            writer.Write(FPSTR(esp_set_pwm_steps_number_ack)).Write(result ? F("DONE\n") : F("ERROR\n"));
             break;
+        }
         case SerialCommandReader::Command::CommandType::CONNECT:
-            Serial.print(FPSTR(esp_connect_ack));
+            // ESP sends "connect" after each restart, so binary mode is enabled only when it is requested explicitly
+            if (command.arguments[0] == 'B') {
+                serial_command_reader_.SetBinaryModeEnabled(true);
+                writer.Write(FPSTR(esp_connect_binary_ack));
+            }
+            else {
+                serial_command_reader_.SetBinaryModeEnabled(false);
+                writer.Write(FPSTR(esp_connect_ack));
+            }
+            break;
+        case SerialCommandReader::Command::CommandType::GET_PERFORMANCE:
+            perf_monitor_.PrintAndReset();
+            break;
+        case SerialCommandReader::Command::CommandType::GET_RX_STATISTICS:
+            writer.Write(FPSTR(esp_get_rx_statistics_ack))
+                .WriteDecimal(serial_command_reader_.GetNumOfDroppedBytes())
+                .Write(' ')
+                .WriteDecimal(serial_command_reader_.GetNumOfDroppedFrames())
+                .Write('\n');
+            break;
+        case SerialCommandReader::Command::CommandType::SET_DIMMING_CURVE: {
+            bool result{led_driver_.SetDimmingCurveStr(command.arguments)};
+            writer.Write(FPSTR(esp_set_dimming_curve_ack)).Write(result ? F("DONE\n") : F("ERROR\n"));
+            break;
+        }
+        case SerialCommandReader::Command::CommandType::GET_DIMMING_CURVE:
+            writer.Write(FPSTR(esp_get_dimming_curve_ack));
+            led_driver_.WriteDimmingCurve(writer);
+            writer.Write('\n');
+            break;
+        case SerialCommandReader::Command::CommandType::GET_THERMAL_SENSORS:
+            writer.Write(FPSTR(esp_get_thermal_sensors_ack));
+            thermo_sensors_.WriteSensors(writer);
+            writer.Write('\n');
+            break;
+        case SerialCommandReader::Command::CommandType::SET_THERMAL_CALIBRATION: {
+            bool result{thermo_sensors_.SetCalibrationPointStr(command.arguments)};
+            writer.Write(FPSTR(esp_set_calibration_ack)).Write(result ? F("DONE\n") : F("ERROR\n"));
+            break;
+        }
+        case SerialCommandReader::Command::CommandType::SET_FAN_CONTROL: {
+            bool result{thermal_controller_.SetFanControlStr(command.arguments)};
+            writer.Write(FPSTR(esp_set_fan_control_ack)).Write(result ? F("DONE\n") : F("ERROR\n"));
+            break;
+        }
+        case SerialCommandReader::Command::CommandType::GET_FAN_CONTROL:
+            writer.Write(FPSTR(esp_get_fan_control_ack));
+            thermal_controller_.WriteFanControl(writer);
+            writer.Write('\n');
+            break;
+        case SerialCommandReader::Command::CommandType::GET_THERMAL_TREND:
+            writer.Write(FPSTR(esp_get_thermal_trend_ack));
+            thermal_controller_.WriteTrend(writer);
+            writer.Write('\n');
+            break;
+        case SerialCommandReader::Command::CommandType::GET_TELEMETRY:
+            writer.Write(FPSTR(esp_get_telemetry_ack));
+            telemetry_.Write(writer);
+            writer.Write('\n');
             break;
         default:
             Serial.print(F("Unknown command: "));
             Serial.println(command.arguments);
             break;
         }
+        SaveConfig();
+    }
+}
+
+void
+LampController::ProcessBinaryCommand(const SerialCommandReader::Command& command)
+{
+    using CommandType  = SerialCommandReader::Command::CommandType;
+    using BinaryStatus = SerialCommandReader::BinaryStatus;
+
+    auto    arguments = reinterpret_cast<const uint8_t*>(command.arguments);
+    uint8_t reply[kMaxBinaryReplySize];
+    uint8_t reply_length{0};
+    auto    status{BinaryStatus::kOk};
+
+    switch (command.type) {
+    case CommandType::SET_TIME:
+        if (command.arguments_length != 4) {
+            status = BinaryStatus::kBadPayload;
+            break;
+        }
+        timer_.SetTime(ReadUint32(arguments));
+        break;
+    case CommandType::GET_TIME:
+        reply_length = WriteUint32(reply, timer_.GetTime());
+        break;
+    case CommandType::SET_ALARM:
+        if ((command.arguments_length != 8)
+            || !timer_.SetAlarm(arguments[0],
+                                Timer::AlarmData{arguments[1],
+                                                 arguments[2],
+                                                 static_cast<Timer::DaysOfWeek>(arguments[3]),
+                                                 ReadUint16(arguments + 4),
+                                                 ReadUint16(arguments + 6)})) {
+            status = BinaryStatus::kBadPayload;
+        }
+        break;
+    case CommandType::GET_ALARM: {
+        if ((command.arguments_length != 1) || (arguments[0] >= Timer::kMaxNumOfAlarms)) {
+            status = BinaryStatus::kBadPayload;
+            break;
+        }
+        const auto& alarm = timer_.GetAlarm(arguments[0]);
+        reply[0]          = timer_.IsAlarmEnabled();
+        reply[1]          = alarm.hour;
+        reply[2]          = alarm.minute;
+        reply[3]          = static_cast<uint8_t>(alarm.dow);
+        WriteUint16(reply + 4, alarm.sunrise_duration_min);
+        reply_length = WriteUint16(reply + 6, alarm.brightness) + 6;
+        break;
+    }
+    case CommandType::ENABLE_ALARM:
+        if (command.arguments_length != 1) {
+            status = BinaryStatus::kBadPayload;
+            break;
+        }
+        timer_.EnableAlarm(arguments[0] != 0);
+        break;
+    case CommandType::TOGGLE_ALARM:
+        timer_.ToggleAlarm();
+        break;
+    case CommandType::SET_SUNRISE_DURATION:
+        if ((command.arguments_length != 2) || !led_driver_.SetSunriseDurationMin(ReadUint16(arguments))) {
+            status = BinaryStatus::kBadPayload;
+        }
+        break;
+    case CommandType::GET_SUNRISE_DURATION:
+        reply_length = WriteUint16(reply, led_driver_.GetSunriseDurationMin());
+        break;
+    case CommandType::SET_BRIGHTNESS:
+        if ((command.arguments_length != 2) || (ReadUint16(arguments) > kMaxBrightness)) {
+            status = BinaryStatus::kBadPayload;
+            break;
+        }
+        if (is_manual_mode_) {
+            status = BinaryStatus::kRejected;
+            break;
+        }
+        led_driver_.SetBrightness(ReadUint16(arguments));
+        break;
+    case CommandType::GET_BRIGHTNESS:
+        reply[0]     = is_manual_mode_;
+        reply_length = WriteUint16(reply + 1, led_driver_.GetBrightness()) + 1;
+        break;
+    case CommandType::SET_FAN_PWM_FREQUENCY:
+        if ((command.arguments_length != 2) || !SetFanPwmFrequency(ReadUint16(arguments))) {
+            status = BinaryStatus::kBadPayload;
+        }
+        break;
+    case CommandType::SET_FAN_PWM_STEPS_NUMBER:
+        if ((command.arguments_length != 1) || !SetFanPwmStepsNumber(arguments[0])) {
+            status = BinaryStatus::kBadPayload;
+        }
+        break;
+    case CommandType::CONNECT:
+        break;
+    case CommandType::GET_RX_STATISTICS:
+        WriteUint16(reply, serial_command_reader_.GetNumOfDroppedBytes());
+        reply_length = WriteUint16(reply + 2, serial_command_reader_.GetNumOfDroppedFrames()) + 2;
+        break;
+    case CommandType::SET_DIMMING_CURVE:
+        if ((command.arguments_length != 1)
+            || !led_driver_.SetDimmingCurve(static_cast<DimmingCurve>(arguments[0]))) {
+            status = BinaryStatus::kBadPayload;
+        }
+        break;
+    case CommandType::GET_DIMMING_CURVE:
+        reply[0]     = static_cast<uint8_t>(led_driver_.GetDimmingCurve());
+        reply_length = 1;
+        break;
+    case CommandType::GET_THERMAL_SENSORS:
+        if ((command.arguments_length != 1) || (arguments[0] >= thermo_sensors_.GetNumOfSensors())) {
+            status = BinaryStatus::kBadPayload;
+            break;
+        }
+        reply[0] = thermo_sensors_.GetNumOfSensors();
+        memcpy(reply + 1, thermo_sensors_.GetAddress(arguments[0]), sizeof(DeviceAddress));
+        WriteUint16(reply + 9, thermo_sensors_.GetTemperature(arguments[0]));
+        reply_length = WriteUint16(reply + 11, thermo_sensors_.GetRawTemperature(arguments[0])) + 11;
+        break;
+    case CommandType::SET_THERMAL_CALIBRATION:
+        if ((command.arguments_length != 6)
+            || !thermo_sensors_.SetCalibrationPoint(
+                arguments[0], arguments[1], ReadUint16(arguments + 2), ReadUint16(arguments + 4))) {
+            status = BinaryStatus::kBadPayload;
+        }
+        break;
+    case CommandType::SET_FAN_CONTROL: {
+        if (command.arguments_length != 10) {
+            status = BinaryStatus::kBadPayload;
+            break;
+        }
+        ThermalController::FanControlSettings settings;
+        settings.mode               = static_cast<ThermalController::FanControlMode>(arguments[0]);
+        settings.target_temperature = ReadUint16(arguments + 1);
+        settings.proportional_gain  = ReadUint16(arguments + 3);
+        settings.integral_gain      = ReadUint16(arguments + 5);
+        settings.derivative_gain    = ReadUint16(arguments + 7);
+        settings.feed_forward_gain  = arguments[9];
+        if (!thermal_controller_.SetFanControl(settings)) {
+            status = BinaryStatus::kBadPayload;
+        }
+        break;
+    }
+    case CommandType::GET_FAN_CONTROL: {
+        const auto& settings = thermal_controller_.GetFanControl();
+        reply[0]             = static_cast<uint8_t>(settings.mode);
+        WriteUint16(reply + 1, settings.target_temperature);
+        WriteUint16(reply + 3, settings.proportional_gain);
+        WriteUint16(reply + 5, settings.integral_gain);
+        WriteUint16(reply + 7, settings.derivative_gain);
+        reply[9]     = settings.feed_forward_gain;
+        reply[10]    = thermal_controller_.GetFanSpeed();
+        reply_length = 11;
+        break;
+    }
+    case CommandType::GET_THERMAL_TREND:
+        WriteUint16(reply, thermal_controller_.GetPredictedTemperature());
+        reply[2]     = thermo_sensors_.GetNumOfSensors();
+        reply_length = 3;
+        for (uint8_t i = 0; i < thermo_sensors_.GetNumOfSensors(); ++i) {
+            reply_length += WriteUint16(reply + reply_length, thermal_controller_.GetSlope(i));
+        }
+        break;
+    default:
+        // Performance statistics and telemetry are too big for one frame, use text protocol for them
+        status = BinaryStatus::kUnsupported;
+        break;
+    }
+
+    SerialCommandReader::WriteBinaryReply(command, status, reply, reply_length);
+}
+
+bool
+LampController::SetFanPwmFrequency(uint16_t frequency)
+{
+    if (frequency == 0) {
+        return false;
+    }
+    fan_pwm_frequency_ = frequency;
+    // dout_pwm_.SetPwmFrequency(fan_pwm_frequency_);
+    return true;
+}
+
+bool
+LampController::SetFanPwmStepsNumber(uint16_t num_of_steps)
+{
+    if ((num_of_steps == 0) || (num_of_steps > UINT8_MAX)) {
+        return false;
+    }
+    fan_pwm_steps_number_ = num_of_steps;
+    // dout_pwm_.SetPwmStepsNumber(fan_pwm_steps_number_);
+    return true;
+}
+
+void
+LampController::ApplyConfig(const ConfigStore::Config& config)
+{
+    for (uint8_t i = 0; i < Timer::kMaxNumOfAlarms; ++i) {
+        timer_.SetAlarm(i, config.alarms[i]);
+    }
+    timer_.EnableAlarm(config.is_alarm_enabled);
+    led_driver_.SetSunriseDurationMin(config.sunrise_duration_min);
+    led_driver_.SetDimmingCurve(config.dimming_curve);
+    thermal_controller_.SetFanControl(config.fan_control);
+    SetFanPwmFrequency(config.fan_pwm_frequency);
+    SetFanPwmStepsNumber(config.fan_pwm_steps_number);
+}
+
+void
+LampController::CollectConfig(ConfigStore::Config& config) const
+{
+    config.fan_control          = thermal_controller_.GetFanControl();
+    config.sunrise_duration_min = led_driver_.GetSunriseDurationMin();
+    config.is_alarm_enabled     = timer_.IsAlarmEnabled();
+    config.dimming_curve        = led_driver_.GetDimmingCurve();
+    config.fan_pwm_frequency    = fan_pwm_frequency_;
+    config.fan_pwm_steps_number = fan_pwm_steps_number_;
+    config.reserved             = 0;
+    for (uint8_t i = 0; i < Timer::kMaxNumOfAlarms; ++i) {
+        config.alarms[i] = timer_.GetAlarm(i);
+    }
+}
+
+void
+LampController::SaveConfig()
+{
+    ConfigStore::Config config;
+    CollectConfig(config);
+    config_store_.Update(config);
+}
+
+void
+LampController::SleepUntilNextDeadline()
+{
+    // All work is done by scheduled tasks and by commands, so there is nothing to do until the nearest deadline or
+    // until a byte is received. Idle mode stops only CPU: PWM timers, millis() and USART keep running, and any
+    // interrupt wakes MCU up. Timer0 interrupt comes every 1 ms, so the condition is checked at least so often.
+    auto deadline = scheduler_.GetNextDeadline();
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    while (true) {
+        cli();
+        if ((static_cast<int32_t>(millis() - deadline) >= 0) || serial_command_reader_.HasPendingInput()) {
+            sei();
+            return;
+        }
+        // Instruction after sei() is executed before pending interrupt, so interrupt, which comes after the check,
+        // wakes MCU up from sleep_cpu() instead of being missed
+        sleep_enable();
+        sei();
+        sleep_cpu();
+        sleep_disable();
     }
 }
 
@@ -241,6 +679,10 @@ LampController::EnableManualMode()
 {
     is_manual_mode_ = true;
     led_driver_.StopSunrise();  // Stop sunrise. Just in case it was in progress
+
+    // In manual mode we are not reacting on alarm from timer and not running sunrise. Timer is not disabled: it keeps
+    // clock synchronized with RTC and moves to the next alarm, so alarms missed in manual mode don't fire later
+    scheduler_.SetTaskEnabled(&led_driver_, false);
     Serial.println(F("Manual mode enabled"));
 
     HandleEspResetRequest();
@@ -250,6 +692,7 @@ void
 LampController::DisableManualMode()
 {
     is_manual_mode_ = false;
+    scheduler_.SetTaskEnabled(&led_driver_, true);
     Serial.println(F("Manual mode disabled"));
 
     HandleEspResetRequest();
@@ -263,14 +706,30 @@ LampController::PrintUsage() const
           "Available commands:\n"
           "\t\"ESP: st HH:MM:SS DD/MM/YYYY\" - set current time\n"
           "\t\"ESP: gt\" - get current time (HH:MM:SS DD/MM/YYYY)\n"
-          "\t\"ESP: sa HH:MM WW\" - set alarm on specified time (WW - day of week mask)\n"
-          "\t\"ESP: ga\" - get alarm (E HH:MM WW, E = \"E\" if alarm enabled, \"D\" if disabled)\n"
-          "\t\"ESP: ea E\" enable alarm (if E = \"E\", enable alarm, if E = \"D\", disable)\n"
-          "\t\"ESP: ta\" toggle alarm On/Off\n"
-          "\t\"ESP: ssd MMMM\" set Sunrise duration in minutes (0-1440)\n"
+          "\t\"ESP: sa I HH:MM WW MMMM BBBB\" - set alarm I (0-3) on specified time (WW - day of week mask, 00 - alarm "
+          "is not used), sunrise duration MMMM (0 - duration set by ssd) up to brightness BBBB (0-1023). WW, MMMM and "
+          "BBBB are optional\n"
+          "\t\"ESP: ga I\" - get alarm I (E I HH:MM WW MMMM BBBB, E = \"E\" if alarms enabled, \"D\" if disabled)\n"
+          "\t\"ESP: ea E\" enable all alarms (if E = \"E\", enable alarms, if E = \"D\", disable)\n"
+          "\t\"ESP: ta\" toggle alarms On/Off\n"
+          "\t\"ESP: ssd MMMM\" set Sunrise duration in minutes (1-1440)\n"
           "\t\"ESP: gsd\" get Sunrise duration (MMMM)\n"
           "\t\"ESP: sb BBBB\" set brightness (0-1023). Not allowed in manual lamp control mode\n"
           "\t\"ESP: gb\" get current brightness (M BBBB, M = \"M\" if lamp in manual mode, \"A\" - in automatic mode)\n"
           "\t\"ESP: sff FF\" set fan PWM frequency (used only for DOUT PWM)\n"
-          "\t\"ESP: sfs NN\" set fan PWM steps number (steps per PWM period) (used only for DOUT PWM)\n"));
+          "\t\"ESP: sfs NN\" set fan PWM steps number (steps per PWM period) (used only for DOUT PWM)\n"
+          "\t\"ESP: connect B\" enable binary protocol in addition to text one (\"ESP: connect\" disables it)\n"
+          "\t\"ESP: perf\" print and reset execution time statistics of main loop stages\n"
+          "\t\"ESP: rx\" get number of bytes and lines dropped by serial receiver (BYTES FRAMES)\n"
+          "\t\"ESP: sdc C\" set sunrise dimming curve (0 - CIE 1931, 1 - DALI logarithmic, 2 - gamma 2.2, 3 - linear)\n"
+          "\t\"ESP: gdc\" get sunrise dimming curve (C)\n"
+          "\t\"ESP: tl\" list thermal sensors (N ROM T RAW ..., temperatures in 0.01 C)\n"
+          "\t\"ESP: tc I P RAW REF\" set calibration point P (0 - low, 1 - high) of sensor I: sensor reads RAW when "
+          "temperature is REF (0.01 C)\n"
+          "\t\"ESP: sfc M T KP KI KD FF\" set fan control: M (0 - curve, 1 - PID), target temperature T, PID gains in "
+          "0.01 units of fan speed (0-255) per C, per C*s and per C/s, FF - fan speed at full LED power\n"
+          "\t\"ESP: gfc\" get fan control (M T KP KI KD FF SPEED)\n"
+          "\t\"ESP: gtr\" get thermal trend (P N S ..., P - the hottest temperature predicted in 30 s (0.01 C), S - "
+          "slope of each sensor (0.01 C/min))\n"
+          "\t\"ESP: tm\" get telemetry history recorded every 10 s (P N TIME V0 ... V7 DATA, see telemetry.h)\n"));
 }
@@ -5,6 +5,7 @@
 
 #include <stdint.h>
 
+#include "config_store.h"
 #include "devices/fan.h"
 #include "devices/led_driver.h"
 #include "devices/potentiometer.h"
@@ -12,19 +13,33 @@
 #include "devices/thermalcontroller.hpp"
 #include "devices/thermosensors.hpp"
 #include "devices/timer.h"
+#include "perf_monitor.h"
+#include "scheduler.h"
+#include "telemetry.h"
 
 class LampController
   : public IComponent
   , public Timer::AlarmHandler
+  , public Telemetry::Source
 {
 public:
     LampController();
     void Setup() override;
     void Loop();
-    void OnAlarm() override;
+    void OnAlarm(const Timer::AlarmData& alarm) override;
+    void FillTelemetrySample(Telemetry::Sample& sample) override;
 
 private:
     void ProcessCommandsFromSerial();
+    void ProcessBinaryCommand(const SerialCommandReader::Command& command);
+    // Settings of DoutPwm. Returns false, if value is 0 (or doesn't fit uint8_t for steps number)
+    bool SetFanPwmFrequency(uint16_t frequency);
+    bool SetFanPwmStepsNumber(uint16_t num_of_steps);
+    void ApplyConfig(const ConfigStore::Config& config);
+    void CollectConfig(ConfigStore::Config& config) const;  // Settings of all components
+    void SaveConfig();  // Settings are written to EEPROM only if changed
+
+    void SleepUntilNextDeadline();
 
     void HandleManualMode();
     void HandleEspResetRequest();
@@ -33,6 +48,10 @@ private:
 
     void PrintUsage() const;
 
+    PerfMonitor perf_monitor_;
+    Scheduler   scheduler_;
+    ConfigStore config_store_;
+
     Timer               timer_;
     LedDriver           led_driver_;
     Potentiometer       potentiometer_;
@@ -43,6 +62,11 @@ private:
     // DoutPwm             dout_pwm_;
     ThermoSensors     thermo_sensors_;
     ThermalController thermal_controller_;
+    Telemetry         telemetry_;
+
+    // DoutPwm is not used now, but ESP still configures it, so its settings are kept and stored in config
+    uint16_t fan_pwm_frequency_;
+    uint8_t  fan_pwm_steps_number_;
 
 
     bool     is_manual_mode_;
@@ -0,0 +1,130 @@
+#include "perf_monitor.h"
+
+#include <Arduino.h>
+
+#include "utils.h"
+
+namespace
+{
+constexpr char kStageNames[][6] PROGMEM = {
+    "loop", "sens", "therm", "pot", "alarm", "sunr", "man", "cmd", "tlm", "cfg", "idle"};
+constexpr char esp_perf_ack[] PROGMEM   = "TOESP: perf ACK ";
+constexpr char esp_perf[] PROGMEM       = "TOESP: perf ";
+}  // namespace
+
+PerfMonitor::PerfMonitor()
+  : lap_start_time_{0}
+  , loop_start_time_{0}
+  , is_first_loop_{true}
+{
+    static_assert(sizeof(kStageNames) / sizeof(kStageNames[0]) == kNumOfStages, "Every stage should have a name");
+    Reset();
+}
+
+void
+PerfMonitor::StartLap()
+{
+    auto now = micros();
+    if (!is_first_loop_) {
+        Record(Stage::kMainLoop, now - loop_start_time_);
+    }
+    is_first_loop_   = false;
+    loop_start_time_ = now;
+    lap_start_time_  = now;
+}
+
+void
+PerfMonitor::Lap(Stage stage)
+{
+    auto now = micros();
+    Record(stage, now - lap_start_time_);
+    lap_start_time_ = now;
+}
+
+void
+PerfMonitor::SkipLap()
+{
+    lap_start_time_ = micros();
+}
+
+void
+PerfMonitor::PrintAndReset()
+{
+    // Format:
+    // TOESP: perf ACK <number of stages>
+    // TOESP: perf <stage> <count> <min us> <mean us> <max us> <bucket 0>,<bucket 1>,...,<last non-empty bucket>
+    Serial.print(FPSTR(esp_perf_ack));
+    Serial.print(kNumOfStages);
+    Serial.print('\n');
+
+    for (uint8_t i = 0; i < kNumOfStages; ++i) {
+        const auto& stats = stats_[i];
+        Serial.print(FPSTR(esp_perf));
+        Serial.print(FPSTR(kStageNames[i]));
+        Serial.print(' ');
+        Serial.print(stats.count);
+        Serial.print(' ');
+        Serial.print((stats.count == 0) ? 0 : stats.min_us);
+        Serial.print(' ');
+        Serial.print((stats.count == 0) ? 0 : (stats.total_us / stats.count));
+        Serial.print(' ');
+        Serial.print(stats.max_us);
+        Serial.print(' ');
+
+        int8_t last_bucket = kNumOfBuckets - 1;
+        while ((last_bucket > 0) && (stats.buckets[last_bucket] == 0)) {
+            --last_bucket;
+        }
+        for (int8_t bucket = 0; bucket <= last_bucket; ++bucket) {
+            if (bucket != 0) {
+                Serial.print(',');
+            }
+            Serial.print(stats.buckets[bucket]);
+        }
+        Serial.print('\n');
+    }
+
+    Reset();
+    // Do not account time spent on printing in statistics
+    is_first_loop_ = true;
+    SkipLap();
+}
+
+void
+PerfMonitor::Record(Stage stage, uint32_t duration_us)
+{
+    auto&    stats = stats_[static_cast<uint8_t>(stage)];
+    uint16_t saturated_us{static_cast<uint16_t>((duration_us > UINT16_MAX) ? UINT16_MAX : duration_us)};
+    if (saturated_us < stats.min_us) {
+        stats.min_us = saturated_us;
+    }
+    if (saturated_us > stats.max_us) {
+        stats.max_us = saturated_us;
+    }
+    stats.total_us += duration_us;
+    ++stats.count;
+
+    uint8_t bucket{0};
+    duration_us >>= kFirstBucketBits - 1;
+    while ((duration_us >>= 1) != 0 && (bucket < kNumOfBuckets - 1)) {
+        ++bucket;
+    }
+    // Saturate instead of overflow
+    if (stats.buckets[bucket] != UINT8_MAX) {
+        ++stats.buckets[bucket];
+    }
+}
+
+void
+PerfMonitor::Reset()
+{
+    for (auto& stats : stats_) {
+        stats.min_us   = UINT16_MAX;
+        stats.max_us   = 0;
+        stats.total_us = 0;
+        stats.count    = 0;
+        for (auto& bucket : stats.buckets) {
+            bucket = 0;
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef PERF_MONITOR_H_
+#define PERF_MONITOR_H_
+
+#include <stdint.h>
+
+// Collects execution time statistics of main loop stages: min, max, mean and histogram with log2 buckets
+// (bucket 0 counts durations shorter than 16 us, bucket N counts durations in range [2^(N+3), 2^(N+4)) us, last bucket
+// also counts everything longer). Min and max saturate at 65535 us, buckets saturate at 255.
+// It is designed to be always on, so each stage costs one micros() call and few additions, and its statistics take
+// ~20 bytes of RAM per stage.
+//
+// Usage:
+//     perf_monitor.StartLap();              // Beginning of main loop. Also records duration of previous loop
+//     DoSomething();
+//     perf_monitor.Lap(Stage::kSomething);  // Records time since previous StartLap()/Lap()/SkipLap()
+class PerfMonitor
+{
+public:
+    enum class Stage : uint8_t
+    {
+        kMainLoop = 0,  // Full period of main loop, including code outside of LampController::Loop()
+        kThermoSensors,
+        kThermalController,
+        kPotentiometer,
+        kAlarmCheck,
+        kSunrise,
+        kManualMode,
+        kCommands,
+        kTelemetry,
+        kConfig,
+        kIdle,  // Sleep until the next deadline
+        kNumOfStages
+    };
+
+    PerfMonitor();
+
+    void StartLap();
+    void Lap(Stage stage);
+    void SkipLap();  // Starts new lap without recording time of the current one
+
+    // Prints statistics of all stages to Serial and resets them
+    void PrintAndReset();
+
+private:
+    static constexpr uint8_t kNumOfStages{static_cast<uint8_t>(Stage::kNumOfStages)};
+    static constexpr uint8_t kNumOfBuckets{8};
+    static constexpr uint8_t kFirstBucketBits{4};  // Bucket 0 counts durations shorter than 2^kFirstBucketBits us
+
+    struct StageStats
+    {
+        uint32_t total_us;
+        uint32_t count;
+        uint16_t min_us;
+        uint16_t max_us;
+        uint8_t  buckets[kNumOfBuckets];
+    };
+
+    void Record(Stage stage, uint32_t duration_us);
+    void Reset();
+
+    StageStats stats_[kNumOfStages];
+    uint32_t   lap_start_time_;
+    uint32_t   loop_start_time_;
+    bool       is_first_loop_;
+};
+
+#endif  // PERF_MONITOR_H_
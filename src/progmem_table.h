@@ -0,0 +1,51 @@
+#ifndef PROGMEM_TABLE_H_
+#define PROGMEM_TABLE_H_
+
+#include <stdint.h>
+
+#ifndef _DEBUG
+#include <avr/pgmspace.h>
+#endif
+
+// Lookup table, which is computed at compile time and stored in flash. Generator describes the table:
+//
+//     struct Generator
+//     {
+//         using ValueType = uint8_t;
+//         static constexpr uint16_t kSize{100};
+//         static constexpr ValueType Value(uint16_t index);  // Should be constexpr, it is evaluated by compiler
+//     };
+//
+//     pgm_read_byte(&ProgmemTable<Generator>::kValues[index]);
+
+template <uint16_t... Indices>
+struct IndexSequence
+{
+};
+
+template <uint16_t N, uint16_t... Indices>
+struct MakeIndexSequence : MakeIndexSequence<N - 1, N - 1, Indices...>
+{
+};
+
+template <uint16_t... Indices>
+struct MakeIndexSequence<0, Indices...>
+{
+    using Type = IndexSequence<Indices...>;
+};
+
+template <typename Generator, typename Sequence = typename MakeIndexSequence<Generator::kSize>::Type>
+struct ProgmemTable;
+
+template <typename Generator, uint16_t... Indices>
+struct ProgmemTable<Generator, IndexSequence<Indices...>>
+{
+    // constexpr guarantees, that table is not initialized at runtime
+    static constexpr typename Generator::ValueType kValues[sizeof...(Indices)] = {Generator::Value(Indices)...};
+};
+
+template <typename Generator, uint16_t... Indices>
+constexpr typename Generator::ValueType
+    ProgmemTable<Generator, IndexSequence<Indices...>>::kValues[sizeof...(Indices)] PROGMEM;
+
+#endif  // PROGMEM_TABLE_H_
@@ -0,0 +1,60 @@
+#include "response_writer.h"
+
+ResponseWriter::ResponseWriter(Print& output)
+  : output_(output)
+{
+}
+
+ResponseWriter&
+ResponseWriter::Write(const __FlashStringHelper* str)
+{
+    output_.print(str);
+    return *this;
+}
+
+ResponseWriter&
+ResponseWriter::Write(const char* str)
+{
+    output_.write(str);
+    return *this;
+}
+
+ResponseWriter&
+ResponseWriter::Write(char ch)
+{
+    output_.write(static_cast<uint8_t>(ch));
+    return *this;
+}
+
+ResponseWriter&
+ResponseWriter::WriteDecimal(uint32_t value, uint8_t min_digits)
+{
+    return WriteNumber(value, 10, min_digits);
+}
+
+ResponseWriter&
+ResponseWriter::WriteHex(uint32_t value, uint8_t min_digits)
+{
+    return WriteNumber(value, 16, min_digits);
+}
+
+ResponseWriter&
+ResponseWriter::WriteNumber(uint32_t value, uint8_t base, uint8_t min_digits)
+{
+    // Digits are produced from the least significant one
+    char    digits[10];  // Enough for decimal uint32_t
+    uint8_t num_of_digits{0};
+    do {
+        uint8_t digit           = value % base;
+        digits[num_of_digits++] = (digit < 10) ? ('0' + digit) : ('a' + digit - 10);
+        value /= base;
+    } while (value != 0);
+
+    for (; min_digits > num_of_digits; --min_digits) {
+        output_.write('0');
+    }
+    while (num_of_digits != 0) {
+        output_.write(static_cast<uint8_t>(digits[--num_of_digits]));
+    }
+    return *this;
+}
@@ -0,0 +1,32 @@
+#ifndef RESPONSE_WRITER_H_
+#define RESPONSE_WRITER_H_
+
+#include <Print.h>
+#include <stdint.h>
+
+// Streams reply piece by piece into any Print (Serial, or a fixed buffer implementing Print), so reply is never
+// built in RAM and no String is allocated. Integer fields are formatted without printf.
+//
+// Usage:
+//     ResponseWriter writer{Serial};
+//     writer.Write(FPSTR(esp_get_brightness_ack)).WriteDecimal(brightness, 4).Write('\n');
+class ResponseWriter
+{
+public:
+    explicit ResponseWriter(Print& output);
+
+    ResponseWriter& Write(const __FlashStringHelper* str);  // String in PROGMEM
+    ResponseWriter& Write(const char* str);
+    ResponseWriter& Write(char ch);
+
+    // Writes at least <min_digits> digits, padding value with leading zeros
+    ResponseWriter& WriteDecimal(uint32_t value, uint8_t min_digits = 1);
+    ResponseWriter& WriteHex(uint32_t value, uint8_t min_digits = 1);  // Lowercase digits
+
+private:
+    ResponseWriter& WriteNumber(uint32_t value, uint8_t base, uint8_t min_digits);
+
+    Print& output_;
+};
+
+#endif  // RESPONSE_WRITER_H_
@@ -0,0 +1,86 @@
+#ifndef RING_BUFFER_H_
+#define RING_BUFFER_H_
+
+#include <stdint.h>
+
+// Lock-free byte queue for exactly one producer (interrupt handler) and one consumer (main loop).
+//
+// Read and write positions are free-running 8-bit counters, and each of them is modified only by one side. 8-bit
+// access is atomic on AVR, and all shared data is volatile, so no critical sections are needed. When the buffer is
+// full, producer drops bytes, but remembers that the next stored byte follows a gap, so consumer can discard the
+// damaged data instead of using it.
+//
+// Size should be a power of 2 not greater than 128.
+template <uint8_t Size>
+class RingBuffer
+{
+    static_assert((Size != 0) && ((Size & (Size - 1)) == 0) && (Size <= 128), "Size should be a power of 2 <= 128");
+
+public:
+    // Producer side. Returns false, if the byte is dropped
+    bool
+    Push(uint8_t value)
+    {
+        uint8_t position = write_position_;
+        if (static_cast<uint8_t>(position - read_position_) == Size) {
+            is_dropping_ = true;
+            ++num_of_dropped_;
+            return false;
+        }
+
+        uint8_t index = position & kMask;
+        data_[index]  = value;
+        if (is_dropping_) {
+            gap_marks_[index / 8] |= (1 << (index % 8));
+        }
+        else {
+            gap_marks_[index / 8] &= static_cast<uint8_t>(~(1 << (index % 8)));
+        }
+        is_dropping_    = false;
+        write_position_ = position + 1;
+        return true;
+    }
+
+    // Consumer side. Returns false, if there is no data. <is_after_gap> is set if some bytes were dropped right
+    // before this one
+    bool
+    Pop(uint8_t& value, bool& is_after_gap)
+    {
+        uint8_t position = read_position_;
+        if (position == write_position_) {
+            return false;
+        }
+
+        uint8_t index  = position & kMask;
+        value          = data_[index];
+        is_after_gap   = gap_marks_[index / 8] & (1 << (index % 8));
+        read_position_ = position + 1;
+        return true;
+    }
+
+    // Consumer side
+    bool
+    IsEmpty() const
+    {
+        return read_position_ == write_position_;
+    }
+
+    // Number of bytes dropped by producer. Counter is 16-bit, so consumer should read it with interrupts disabled
+    uint16_t
+    GetNumOfDropped() const
+    {
+        return num_of_dropped_;
+    }
+
+private:
+    static constexpr uint8_t kMask{Size - 1};
+
+    volatile uint8_t  data_[Size];
+    volatile uint8_t  gap_marks_[(Size + 7) / 8]{};  // Bit per byte of data_
+    volatile uint8_t  write_position_{0};
+    volatile uint8_t  read_position_{0};
+    volatile uint16_t num_of_dropped_{0};
+    bool              is_dropping_{false};  // Producer only
+};
+
+#endif  // RING_BUFFER_H_
@@ -0,0 +1,134 @@
+#include "scheduler.h"
+
+#include <Arduino.h>
+
+Scheduler::Scheduler(PerfMonitor& perf_monitor)
+  : num_of_tasks_{0}
+  , num_of_active_tasks_{0}
+  , perf_monitor_{perf_monitor}
+{
+}
+
+bool
+Scheduler::AddTask(Task* task, PerfMonitor::Stage stage, uint32_t first_delay_ms)
+{
+    if (num_of_tasks_ >= kMaxTasks) {
+        Serial.println(F("ERROR: too many tasks in scheduler"));
+        return false;
+    }
+
+    // Keep disabled tasks at the end of queue
+    queue_[num_of_tasks_++]      = queue_[num_of_active_tasks_];
+    queue_[num_of_active_tasks_] = Entry{task, millis() + first_delay_ms, stage};
+    SiftUp(num_of_active_tasks_++);
+    return true;
+}
+
+void
+Scheduler::SetTaskEnabled(Task* task, bool is_enabled)
+{
+    auto index = FindTask(task);
+    if (index < 0) {
+        return;
+    }
+
+    bool was_enabled{index < num_of_active_tasks_};
+    if (is_enabled == was_enabled) {
+        return;
+    }
+
+    if (is_enabled) {
+        Swap(index, num_of_active_tasks_);
+        queue_[num_of_active_tasks_].deadline = millis();
+        SiftUp(num_of_active_tasks_++);
+    }
+    else {
+        // Move task to the end of active part of queue. Order of other tasks is not changed
+        for (uint8_t i = index; i + 1 < num_of_active_tasks_; ++i) {
+            Swap(i, i + 1);
+        }
+        --num_of_active_tasks_;
+    }
+}
+
+void
+Scheduler::Loop()
+{
+    // Every run moves deadline of the task to the future, so each task is run at most once per call.
+    // NOTE: tasks should not add, enable or disable tasks from Run()
+    while (num_of_active_tasks_ != 0) {
+        auto  now  = millis();
+        auto& head = queue_[0];
+        if (IsBefore(now, head.deadline)) {
+            return;
+        }
+
+        perf_monitor_.SkipLap();
+        head.task->Run();
+        perf_monitor_.Lap(head.stage);
+
+        // Keep phase of the task, unless it is late for more than one period
+        auto period = head.task->GetPeriodMs();
+        head.deadline += period;
+        now = millis();
+        if (!IsBefore(now, head.deadline)) {
+            head.deadline = now + period;
+        }
+        SiftDown(0);
+
+        if (period == 0) {
+            // Task wants to be run as often as possible. Give other code in main loop chance to run.
+            return;
+        }
+    }
+}
+
+uint32_t
+Scheduler::GetNextDeadline() const
+{
+    return (num_of_active_tasks_ != 0) ? queue_[0].deadline : millis();
+}
+
+bool
+Scheduler::IsBefore(uint32_t l, uint32_t r)
+{
+    // Correctly handles overflow of millis()
+    return static_cast<int32_t>(l - r) < 0;
+}
+
+int8_t
+Scheduler::FindTask(Task* task) const
+{
+    for (uint8_t i = 0; i < num_of_tasks_; ++i) {
+        if (queue_[i].task == task) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void
+Scheduler::Swap(uint8_t i, uint8_t j)
+{
+    auto tmp  = queue_[i];
+    queue_[i] = queue_[j];
+    queue_[j] = tmp;
+}
+
+void
+Scheduler::SiftDown(uint8_t index)
+{
+    while ((index + 1 < num_of_active_tasks_) && !IsBefore(queue_[index].deadline, queue_[index + 1].deadline)) {
+        Swap(index, index + 1);
+        ++index;
+    }
+}
+
+void
+Scheduler::SiftUp(uint8_t index)
+{
+    while ((index > 0) && IsBefore(queue_[index].deadline, queue_[index - 1].deadline)) {
+        Swap(index, index - 1);
+        --index;
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include <stdint.h>
+
+#include "perf_monitor.h"
+
+// Cooperative scheduler for periodic tasks. Tasks are kept in a queue sorted by deadline, so on each iteration of
+// main loop Loop() only compares current time with deadline of the first task, and runs only tasks which deadline
+// has passed. Each task instance has its own deadline and period. Period is requested from the task after each run,
+// so task can change it at runtime.
+//
+// Execution time of each task is recorded in PerfMonitor under the stage, which task was added with.
+class Scheduler
+{
+public:
+    class Task
+    {
+    public:
+        virtual void     Run()               = 0;
+        virtual uint32_t GetPeriodMs() const = 0;
+    };
+
+    explicit Scheduler(PerfMonitor& perf_monitor);
+
+    // Returns false if there is no free slot for the task. Task will be run first time in <first_delay_ms>
+    bool AddTask(Task* task, PerfMonitor::Stage stage, uint32_t first_delay_ms = 0);
+
+    // Disabled task is not run. When task is enabled again, it is run on the next Loop()
+    void SetTaskEnabled(Task* task, bool is_enabled);
+
+    // Runs all enabled tasks with passed deadline
+    void Loop();
+
+    // Deadline of the nearest enabled task. It is current time, if there are no enabled tasks
+    uint32_t GetNextDeadline() const;
+
+private:
+    struct Entry
+    {
+        Task*              task;
+        uint32_t           deadline;
+        PerfMonitor::Stage stage;
+    };
+
+    static bool IsBefore(uint32_t l, uint32_t r);
+    int8_t      FindTask(Task* task) const;
+    void        Swap(uint8_t i, uint8_t j);
+    void        SiftDown(uint8_t index);  // Moves entry towards end of active part of queue to keep it sorted
+    void        SiftUp(uint8_t index);    // Moves entry towards beginning of queue to keep it sorted
+
+    static constexpr uint8_t kMaxTasks{8};
+
+    // Entries [0, num_of_active_tasks_) are enabled tasks sorted by deadline (nearest first).
+    // Entries [num_of_active_tasks_, num_of_tasks_) are disabled tasks.
+    Entry        queue_[kMaxTasks];
+    uint8_t      num_of_tasks_;
+    uint8_t      num_of_active_tasks_;
+    PerfMonitor& perf_monitor_;
+};
+
+#endif  // SCHEDULER_H_
@@ -0,0 +1,159 @@
+#include "telemetry.h"
+
+#include <Arduino.h>
+
+namespace
+{
+uint16_t
+ZigZag(int16_t value)
+{
+    return (static_cast<uint16_t>(value) << 1) ^ static_cast<uint16_t>(value >> 15);
+}
+
+int16_t
+UnZigZag(uint16_t value)
+{
+    return static_cast<int16_t>(value >> 1) ^ -static_cast<int16_t>(value & 1);
+}
+
+uint8_t
+WriteVarint(uint8_t* data, uint16_t value)
+{
+    uint8_t length{0};
+    while (value >= 0x80) {
+        data[length++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    data[length++] = value;
+    return length;
+}
+}  // namespace
+
+Telemetry::Telemetry(Source& source, uint32_t period_ms)
+  : source_(source)
+  , period_ms_{period_ms}
+  , head_{0}
+  , size_{0}
+  , num_of_samples_{0}
+  , base_{}
+  , last_{}
+{
+}
+
+void
+Telemetry::Run()
+{
+    Sample sample;
+    source_.FillTelemetrySample(sample);
+
+    State state;
+    state.time_s = millis() / 1000;
+    for (uint8_t i = 0; i < ThermoSensors::kMaxNumOfSensors; ++i) {
+        state.values[i] = sample.temperatures[i];
+    }
+    state.values[ThermoSensors::kMaxNumOfSensors]     = sample.fan_speed;
+    state.values[ThermoSensors::kMaxNumOfSensors + 1] = sample.led_level;
+    state.values[ThermoSensors::kMaxNumOfSensors + 2] = sample.thermal_factor;
+    state.values[ThermoSensors::kMaxNumOfSensors + 3] = sample.mode;
+
+    // Deltas are written after the mask, which is known only at the end, so they are encoded into separate buffer
+    uint8_t  deltas[kMaxRecordSize];
+    uint8_t  deltas_length{0};
+    uint16_t mask{0};
+    for (uint8_t i = 0; i < kNumOfValues; ++i) {
+        int16_t delta = state.values[i] - last_.values[i];
+        if (delta != 0) {
+            mask |= 1 << i;
+            deltas_length += WriteVarint(deltas + deltas_length, ZigZag(delta));
+        }
+    }
+    int16_t time_delta = state.time_s - last_.time_s - period_ms_ / 1000;
+    if (time_delta != 0) {
+        mask |= 1 << kTimeBit;
+        deltas_length += WriteVarint(deltas + deltas_length, ZigZag(time_delta));
+    }
+
+    uint8_t record[kMaxRecordSize];
+    uint8_t length{WriteVarint(record, mask)};
+    memcpy(record + length, deltas, deltas_length);
+    length += deltas_length;
+
+    while (kBufferSize - size_ < length) {
+        DropOldestSample();
+    }
+    uint16_t position{static_cast<uint16_t>(head_ + size_)};
+    for (uint8_t i = 0; i < length; ++i) {
+        if (position >= kBufferSize) {
+            position -= kBufferSize;
+        }
+        buffer_[position++] = record[i];
+    }
+    size_ += length;
+    ++num_of_samples_;
+    last_ = state;
+}
+
+uint32_t
+Telemetry::GetPeriodMs() const
+{
+    return period_ms_;
+}
+
+void
+Telemetry::Write(ResponseWriter& writer) const
+{
+    // P N TIME V0 V1 ... V7 DATA
+    writer.WriteDecimal(period_ms_ / 1000)
+        .Write(' ')
+        .WriteDecimal(num_of_samples_)
+        .Write(' ')
+        .WriteDecimal(base_.time_s);
+    for (auto value : base_.values) {
+        writer.Write(' ').WriteDecimal(value);
+    }
+    writer.Write(' ');
+
+    uint16_t position{head_};
+    for (uint16_t i = 0; i < size_; ++i) {
+        writer.WriteHex(buffer_[position], 2);
+        if (++position == kBufferSize) {
+            position = 0;
+        }
+    }
+}
+
+void
+Telemetry::DropOldestSample()
+{
+    uint16_t position{head_};
+    uint16_t mask{ReadVarint(position)};
+    for (uint8_t i = 0; i < kNumOfValues; ++i) {
+        if (mask & (1 << i)) {
+            base_.values[i] += UnZigZag(ReadVarint(position));
+        }
+    }
+    base_.time_s += period_ms_ / 1000;
+    if (mask & (1 << kTimeBit)) {
+        base_.time_s += UnZigZag(ReadVarint(position));
+    }
+
+    size_ -= (position >= head_) ? (position - head_) : (position + kBufferSize - head_);
+    head_ = position;
+    --num_of_samples_;
+}
+
+uint16_t
+Telemetry::ReadVarint(uint16_t& position) const
+{
+    uint16_t value{0};
+    for (uint8_t shift = 0;; shift += 7) {
+        uint8_t byte{buffer_[position]};
+        if (++position == kBufferSize) {
+            position = 0;
+        }
+        value |= static_cast<uint16_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <stdint.h>
+
+#include "devices/thermosensors.hpp"
+#include "fixed_point.h"
+#include "response_writer.h"
+#include "scheduler.h"
+
+// Keeps history of lamp state in RAM: a sample is recorded once per period, and the oldest samples are dropped when
+// buffer is full. History is sent to ESP by one command, so there is no serial traffic between requests.
+//
+// Each value of a sample is stored as difference from the previous sample, and only changed values are stored:
+//     <varint mask of changed values> <varint zigzag delta of each changed value, from bit 0 up>
+// Values (bit of mask): temperatures of sensors 0..3 (bits 0-3), fan speed (4), LED level (5), thermal factor (6),
+// mode (7) and time in seconds (8). Time delta is stored minus period, so it is 0 for every sample recorded in time.
+// Varint is 7 bits per byte, least significant first, high bit is set in all bytes except the last one. Zigzag maps
+// signed delta d to unsigned (d << 1) ^ (d >> 15). Values are 16-bit and deltas wrap around, except time.
+// Stable sample takes one byte.
+//
+// Dump contains base state, which is the state before the oldest stored sample, so ESP restores samples by adding
+// deltas to it one by one. When the oldest sample is dropped, its deltas are added to base state.
+class Telemetry : public Scheduler::Task
+{
+public:
+    struct Sample
+    {
+        Q8_8     temperatures[ThermoSensors::kMaxNumOfSensors];  // kInvalidTemperature for absent sensor
+        uint8_t  fan_speed;
+        uint16_t led_level;  // Full scale 16-bit
+        Q8_8     thermal_factor;
+        uint8_t  mode;  // Defined by Source
+    };
+
+    class Source
+    {
+    public:
+        virtual void FillTelemetrySample(Sample& sample) = 0;
+    };
+
+    Telemetry(Source& source, uint32_t period_ms);
+    void     Run() override;  // Records sample
+    uint32_t GetPeriodMs() const override;
+
+    // Format: P N TIME V0 V1 ... V7 DATA
+    // P is period in seconds, N is number of samples, TIME (seconds since start) and values V0..V7 (in order of mask
+    // bits, as unsigned 16-bit) are base state, DATA is hex of all encoded samples from the oldest one
+    void Write(ResponseWriter& writer) const;
+
+private:
+    static constexpr uint8_t  kNumOfValues{ThermoSensors::kMaxNumOfSensors + 4};
+    static constexpr uint8_t  kTimeBit{kNumOfValues};
+    // ATmega328P has 2 KB of RAM for everything, so history gets a small fixed share. Stable sample takes one byte,
+    // and a sample with changed temperatures takes ~5 bytes, so buffer keeps from few minutes to 16 minutes of history
+    static constexpr uint16_t kBufferSize{96};
+    static constexpr uint16_t kMaxRamSize{160};  // Buffer and both states
+    static constexpr uint8_t  kMaxRecordSize{3 * (kNumOfValues + 2)};  // Mask and all deltas are 3 bytes at most
+
+    struct State
+    {
+        uint32_t time_s;
+        uint16_t values[kNumOfValues];
+    };
+    static_assert(kMaxRecordSize <= kBufferSize, "Buffer should fit the largest sample");
+    static_assert(kBufferSize + 2 * sizeof(State) <= kMaxRamSize, "Telemetry takes too much RAM");
+
+    void     DropOldestSample();
+    uint16_t ReadVarint(uint16_t& position) const;  // Reads from the buffer and moves position
+
+    Source&        source_;
+    const uint32_t period_ms_;
+
+    uint8_t  buffer_[kBufferSize];
+    uint16_t head_;  // Position of the oldest byte
+    uint16_t size_;  // Number of used bytes
+    uint16_t num_of_samples_;
+    State    base_;  // State before the oldest sample
+    State    last_;  // State of the newest sample
+};
+
+#endif  // TELEMETRY_H_
@@ -0,0 +1,79 @@
+#ifndef TREND_ESTIMATOR_H_
+#define TREND_ESTIMATOR_H_
+
+#include <stdint.h>
+
+#include "fixed_point.h"
+
+// Estimates rate of change of a signal, which is sampled with constant period: slope of least squares line through
+// the last Size samples. Samples are Q8.8, slope is Q8.8 per sampling period.
+//
+// Time axis is centered on the middle of the window, so time of samples in halves of period is odd weight
+// -(Size - 1), ..., -1, 1, ..., Size - 1, and slope = 2 * sum(weight * sample) / sum(weight^2). Divisor is constant,
+// so it is replaced by multiplication by its reciprocal.
+template <uint8_t Size>
+class TrendEstimator
+{
+    static_assert((Size >= 4) && (Size <= 16), "Size should be in range [4, 16]");
+
+public:
+    void
+    AddSample(Q8_8 value)
+    {
+        samples_[position_] = value;
+        if (++position_ == Size) {
+            position_ = 0;
+        }
+        if (num_of_samples_ < Size) {
+            ++num_of_samples_;
+        }
+    }
+
+    void
+    Reset()
+    {
+        num_of_samples_ = 0;
+        position_       = 0;
+    }
+
+    // Slope is estimated only when window is full
+    bool
+    IsReady() const
+    {
+        return num_of_samples_ == Size;
+    }
+
+    Q8_8
+    GetSlope() const
+    {
+        if (!IsReady()) {
+            return 0;
+        }
+
+        // The oldest sample is at position_
+        int32_t sum{0};
+        uint8_t index{position_};
+        for (int8_t weight = 1 - Size; weight < Size; weight += 2) {
+            sum += static_cast<int32_t>(samples_[index]) * weight;
+            if (++index == Size) {
+                index = 0;
+            }
+        }
+        return SaturateQ8_8((sum * kReciprocal + (1L << (kReciprocalBits - 1))) >> kReciprocalBits);
+    }
+
+private:
+    static constexpr int32_t kSumOfSquaredWeights{static_cast<int32_t>(Size) * (Size * Size - 1) / 3};
+    static constexpr uint8_t kReciprocalBits{16};
+    static constexpr int32_t kReciprocal{((2L << kReciprocalBits) + kSumOfSquaredWeights / 2) / kSumOfSquaredWeights};
+    // Samples differ by 65535 at most, and sum of positive weights is Size^2/4. Windows shorter than 4 samples
+    // overflow, and longer ones can't reach limits of Q8.8 slope
+    static_assert(65535L * (Size * Size / 4) <= (INT32_MAX - (1L << (kReciprocalBits - 1))) / kReciprocal,
+                  "Weighted sum multiplied by reciprocal should fit int32_t");
+
+    Q8_8    samples_[Size];
+    uint8_t position_{0};  // Where the next sample is written
+    uint8_t num_of_samples_{0};
+};
+
+#endif  // TREND_ESTIMATOR_H_
@@ -5,6 +5,21 @@
 
 #define DEBUG_PRINTING
 
+// This macro is defined for ESP, but not defined for Arduino. It is used to get access to strings in Flash
+#define FPSTR(pstr_pointer) (reinterpret_cast<const __FlashStringHelper*>(pstr_pointer))
+
+// Parses up to <max_digits> decimal digits. Stops at first non-digit character, so it can be used on a part of
+// string without copying it
+inline uint16_t
+ParseDecimal(const char* str, uint8_t max_digits)
+{
+    uint16_t result{0};
+    for (; (max_digits != 0) && (*str >= '0') && (*str <= '9'); --max_digits, ++str) {
+        result = result * 10 + (*str - '0');
+    }
+    return result;
+}
+
 template <typename T>
 void
 DebugPrint(const T& str)
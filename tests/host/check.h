@@ -0,0 +1,54 @@
+#ifndef CHECK_H_
+#define CHECK_H_
+
+#include <stdio.h>
+
+// Minimal assertions for host tests. Failed check is printed and the test goes on, so one run shows all failures.
+// Test's main() returns CheckResult().
+namespace check
+{
+inline int&
+NumOfFailures()
+{
+    static int num_of_failures{0};
+    return num_of_failures;
+}
+}  // namespace check
+
+#define CHECK(condition)                                                                  \
+    do {                                                                                  \
+        if (!(condition)) {                                                               \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++check::NumOfFailures();                                                     \
+        }                                                                                 \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                    \
+    do {                                                              \
+        long long actual_value   = static_cast<long long>(actual);    \
+        long long expected_value = static_cast<long long>(expected);  \
+        if (actual_value != expected_value) {                         \
+            fprintf(stderr,                                           \
+                    "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", \
+                    __FILE__,                                         \
+                    __LINE__,                                         \
+                    #actual,                                          \
+                    #expected,                                        \
+                    actual_value,                                     \
+                    expected_value);                                  \
+            ++check::NumOfFailures();                                 \
+        }                                                             \
+    } while (0)
+
+inline int
+CheckResult()
+{
+    if (check::NumOfFailures() != 0) {
+        fprintf(stderr, "%d check(s) failed\n", check::NumOfFailures());
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
+
+#endif  // CHECK_H_
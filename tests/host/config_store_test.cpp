@@ -0,0 +1,213 @@
+// Tests of ConfigStore: commits rotate over slots of the ring, and damaged slots are detected by CRC-16.
+
+#include <avr/eeprom.h>
+#include <config_store.h>
+#include <devices/eeprom_map.h>
+
+#include "check.h"
+#include "hal/sim.h"
+
+namespace
+{
+constexpr uint32_t kQuietPeriodUs{5000000};
+constexpr uint16_t kSlotSize{sizeof(ConfigStore::Config) + 4};  // Sequence number, version, config, CRC-16
+constexpr uint8_t  kNumOfSlots{kConfigStoreSize / kSlotSize};
+constexpr uint8_t  kConfigOffset{2};  // In slot
+
+ConfigStore::Config
+MakeConfig(uint16_t value)
+{
+    ConfigStore::Config config{};
+    config.sunrise_duration_min = value;
+    config.fan_pwm_frequency    = ~value;
+    return config;
+}
+
+uint8_t
+ReadSequence(uint8_t slot)
+{
+    return eeprom_read_byte(config_store_address + slot * kSlotSize);
+}
+
+// Sequence numbers grow by 1 from slot to slot up to the newest one
+uint8_t
+FindNewestSlot()
+{
+    uint8_t slot{0};
+    while ((slot + 1 < kNumOfSlots) && (ReadSequence(slot + 1) == static_cast<uint8_t>(ReadSequence(slot) + 1))) {
+        ++slot;
+    }
+    return slot;
+}
+
+// Returns slot, which config is committed to, or -1 if nothing is committed
+int
+Commit(ConfigStore& store, const ConfigStore::Config& config)
+{
+    auto writes = sim::EepromWriteCount();
+    store.Update(config);
+    sim::AdvanceMicros(kQuietPeriodUs);
+    store.Run();
+    return (sim::EepromWriteCount() == writes) ? -1 : FindNewestSlot();
+}
+
+// Loads config by new store, as it happens after reboot
+bool
+Load(ConfigStore::Config& config)
+{
+    ConfigStore store;
+    return store.Load(config);
+}
+
+void
+CorruptByte(uint8_t slot, uint16_t offset)
+{
+    auto address = config_store_address + slot * kSlotSize + offset;
+    eeprom_write_byte(address, eeprom_read_byte(address) ^ 0x01);
+}
+
+void
+TestErasedEeprom()
+{
+    sim::Reset();
+    ConfigStore::Config config;
+    CHECK(!Load(config));
+}
+
+// Each commit goes to the next slot. Slots of erased EEPROM have the same sequence number, so the first one is taken as
+// the newest, and the first commit goes to slot 1. Sequence number wraps around after 256 commits, so ring is checked
+// long enough
+void
+TestRotation()
+{
+    sim::Reset();
+    ConfigStore         store;
+    ConfigStore::Config config;
+    CHECK(!store.Load(config));
+
+    for (uint16_t i = 0; i < 300; ++i) {
+        CHECK_EQ(Commit(store, MakeConfig(i)), (i + 1) % kNumOfSlots);
+
+        ConfigStore::Config loaded;
+        CHECK(Load(loaded));
+        CHECK_EQ(loaded.sunrise_duration_min, i);
+    }
+}
+
+// Changes during quiet period are coalesced, and config equal to the stored one is not written
+void
+TestCoalescing()
+{
+    sim::Reset();
+    ConfigStore         store;
+    ConfigStore::Config config;
+    store.Load(config);
+    CHECK_EQ(Commit(store, MakeConfig(1)), 1);
+
+    auto writes = sim::EepromWriteCount();
+    for (uint16_t i = 2; i < 10; ++i) {
+        store.Update(MakeConfig(i));
+        sim::AdvanceMicros(kQuietPeriodUs / 10);
+        store.Run();
+    }
+    CHECK_EQ(sim::EepromWriteCount(), writes);
+    CHECK_EQ(Commit(store, MakeConfig(10)), 2);
+
+    writes = sim::EepromWriteCount();
+    CHECK_EQ(Commit(store, MakeConfig(10)), -1);
+    CHECK_EQ(sim::EepromWriteCount(), writes);
+
+    // Changed and changed back
+    store.Update(MakeConfig(11));
+    CHECK_EQ(Commit(store, MakeConfig(10)), -1);
+    CHECK_EQ(sim::EepromWriteCount(), writes);
+}
+
+// Damaged slot is skipped, the previous one is loaded, and the next commit overwrites the damaged slot
+void
+TestRecovery()
+{
+    sim::Reset();
+    ConfigStore         store;
+    ConfigStore::Config config;
+    store.Load(config);
+    for (uint16_t i = 0; i < kNumOfSlots + 2; ++i) {
+        Commit(store, MakeConfig(i));
+    }
+    uint8_t newest = (kNumOfSlots + 2) % kNumOfSlots;
+
+    // Every byte of version, config and CRC is covered by CRC
+    for (uint16_t offset = 1; offset < kSlotSize; ++offset) {
+        CorruptByte(newest, offset);
+        CHECK(Load(config));
+        CHECK_EQ(config.sunrise_duration_min, kNumOfSlots);
+        CorruptByte(newest, offset);
+    }
+
+    CorruptByte(newest, kConfigOffset);
+    ConfigStore recovered;
+    CHECK(recovered.Load(config));
+    CHECK_EQ(config.sunrise_duration_min, kNumOfSlots);
+    CHECK_EQ(Commit(recovered, MakeConfig(100)), newest);
+    CHECK(Load(config));
+    CHECK_EQ(config.sunrise_duration_min, 100);
+
+    // All slots are damaged
+    for (uint8_t slot = 0; slot < kNumOfSlots; ++slot) {
+        CorruptByte(slot, kConfigOffset);
+    }
+    CHECK(!Load(config));
+}
+
+// Power is lost before sequence number is written: slot is not the newest one, even if the rest is written
+void
+TestInterruptedWrite()
+{
+    sim::Reset();
+    ConfigStore         store;
+    ConfigStore::Config config;
+    store.Load(config);
+    CHECK_EQ(Commit(store, MakeConfig(1)), 1);
+    CHECK_EQ(Commit(store, MakeConfig(2)), 2);
+    CHECK_EQ(Commit(store, MakeConfig(3)), 3);
+
+    // Slot 3 keeps sequence number of erased EEPROM
+    eeprom_write_byte(config_store_address + 3 * kSlotSize, 0xFF);
+    CHECK(Load(config));
+    CHECK_EQ(config.sunrise_duration_min, 2);
+}
+
+// Settings of older firmware are taken only from written cells, the rest of config is kept
+void
+TestLegacySettings()
+{
+    sim::Reset();
+    ConfigStore::Config config = MakeConfig(7);
+    CHECK(!ConfigStore::LoadLegacy(config));
+    CHECK_EQ(config.sunrise_duration_min, 7);
+
+    const uint8_t legacy[kLegacySettingsSize] = {0x7F, 30, 6, 1, 20, 0, 0xFF, 0xFF, 0xFF, 0xFF};
+    for (uint8_t i = 0; i < kLegacySettingsSize; ++i) {
+        eeprom_write_byte(legacy_settings_address + i, legacy[i]);
+    }
+    CHECK(ConfigStore::LoadLegacy(config));
+    CHECK_EQ(config.alarms[0].hour, 6);
+    CHECK_EQ(config.alarms[0].minute, 30);
+    CHECK(config.alarms[0].dow == Timer::DaysOfWeek::kEveryDay);
+    CHECK(config.is_alarm_enabled);
+    CHECK_EQ(config.sunrise_duration_min, 20);
+    CHECK_EQ(config.fan_pwm_frequency, static_cast<uint16_t>(~7));
+}
+}  // namespace
+
+int
+main()
+{
+    TestErasedEeprom();
+    TestRotation();
+    TestCoalescing();
+    TestRecovery();
+    TestInterruptedWrite();
+    TestLegacySettings();
+    return CheckResult();
+}
@@ -0,0 +1,102 @@
+// Tests of filter stages and their chaining, see filter_chain.h.
+
+#include <filter_chain.h>
+
+#include "check.h"
+
+namespace
+{
+void
+TestEmptyChain()
+{
+    FilterChain<> chain;
+    CHECK_EQ(chain.Apply(123), 123);
+    CHECK_EQ(chain.Apply(-32768), -32768);
+}
+
+void
+TestMedian()
+{
+    Median<3> median;
+    // The first sample fills the window, so output doesn't start from 0
+    CHECK_EQ(median.Apply(100), 100);
+    // Spikes shorter than half of window are removed
+    CHECK_EQ(median.Apply(1000), 100);
+    CHECK_EQ(median.Apply(102), 102);
+    CHECK_EQ(median.Apply(-900), 102);
+    CHECK_EQ(median.Apply(104), 102);
+    // Step is followed after half of window
+    CHECK_EQ(median.Apply(500), 104);
+    CHECK_EQ(median.Apply(500), 500);
+
+    median.Reset();
+    CHECK_EQ(median.Apply(-7), -7);
+    CHECK_EQ(median.Apply(5), -7);
+
+    Median<5>     wide;
+    const int16_t samples[]  = {10, 50, 20, 40, 30, 0, 60};
+    const int16_t expected[] = {10, 10, 10, 20, 30, 30, 30};
+    for (uint8_t i = 0; i < sizeof(samples) / sizeof(samples[0]); ++i) {
+        CHECK_EQ(wide.Apply(samples[i]), expected[i]);
+    }
+}
+
+void
+TestAdaptiveEma()
+{
+    // Slow factor 0.2, fast factor 1.0 above 50
+    AdaptiveEma<2, 10, 50> ema;
+    CHECK_EQ(ema.Apply(1000), 1000);
+
+    // Small difference: moves by 1/5 of it, fractional part is kept between samples
+    int16_t value{1000};
+    for (uint8_t i = 0; i < 50; ++i) {
+        int16_t next = ema.Apply(1040);
+        CHECK(next >= value);
+        value = next;
+    }
+    CHECK_EQ(value, 1040);
+
+    // Big step is followed at once
+    CHECK_EQ(ema.Apply(2000), 2000);
+    CHECK_EQ(ema.Apply(-2000), -2000);
+
+    // Extreme samples don't overflow state
+    CHECK_EQ(ema.Apply(32767), 32767);
+    CHECK_EQ(ema.Apply(-32768), -32768);
+
+    ema.Reset();
+    CHECK_EQ(ema.Apply(7), 7);
+    CHECK_EQ(ema.Apply(17), 9);
+}
+
+void
+TestChain()
+{
+    // Spike is removed by median before it reaches EMA, so EMA doesn't jump
+    FilterChain<Median<3>, AdaptiveEma<2, 10, 50>> chain;
+    CHECK_EQ(chain.Apply(100), 100);
+    CHECK_EQ(chain.Apply(5000), 100);
+    CHECK_EQ(chain.Apply(100), 100);
+
+    // Small change passes median and is smoothed by EMA: 1/5 of difference per sample
+    CHECK_EQ(chain.Apply(110), 102);
+    CHECK_EQ(chain.Apply(110), 104);
+
+    chain.Reset();
+    CHECK_EQ(chain.Apply(-300), -300);
+
+    // Empty tail takes no memory
+    static_assert(sizeof(FilterChain<Median<3>>) == sizeof(Median<3>), "Empty chain should take no memory");
+}
+}  // namespace
+
+int
+main()
+{
+    TestEmptyChain();
+    TestMedian();
+    TestAdaptiveEma();
+    TestChain();
+    return CheckResult();
+}
@@ -0,0 +1,83 @@
+#ifndef ARDUINO_H_
+#define ARDUINO_H_
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <type_traits>
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#include "HardwareSerial.h"
+#include "WString.h"
+#include "binary.h"
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define LED_BUILTIN 13
+
+constexpr uint8_t A0{14};
+constexpr uint8_t A1{15};
+constexpr uint8_t A2{16};
+constexpr uint8_t A3{17};
+constexpr uint8_t A4{18};
+constexpr uint8_t A5{19};
+constexpr uint8_t A6{20};
+constexpr uint8_t A7{21};
+
+typedef bool    boolean;
+typedef uint8_t byte;
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int  digitalRead(uint8_t pin);
+int  analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+
+// Like on AVR, time counters are 32 bit wide and overflow in ~50 days (millis) and ~70 minutes (micros)
+uint32_t millis();
+uint32_t micros();
+void     delay(uint32_t ms);
+void     delayMicroseconds(unsigned int us);
+
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+
+// Arduino defines these as macros. Templates give the same results without breaking standard headers.
+template <typename T, typename U>
+inline typename std::common_type<T, U>::type
+min(const T& a, const U& b)
+{
+    return (a < b) ? a : b;
+}
+
+template <typename T, typename U>
+inline typename std::common_type<T, U>::type
+max(const T& a, const U& b)
+{
+    return (a > b) ? a : b;
+}
+
+template <typename T>
+inline T
+abs(const T& x)
+{
+    return (x > 0) ? x : -x;
+}
+
+template <typename T, typename L, typename H>
+inline T
+constrain(const T& amt, const L& low, const H& high)
+{
+    return (amt < low) ? low : ((amt > high) ? high : amt);
+}
+
+#endif  // ARDUINO_H_
@@ -0,0 +1,19 @@
+#ifndef DS1307RTC_H_
+#define DS1307RTC_H_
+
+#include <TimeLib.h>
+
+// Simulated DS1307 on I2C bus. Every call is a blocking I2C transaction.
+class DS1307RTC
+{
+public:
+    static time_t get();
+    static bool   set(time_t t);
+    static bool   read(tmElements_t& tm);
+    static bool   write(tmElements_t& tm);
+    static bool   chipPresent();
+};
+
+extern DS1307RTC RTC;
+
+#endif  // DS1307RTC_H_
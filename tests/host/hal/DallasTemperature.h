@@ -0,0 +1,50 @@
+#ifndef DALLAS_TEMPERATURE_H_
+#define DALLAS_TEMPERATURE_H_
+
+#include <stdint.h>
+
+#include <OneWire.h>
+
+// Subset of DallasTemperature library. Like the original, it is built on top of OneWire, so all its calls cost
+// the same bus time as on real hardware.
+
+#define DEVICE_DISCONNECTED_C   -127
+#define DEVICE_DISCONNECTED_RAW -7040
+
+typedef uint8_t DeviceAddress[8];
+typedef uint8_t ScratchPad[9];
+
+class DallasTemperature
+{
+public:
+    DallasTemperature() = default;
+    explicit DallasTemperature(OneWire* one_wire);
+    void setOneWire(OneWire* one_wire);
+
+    void    begin();
+    uint8_t getDeviceCount();
+    bool    getAddress(uint8_t* address, uint8_t index);
+    bool    isConnected(const uint8_t* address, uint8_t* scratchpad);
+
+    void    setResolution(uint8_t resolution);
+    bool    setResolution(const uint8_t* address, uint8_t resolution, bool skip_global_bit_resolution_calculation = false);
+    uint8_t getResolution(const uint8_t* address);
+
+    void setWaitForConversion(bool wait);
+    void requestTemperatures();
+    bool isConversionComplete();
+
+    int16_t getTemp(const uint8_t* address);  // Raw value in 1/128 degrees
+    float   getTempC(const uint8_t* address);
+
+private:
+    bool ReadScratchPad(const uint8_t* address, uint8_t* scratchpad);
+    void WriteScratchPad(const uint8_t* address, const uint8_t* scratchpad);
+
+    OneWire* one_wire_{nullptr};
+    uint8_t  devices_{0};
+    uint8_t  bit_resolution_{9};
+    bool     wait_for_conversion_{true};
+};
+
+#endif  // DALLAS_TEMPERATURE_H_
@@ -0,0 +1,32 @@
+#ifndef EEPROM_H_
+#define EEPROM_H_
+
+#include <avr/eeprom.h>
+
+struct EEPROMClass
+{
+    uint8_t
+    read(int address)
+    {
+        return eeprom_read_byte(reinterpret_cast<const uint8_t*>(address));
+    }
+    void
+    write(int address, uint8_t value)
+    {
+        eeprom_write_byte(reinterpret_cast<uint8_t*>(address), value);
+    }
+    void
+    update(int address, uint8_t value)
+    {
+        eeprom_update_byte(reinterpret_cast<uint8_t*>(address), value);
+    }
+    uint16_t
+    length()
+    {
+        return 1024;
+    }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif  // EEPROM_H_
@@ -0,0 +1,33 @@
+#ifndef HARDWARE_SERIAL_H_
+#define HARDWARE_SERIAL_H_
+
+#include <stdint.h>
+
+#include "Print.h"
+
+#define SERIAL_RX_BUFFER_SIZE 64
+#define SERIAL_TX_BUFFER_SIZE 64
+
+// Simulated USART0. Timing of RX and TX follows baud rate, configured by begin(). See sim.h for details.
+class HardwareSerial : public Stream
+{
+public:
+    void   begin(unsigned long baud);
+    void   end();
+    int    available() override;
+    int    availableForWrite();
+    int    read() override;
+    int    peek() override;
+    void   flush();
+    size_t write(uint8_t c) override;
+    using Print::write;
+
+    explicit operator bool() const
+    {
+        return true;
+    }
+};
+
+extern HardwareSerial Serial;
+
+#endif  // HARDWARE_SERIAL_H_
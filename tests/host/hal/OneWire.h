@@ -0,0 +1,38 @@
+#ifndef ONEWIRE_H_
+#define ONEWIRE_H_
+
+#include <stdint.h>
+
+// Like the original library, pulls Arduino core in
+#include <Arduino.h>
+
+// Simulated OneWire master. Devices on the bus (see sim::AddDs18b20()) follow DS18B20 protocol on byte level.
+// Every reset, written and read byte costs as much simulated time as bit-banging it on real hardware.
+class OneWire
+{
+public:
+    OneWire() = default;
+    explicit OneWire(uint8_t pin);
+    void begin(uint8_t pin);
+
+    uint8_t reset();
+    void    select(const uint8_t rom[8]);
+    void    skip();
+    void    write(uint8_t value, uint8_t power = 0);
+    void    write_bytes(const uint8_t* buffer, uint16_t count, bool power = 0);
+    uint8_t read();
+    void    read_bytes(uint8_t* buffer, uint16_t count);
+    uint8_t read_bit();
+    void    depower();
+
+    void reset_search();
+    bool search(uint8_t* new_address, bool search_mode = true);
+
+    static uint8_t crc8(const uint8_t* address, uint8_t length);
+
+private:
+    uint8_t pin_{0xFF};
+    uint8_t search_index_{0};
+};
+
+#endif  // ONEWIRE_H_
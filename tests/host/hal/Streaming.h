@@ -0,0 +1,26 @@
+#ifndef STREAMING_H_
+#define STREAMING_H_
+
+#include "Print.h"
+
+template <class T>
+inline Print&
+operator<<(Print& obj, T arg)
+{
+    obj.print(arg);
+    return obj;
+}
+
+enum _EndLineCode
+{
+    endl
+};
+
+inline Print&
+operator<<(Print& obj, _EndLineCode)
+{
+    obj.println();
+    return obj;
+}
+
+#endif  // STREAMING_H_
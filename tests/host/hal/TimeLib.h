@@ -0,0 +1,36 @@
+#ifndef TIMELIB_H_
+#define TIMELIB_H_
+
+#include <stdint.h>
+#include <time.h>
+
+// Subset of Paul Stoffregen's Time library, used by firmware
+
+typedef struct
+{
+    uint8_t Second;
+    uint8_t Minute;
+    uint8_t Hour;
+    uint8_t Wday;  // Day of week, Sunday is day 1
+    uint8_t Day;
+    uint8_t Month;
+    uint8_t Year;  // Offset from 1970
+} tmElements_t;
+
+#define tmYearToCalendar(Y) ((Y) + 1970)
+#define CalendarYrToTm(Y)   ((Y)-1970)
+
+#define SECS_PER_MIN  (60UL)
+#define SECS_PER_HOUR (3600UL)
+#define SECS_PER_DAY  (SECS_PER_HOUR * 24UL)
+#define DAYS_PER_WEEK (7UL)
+#define SECS_PER_WEEK (SECS_PER_DAY * DAYS_PER_WEEK)
+
+#define dayOfWeek(_time_)        ((((_time_) / SECS_PER_DAY + 4) % DAYS_PER_WEEK) + 1)  // 1 = Sunday
+#define elapsedSecsToday(_time_) ((_time_) % SECS_PER_DAY)
+#define previousMidnight(_time_) (((_time_) / SECS_PER_DAY) * SECS_PER_DAY)
+
+void   breakTime(time_t time, tmElements_t& tm);
+time_t makeTime(const tmElements_t& tm);
+
+#endif  // TIMELIB_H_
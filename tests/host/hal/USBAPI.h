@@ -0,0 +1,7 @@
+#ifndef USBAPI_H_
+#define USBAPI_H_
+
+// Boards without native USB get Serial from HardwareSerial
+#include "HardwareSerial.h"
+
+#endif  // USBAPI_H_
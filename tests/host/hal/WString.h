@@ -0,0 +1,86 @@
+#ifndef WSTRING_H_
+#define WSTRING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <avr/pgmspace.h>
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper*>(PSTR(string_literal)))
+
+// Host implementation of Arduino String. Like the original, it keeps its characters in heap memory, and every
+// (re)allocation is counted, so tests can check that code paths are allocation free (see sim::StringAllocations()).
+class String
+{
+public:
+    String(const char* cstr = "");
+    String(const String& str);
+    String(String&& str);
+    String(const __FlashStringHelper* str);
+    explicit String(char c);
+    explicit String(unsigned char value, unsigned char base = 10);
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(float value, unsigned char decimal_places = 2);
+    explicit String(double value, unsigned char decimal_places = 2);
+    ~String();
+
+    String& operator=(const String& rhs);
+    String& operator=(String&& rhs);
+    String& operator=(const char* cstr);
+    String& operator=(const __FlashStringHelper* str);
+
+    bool concat(const String& str);
+    bool concat(const char* cstr);
+    bool concat(const char* cstr, unsigned int length);
+    bool concat(char c);
+    bool concat(const __FlashStringHelper* str);
+
+    String& operator+=(const String& rhs);
+    String& operator+=(const char* cstr);
+    String& operator+=(char c);
+
+    friend String operator+(const String& lhs, const String& rhs);
+    friend String operator+(const String& lhs, const char* cstr);
+    friend String operator+(const String& lhs, char c);
+    friend String operator+(const String& lhs, const __FlashStringHelper* rhs);
+    friend String operator+(const char* cstr, const String& rhs);
+
+    unsigned int length() const;
+    const char*  c_str() const;
+
+    bool equals(const String& s) const;
+    bool equals(const char* cstr) const;
+    bool operator==(const String& rhs) const;
+    bool operator==(const char* cstr) const;
+    bool operator!=(const String& rhs) const;
+    bool operator!=(const char* cstr) const;
+    bool startsWith(const String& prefix) const;
+
+    char  charAt(unsigned int index) const;
+    char  operator[](unsigned int index) const;
+    char& operator[](unsigned int index);
+
+    int    indexOf(char ch) const;
+    int    indexOf(char ch, unsigned int from_index) const;
+    String substring(unsigned int begin_index) const;
+    String substring(unsigned int begin_index, unsigned int end_index) const;
+    void   trim();
+
+    long  toInt() const;
+    float toFloat() const;
+
+private:
+    void Invalidate();
+    bool Reserve(unsigned int size);
+    void Copy(const char* cstr, unsigned int length);
+
+    char*        buffer_{nullptr};
+    unsigned int capacity_{0};
+    unsigned int length_{0};
+};
+
+#endif  // WSTRING_H_
@@ -0,0 +1,25 @@
+#ifndef WIRE_H_
+#define WIRE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Subset of Arduino Wire library. Only DS1307 is on the simulated I2C bus, and only writes of its control
+// register (SQW output) have effect. Every transmission costs the same time as RTC transaction.
+class TwoWire
+{
+public:
+    void    begin();
+    void    beginTransmission(uint8_t address);
+    size_t  write(uint8_t data);
+    uint8_t endTransmission();
+
+private:
+    uint8_t address_{0};
+    uint8_t data_[8]{};
+    uint8_t length_{0};
+};
+
+extern TwoWire Wire;
+
+#endif  // WIRE_H_
@@ -0,0 +1,328 @@
+#include "Arduino.h"
+
+#include <avr/sleep.h>
+
+#include "sim.h"
+#include "sim_internal.h"
+
+volatile uint8_t  TCCR0A;
+volatile uint8_t  TCCR0B;
+volatile uint8_t  TCCR1A;
+volatile uint8_t  TCCR1B;
+volatile uint8_t  TCCR2A;
+volatile uint8_t  TCCR2B;
+volatile uint16_t TCNT1;
+volatile uint16_t ICR1;
+volatile uint16_t OCR1A;
+volatile uint16_t OCR1B;
+volatile uint8_t  OCR0A;
+volatile uint8_t  TIMSK0;
+volatile uint8_t  ADMUX;
+volatile uint8_t  ADCSRA;
+volatile uint8_t  ADCSRB;
+volatile uint16_t ADC;
+volatile uint8_t  EICRA;
+volatile uint8_t  EIMSK;
+volatile uint8_t  SMCR;
+volatile uint8_t  SREG;
+
+// Defined by firmware, if it uses the interrupt
+extern "C" void TIMER0_COMPA_vect() __attribute__((weak));
+extern "C" void INT0_vect() __attribute__((weak));
+extern "C" void ADC_vect() __attribute__((weak));
+
+namespace
+{
+constexpr uint8_t  kNumOfPins{22};
+constexpr uint32_t kTimer0PeriodUs{1024};  // 16 MHz / 64 (prescaler) / 256 (8-bit counter)
+constexpr uint8_t  kAdtsTimer0Overflow{_BV(ADTS2)};
+constexpr uint64_t kNoEvent{UINT64_MAX};
+
+uint64_t now_us{0};
+uint64_t slept_us{0};
+uint64_t next_timer0_compare_us{kTimer0PeriodUs};
+bool     is_timer0_compare_pending{false};
+bool     is_int0_pending{false};
+uint64_t adc_conversion_end_us{kNoEvent};
+bool     is_adc_pending{false};
+bool     is_in_interrupt{false};
+uint8_t  pin_modes[kNumOfPins];
+uint8_t  digital_outputs[kNumOfPins];
+uint16_t analog_inputs[kNumOfPins];
+uint16_t analog_outputs[kNumOfPins];
+uint32_t string_allocations{0};
+
+void
+HandleInterrupts()
+{
+    // Interrupts are not nested, like on AVR
+    if (is_in_interrupt || !(SREG & _BV(SREG_I))) {
+        return;
+    }
+    is_in_interrupt = true;
+    if (is_timer0_compare_pending) {
+        is_timer0_compare_pending = false;
+        if ((TIMSK0 & _BV(OCIE0A)) && TIMER0_COMPA_vect) {
+            TIMER0_COMPA_vect();
+        }
+    }
+    if (is_int0_pending) {
+        is_int0_pending = false;
+        if ((EIMSK & _BV(INT0)) && INT0_vect) {
+            INT0_vect();
+        }
+    }
+    if (is_adc_pending) {
+        is_adc_pending = false;
+        if ((ADCSRA & _BV(ADIE)) && ADC_vect) {
+            ADC_vect();
+        }
+    }
+    is_in_interrupt = false;
+}
+
+bool
+IsAdcTriggeredByTimer0()
+{
+    constexpr uint8_t kAdtsMask{_BV(ADTS2) | _BV(ADTS1) | _BV(ADTS0)};
+    return (ADCSRA & _BV(ADEN)) && (ADCSRA & _BV(ADATE)) && ((ADCSRB & kAdtsMask) == kAdtsTimer0Overflow);
+}
+
+uint16_t
+ConvertAdcChannel()
+{
+    uint8_t pin = A0 + ((ADMUX >> MUX0) & 0x0F);
+    return (pin < kNumOfPins) ? analog_inputs[pin] : 0;
+}
+}  // namespace
+
+namespace sim
+{
+void
+Reset()
+{
+    now_us                    = 0;
+    slept_us                  = 0;
+    next_timer0_compare_us    = kTimer0PeriodUs;
+    is_timer0_compare_pending = false;
+    is_int0_pending           = false;
+    adc_conversion_end_us     = kNoEvent;
+    is_adc_pending            = false;
+    is_in_interrupt           = false;
+    string_allocations        = 0;
+    TCCR0A                    = 0;
+    TCCR0B                    = 0;
+    TCCR1A                    = 0;
+    TCCR1B                    = 0;
+    TCCR2A                    = 0;
+    TCCR2B                    = 0;
+    TCNT1                     = 0;
+    ICR1                      = 0;
+    OCR1A                     = 0;
+    OCR1B                     = 0;
+    OCR0A                     = 0;
+    TIMSK0                    = 0;
+    ADMUX                     = 0;
+    ADCSRA                    = 0;
+    ADCSRB                    = 0;
+    ADC                       = 0;
+    EICRA                     = 0;
+    EIMSK                     = 0;
+    SMCR                      = 0;
+    SREG                      = _BV(SREG_I);  // Arduino core enables interrupts before setup()
+    internal::ResetPins();
+    internal::ResetSerial();
+    internal::ResetEeprom();
+    internal::ResetOneWire();
+    internal::ResetRtc();
+}
+
+uint64_t
+NowMicros()
+{
+    return now_us;
+}
+
+void
+AdvanceMicros(uint64_t us)
+{
+    // Interrupt, which was raised while interrupts were disabled, is handled as soon as possible
+    HandleInterrupts();
+
+    // Events are processed in order of their time. SQW edge goes first, because the next edge is searched after the
+    // current time, so it would be lost after another event at the same time
+    auto target_us = now_us + us;
+    while (true) {
+        auto sqw_edge_us = internal::GetNextRtcSqwEdge(now_us);
+        if ((adc_conversion_end_us <= target_us) && (adc_conversion_end_us < sqw_edge_us)
+            && (adc_conversion_end_us < next_timer0_compare_us)) {
+            now_us                = adc_conversion_end_us;
+            adc_conversion_end_us = kNoEvent;
+            ADC                   = ConvertAdcChannel();
+            is_adc_pending        = true;
+        }
+        else if ((next_timer0_compare_us <= target_us) && (next_timer0_compare_us < sqw_edge_us)) {
+            now_us = next_timer0_compare_us;
+            next_timer0_compare_us += kTimer0PeriodUs;
+            is_timer0_compare_pending = true;
+            // Timer0 overflow is not simulated separately, it has the same period
+            if (IsAdcTriggeredByTimer0() && (adc_conversion_end_us == kNoEvent)) {
+                adc_conversion_end_us = now_us + kAdcConversionUs;
+            }
+        }
+        else if (sqw_edge_us <= target_us) {
+            now_us          = sqw_edge_us;
+            is_int0_pending = true;
+        }
+        else {
+            break;
+        }
+        HandleInterrupts();
+    }
+    now_us = target_us;
+}
+
+uint64_t
+SleptMicros()
+{
+    return slept_us;
+}
+
+void
+SetAnalogInput(uint8_t pin, uint16_t value)
+{
+    if (pin < kNumOfPins) {
+        analog_inputs[pin] = value & 0x3FF;
+    }
+}
+
+uint16_t
+GetAnalogOutput(uint8_t pin)
+{
+    return (pin < kNumOfPins) ? analog_outputs[pin] : 0;
+}
+
+uint8_t
+GetDigitalOutput(uint8_t pin)
+{
+    return (pin < kNumOfPins) ? digital_outputs[pin] : 0;
+}
+
+uint32_t
+StringAllocations()
+{
+    return string_allocations;
+}
+
+namespace internal
+{
+void
+OnStringAllocation()
+{
+    ++string_allocations;
+}
+
+void
+ResetPins()
+{
+    for (uint8_t i = 0; i < kNumOfPins; ++i) {
+        pin_modes[i]       = INPUT;
+        digital_outputs[i] = LOW;
+        analog_inputs[i]   = 0;
+        analog_outputs[i]  = 0;
+    }
+}
+}  // namespace internal
+}  // namespace sim
+
+void
+sleep_cpu()
+{
+    if (!(SMCR & _BV(SE))) {
+        return;
+    }
+
+    // Pending interrupt wakes MCU up immediately
+    if (is_timer0_compare_pending || is_int0_pending || is_adc_pending) {
+        sim::AdvanceMicros(0);
+        return;
+    }
+
+    auto wake_us = next_timer0_compare_us;
+    if (EIMSK & _BV(INT0)) {
+        wake_us = min(wake_us, sim::internal::GetNextRtcSqwEdge(now_us));
+    }
+    if (ADCSRA & _BV(ADIE)) {
+        wake_us = min(wake_us, adc_conversion_end_us);
+    }
+    slept_us += wake_us - now_us;
+    sim::AdvanceMicros(wake_us - now_us);
+}
+
+void
+pinMode(uint8_t pin, uint8_t mode)
+{
+    if (pin < kNumOfPins) {
+        pin_modes[pin] = mode;
+    }
+}
+
+void
+digitalWrite(uint8_t pin, uint8_t value)
+{
+    if (pin < kNumOfPins) {
+        digital_outputs[pin] = (value == LOW) ? LOW : HIGH;
+    }
+}
+
+int
+digitalRead(uint8_t pin)
+{
+    return (pin < kNumOfPins) ? digital_outputs[pin] : LOW;
+}
+
+int
+analogRead(uint8_t pin)
+{
+    // analogRead() busy-waits until conversion is finished
+    sim::AdvanceMicros(sim::kAnalogReadCostUs);
+    return (pin < kNumOfPins) ? analog_inputs[pin] : 0;
+}
+
+void
+analogWrite(uint8_t pin, int value)
+{
+    if (pin < kNumOfPins) {
+        analog_outputs[pin] = static_cast<uint16_t>(constrain(value, 0, 255));
+    }
+}
+
+uint32_t
+millis()
+{
+    return static_cast<uint32_t>(now_us / 1000);
+}
+
+uint32_t
+micros()
+{
+    return static_cast<uint32_t>(now_us);
+}
+
+void
+delay(uint32_t ms)
+{
+    sim::AdvanceMicros(static_cast<uint64_t>(ms) * 1000);
+}
+
+void
+delayMicroseconds(unsigned int us)
+{
+    sim::AdvanceMicros(us);
+}
+
+long
+map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
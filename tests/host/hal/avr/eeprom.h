@@ -0,0 +1,23 @@
+#ifndef AVR_EEPROM_H_
+#define AVR_EEPROM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Variables marked with EEMEM are collected in a separate section. Their addresses are translated to offsets inside
+// simulated 1 KB EEPROM, so both EEMEM variables and raw integer addresses can be used, like on AVR.
+#define EEMEM __attribute__((section("sim_eeprom")))
+
+uint8_t  eeprom_read_byte(const uint8_t* address);
+uint16_t eeprom_read_word(const uint16_t* address);
+uint32_t eeprom_read_dword(const uint32_t* address);
+void     eeprom_read_block(void* dst, const void* src, size_t size);
+void     eeprom_write_byte(uint8_t* address, uint8_t value);
+void     eeprom_write_word(uint16_t* address, uint16_t value);
+void     eeprom_write_dword(uint32_t* address, uint32_t value);
+void     eeprom_write_block(const void* src, void* dst, size_t size);
+void     eeprom_update_byte(uint8_t* address, uint8_t value);
+void     eeprom_update_word(uint16_t* address, uint16_t value);
+void     eeprom_update_block(const void* src, void* dst, size_t size);
+
+#endif  // AVR_EEPROM_H_
@@ -0,0 +1,14 @@
+#ifndef AVR_INTERRUPT_H_
+#define AVR_INTERRUPT_H_
+
+#include "io.h"
+
+// Interrupt handlers are plain functions, which simulated clock calls when interrupt condition occurs and
+// interrupts are enabled. Interrupt, which occurs while interrupts are disabled, is called on the next advance of
+// simulated clock after they are enabled again.
+#define ISR(vector) extern "C" void vector()
+
+#define sei() (SREG |= _BV(SREG_I))
+#define cli() (SREG &= static_cast<uint8_t>(~_BV(SREG_I)))
+
+#endif  // AVR_INTERRUPT_H_
@@ -0,0 +1,76 @@
+#ifndef AVR_IO_H_
+#define AVR_IO_H_
+
+#include <stdint.h>
+
+// Timer registers of ATmega328P. They are plain variables, so firmware can configure them and tests can inspect
+// the result.
+extern volatile uint8_t TCCR0A;
+extern volatile uint8_t TCCR0B;
+extern volatile uint8_t TCCR1A;
+extern volatile uint8_t TCCR1B;
+extern volatile uint8_t TCCR2A;
+extern volatile uint8_t TCCR2B;
+
+// Timer1 16-bit registers
+extern volatile uint16_t TCNT1;
+extern volatile uint16_t ICR1;
+extern volatile uint16_t OCR1A;
+extern volatile uint16_t OCR1B;
+#define WGM10  0  // TCCR1A
+#define WGM11  1
+#define COM1B1 5
+#define COM1A1 7
+#define CS10   0  // TCCR1B
+#define WGM12  3
+#define WGM13  4
+
+// Timer0 compare match A interrupt. Timer0 is also used by millis(), so only its interrupt mask is simulated:
+// when OCIE0A is set, TIMER0_COMPA_vect is called once per Timer0 period (1024 us).
+extern volatile uint8_t OCR0A;
+extern volatile uint8_t TIMSK0;
+#define OCIE0A 1
+
+// External interrupt 0 (pin 2). DS1307 SQW output is wired to it: when INT0 is set in EIMSK and SQW output is
+// enabled, INT0_vect is called on each falling edge of SQW. Sense control in EICRA is not simulated.
+extern volatile uint8_t EICRA;
+extern volatile uint8_t EIMSK;
+#define ISC00 0  // EICRA
+#define ISC01 1
+#define INT0  0  // EIMSK
+
+// ADC. Only auto triggering by Timer0 overflow is simulated: when ADEN, ADATE and ADIE are set and ADTS selects Timer0
+// overflow, conversion of the channel selected by MUX bits of ADMUX starts once per Timer0 period, and ADC_vect is
+// called sim::kAdcConversionUs later with the result in ADC. Reference and prescaler bits are not simulated.
+extern volatile uint8_t  ADMUX;
+extern volatile uint8_t  ADCSRA;
+extern volatile uint8_t  ADCSRB;
+extern volatile uint16_t ADC;
+#define MUX0  0  // ADMUX
+#define REFS0 6
+#define ADPS0 0  // ADCSRA
+#define ADPS1 1
+#define ADPS2 2
+#define ADIE  3
+#define ADIF  4
+#define ADATE 5
+#define ADSC  6
+#define ADEN  7
+#define ADTS0 0  // ADCSRB
+#define ADTS1 1
+#define ADTS2 2
+
+// Sleep mode control register, see avr/sleep.h
+extern volatile uint8_t SMCR;
+#define SE  0
+#define SM0 1
+#define SM1 2
+#define SM2 3
+
+// Status register. Only global interrupt enable bit (I) is simulated, see avr/interrupt.h
+extern volatile uint8_t SREG;
+#define SREG_I 7
+
+#define _BV(bit) (1 << (bit))
+
+#endif  // AVR_IO_H_
@@ -0,0 +1,24 @@
+#ifndef AVR_PGMSPACE_H_
+#define AVR_PGMSPACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Host has single address space, so program memory is regular memory
+
+#define PROGMEM
+#define PGM_P         const char*
+#define PSTR(s)       (s)
+#define pgm_read_byte(addr)  (*reinterpret_cast<const uint8_t*>(addr))
+#define pgm_read_word(addr)  (*reinterpret_cast<const uint16_t*>(addr))
+#define pgm_read_dword(addr) (*reinterpret_cast<const uint32_t*>(addr))
+#define memcpy_P   memcpy
+#define memcmp_P   memcmp
+#define strlen_P   strlen
+#define strcmp_P   strcmp
+#define strncmp_P  strncmp
+#define strcpy_P   strcpy
+#define snprintf_P snprintf
+
+#endif  // AVR_PGMSPACE_H_
@@ -0,0 +1,17 @@
+#ifndef AVR_SLEEP_H_
+#define AVR_SLEEP_H_
+
+#include "io.h"
+
+// Only idle mode is simulated: sleep_cpu() advances simulated clock to the next interrupt, which wakes MCU up
+// (Timer0 overflow, that Arduino core uses for millis(), or enabled INT0). Time spent in sleep is reported by
+// sim::SleptMicros().
+#define SLEEP_MODE_IDLE 0
+
+#define set_sleep_mode(mode) (SMCR = (SMCR & static_cast<uint8_t>(~(_BV(SM0) | _BV(SM1) | _BV(SM2)))) | (mode))
+#define sleep_enable()       (SMCR |= _BV(SE))
+#define sleep_disable()      (SMCR &= static_cast<uint8_t>(~_BV(SE)))
+
+void sleep_cpu();
+
+#endif  // AVR_SLEEP_H_
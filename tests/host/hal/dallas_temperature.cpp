@@ -0,0 +1,193 @@
+#include "DallasTemperature.h"
+
+namespace
+{
+constexpr uint8_t kConvertT{0x44};
+constexpr uint8_t kReadScratchpad{0xBE};
+constexpr uint8_t kWriteScratchpad{0x4E};
+
+constexpr uint8_t kTemperatureLsb{0};
+constexpr uint8_t kTemperatureMsb{1};
+constexpr uint8_t kHighAlarmTemp{2};
+constexpr uint8_t kLowAlarmTemp{3};
+constexpr uint8_t kConfiguration{4};
+constexpr uint8_t kScratchpadCrc{8};
+
+bool
+IsAllZeros(const uint8_t* scratchpad)
+{
+    for (uint8_t i = 0; i < 9; ++i) {
+        if (scratchpad[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+}  // namespace
+
+DallasTemperature::DallasTemperature(OneWire* one_wire)
+{
+    setOneWire(one_wire);
+}
+
+void
+DallasTemperature::setOneWire(OneWire* one_wire)
+{
+    one_wire_ = one_wire;
+    devices_  = 0;
+}
+
+void
+DallasTemperature::begin()
+{
+    DeviceAddress address;
+    devices_ = 0;
+    one_wire_->reset_search();
+    while (one_wire_->search(address)) {
+        ScratchPad scratchpad;
+        if (isConnected(address, scratchpad)) {
+            uint8_t resolution = 9 + ((scratchpad[kConfiguration] >> 5) & 0x03);
+            if (resolution > bit_resolution_) {
+                bit_resolution_ = resolution;
+            }
+        }
+        ++devices_;
+    }
+}
+
+uint8_t
+DallasTemperature::getDeviceCount()
+{
+    return devices_;
+}
+
+bool
+DallasTemperature::getAddress(uint8_t* address, uint8_t index)
+{
+    uint8_t depth{0};
+    one_wire_->reset_search();
+    while ((depth <= index) && one_wire_->search(address)) {
+        if ((depth == index) && (OneWire::crc8(address, 7) == address[7])) {
+            return true;
+        }
+        ++depth;
+    }
+    return false;
+}
+
+bool
+DallasTemperature::isConnected(const uint8_t* address, uint8_t* scratchpad)
+{
+    bool result = ReadScratchPad(address, scratchpad);
+    return result && !IsAllZeros(scratchpad) && (OneWire::crc8(scratchpad, 8) == scratchpad[kScratchpadCrc]);
+}
+
+void
+DallasTemperature::setResolution(uint8_t resolution)
+{
+    bit_resolution_ = (resolution < 9) ? 9 : ((resolution > 12) ? 12 : resolution);
+    DeviceAddress address;
+    for (uint8_t i = 0; i < devices_; ++i) {
+        if (getAddress(address, i)) {
+            setResolution(address, bit_resolution_, true);
+        }
+    }
+}
+
+bool
+DallasTemperature::setResolution(const uint8_t* address, uint8_t resolution, bool skip_global_bit_resolution_calculation)
+{
+    resolution = (resolution < 9) ? 9 : ((resolution > 12) ? 12 : resolution);
+    ScratchPad scratchpad;
+    if (!isConnected(address, scratchpad)) {
+        return false;
+    }
+    scratchpad[kConfiguration] = static_cast<uint8_t>(((resolution - 9) << 5) | 0x1F);
+    WriteScratchPad(address, scratchpad);
+    if (!skip_global_bit_resolution_calculation && (resolution > bit_resolution_)) {
+        bit_resolution_ = resolution;
+    }
+    return true;
+}
+
+uint8_t
+DallasTemperature::getResolution(const uint8_t* address)
+{
+    ScratchPad scratchpad;
+    if (!isConnected(address, scratchpad)) {
+        return 0;
+    }
+    return 9 + ((scratchpad[kConfiguration] >> 5) & 0x03);
+}
+
+void
+DallasTemperature::setWaitForConversion(bool wait)
+{
+    wait_for_conversion_ = wait;
+}
+
+void
+DallasTemperature::requestTemperatures()
+{
+    one_wire_->reset();
+    one_wire_->skip();
+    one_wire_->write(kConvertT, 0);
+
+    if (wait_for_conversion_) {
+        while (!isConversionComplete()) {
+        }
+    }
+}
+
+bool
+DallasTemperature::isConversionComplete()
+{
+    return one_wire_->read_bit() == 1;
+}
+
+int16_t
+DallasTemperature::getTemp(const uint8_t* address)
+{
+    ScratchPad scratchpad;
+    if (!isConnected(address, scratchpad)) {
+        return DEVICE_DISCONNECTED_RAW;
+    }
+    int16_t raw = static_cast<int16_t>((scratchpad[kTemperatureMsb] << 8) | scratchpad[kTemperatureLsb]);
+    return static_cast<int16_t>(raw << 3);
+}
+
+float
+DallasTemperature::getTempC(const uint8_t* address)
+{
+    int16_t raw = getTemp(address);
+    if (raw <= DEVICE_DISCONNECTED_RAW) {
+        return DEVICE_DISCONNECTED_C;
+    }
+    return static_cast<float>(raw) * 0.0078125f;
+}
+
+bool
+DallasTemperature::ReadScratchPad(const uint8_t* address, uint8_t* scratchpad)
+{
+    if (one_wire_->reset() == 0) {
+        return false;
+    }
+    one_wire_->select(address);
+    one_wire_->write(kReadScratchpad);
+    for (uint8_t i = 0; i < 9; ++i) {
+        scratchpad[i] = one_wire_->read();
+    }
+    return one_wire_->reset() == 1;
+}
+
+void
+DallasTemperature::WriteScratchPad(const uint8_t* address, const uint8_t* scratchpad)
+{
+    one_wire_->reset();
+    one_wire_->select(address);
+    one_wire_->write(kWriteScratchpad);
+    one_wire_->write(scratchpad[kHighAlarmTemp]);
+    one_wire_->write(scratchpad[kLowAlarmTemp]);
+    one_wire_->write(scratchpad[kConfiguration]);
+    one_wire_->reset();
+}
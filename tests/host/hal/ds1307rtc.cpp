@@ -0,0 +1,95 @@
+#include "DS1307RTC.h"
+
+#include "sim.h"
+#include "sim_internal.h"
+
+DS1307RTC RTC;
+
+namespace
+{
+constexpr uint8_t kSqwEnableBit{4};  // SQWE bit of control register. RS bits are 0, so frequency is 1 Hz
+
+time_t   rtc_base_time{0};
+uint64_t rtc_base_us{0};
+uint8_t  rtc_control{0};
+}  // namespace
+
+namespace sim
+{
+void
+SetRtcTime(time_t time)
+{
+    rtc_base_time = time;
+    rtc_base_us   = NowMicros();
+}
+
+time_t
+GetRtcTime()
+{
+    return rtc_base_time + static_cast<time_t>((NowMicros() - rtc_base_us) / 1000000);
+}
+
+namespace internal
+{
+void
+ResetRtc()
+{
+    rtc_base_time = 0;
+    rtc_base_us   = 0;
+    rtc_control   = 0;
+}
+
+uint64_t
+GetNextRtcSqwEdge(uint64_t after_us)
+{
+    if (!(rtc_control & (1 << kSqwEnableBit))) {
+        return UINT64_MAX;
+    }
+    // Falling edge of SQW is the moment when seconds counter is incremented
+    return rtc_base_us + ((after_us - rtc_base_us) / 1000000 + 1) * 1000000;
+}
+
+void
+SetRtcControl(uint8_t control)
+{
+    rtc_control = control;
+}
+}  // namespace internal
+}  // namespace sim
+
+time_t
+DS1307RTC::get()
+{
+    sim::AdvanceMicros(sim::kRtcTransactionCostUs);
+    return sim::GetRtcTime();
+}
+
+bool
+DS1307RTC::set(time_t t)
+{
+    sim::AdvanceMicros(sim::kRtcTransactionCostUs);
+    sim::SetRtcTime(t);
+    return true;
+}
+
+bool
+DS1307RTC::read(tmElements_t& tm)
+{
+    sim::AdvanceMicros(sim::kRtcTransactionCostUs);
+    breakTime(sim::GetRtcTime(), tm);
+    return true;
+}
+
+bool
+DS1307RTC::write(tmElements_t& tm)
+{
+    sim::AdvanceMicros(sim::kRtcTransactionCostUs);
+    sim::SetRtcTime(makeTime(tm));
+    return true;
+}
+
+bool
+DS1307RTC::chipPresent()
+{
+    return true;
+}
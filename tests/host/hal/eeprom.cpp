@@ -0,0 +1,155 @@
+#include <EEPROM.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sim.h"
+#include "sim_internal.h"
+
+EEPROMClass EEPROM;
+
+// Linker provides these symbols for every section, which name is a valid C identifier
+extern "C" uint8_t __start_sim_eeprom[];
+extern "C" uint8_t __stop_sim_eeprom[];
+
+// Guarantees that section exists even if firmware does not declare any EEMEM variable
+uint8_t EEMEM sim_eeprom_section_anchor;
+
+namespace
+{
+uint8_t  eeprom[sim::kEepromSize];
+uint32_t write_count{0};
+
+uint16_t
+ToOffset(const void* address)
+{
+    auto value = reinterpret_cast<uintptr_t>(address);
+    auto begin = reinterpret_cast<uintptr_t>(__start_sim_eeprom);
+    auto end   = reinterpret_cast<uintptr_t>(__stop_sim_eeprom);
+    if ((begin <= value) && (value < end)) {
+        value -= begin;
+    }
+    return static_cast<uint16_t>(value % sim::kEepromSize);
+}
+
+uint8_t
+ReadByte(const void* address, size_t index)
+{
+    return eeprom[(ToOffset(address) + index) % sim::kEepromSize];
+}
+
+void
+WriteByte(void* address, size_t index, uint8_t value)
+{
+    eeprom[(ToOffset(address) + index) % sim::kEepromSize] = value;
+    ++write_count;
+}
+}  // namespace
+
+namespace sim
+{
+uint8_t
+EepromRead(uint16_t address)
+{
+    return eeprom[address % kEepromSize];
+}
+
+uint32_t
+EepromWriteCount()
+{
+    return write_count;
+}
+
+namespace internal
+{
+void
+ResetEeprom()
+{
+    memset(eeprom, 0xFF, sizeof(eeprom));
+    write_count = 0;
+}
+}  // namespace internal
+}  // namespace sim
+
+uint8_t
+eeprom_read_byte(const uint8_t* address)
+{
+    return ReadByte(address, 0);
+}
+
+uint16_t
+eeprom_read_word(const uint16_t* address)
+{
+    uint16_t value;
+    eeprom_read_block(&value, address, sizeof(value));
+    return value;
+}
+
+uint32_t
+eeprom_read_dword(const uint32_t* address)
+{
+    uint32_t value;
+    eeprom_read_block(&value, address, sizeof(value));
+    return value;
+}
+
+void
+eeprom_read_block(void* dst, const void* src, size_t size)
+{
+    auto out = static_cast<uint8_t*>(dst);
+    for (size_t i = 0; i < size; ++i) {
+        out[i] = ReadByte(src, i);
+    }
+}
+
+void
+eeprom_write_byte(uint8_t* address, uint8_t value)
+{
+    WriteByte(address, 0, value);
+}
+
+void
+eeprom_write_word(uint16_t* address, uint16_t value)
+{
+    eeprom_write_block(&value, address, sizeof(value));
+}
+
+void
+eeprom_write_dword(uint32_t* address, uint32_t value)
+{
+    eeprom_write_block(&value, address, sizeof(value));
+}
+
+void
+eeprom_write_block(const void* src, void* dst, size_t size)
+{
+    auto in = static_cast<const uint8_t*>(src);
+    for (size_t i = 0; i < size; ++i) {
+        WriteByte(dst, i, in[i]);
+    }
+}
+
+void
+eeprom_update_byte(uint8_t* address, uint8_t value)
+{
+    if (ReadByte(address, 0) != value) {
+        WriteByte(address, 0, value);
+    }
+}
+
+void
+eeprom_update_word(uint16_t* address, uint16_t value)
+{
+    eeprom_update_block(&value, address, sizeof(value));
+}
+
+void
+eeprom_update_block(const void* src, void* dst, size_t size)
+{
+    auto in = static_cast<const uint8_t*>(src);
+    for (size_t i = 0; i < size; ++i) {
+        if (ReadByte(dst, i) != in[i]) {
+            WriteByte(dst, i, in[i]);
+        }
+    }
+}
@@ -0,0 +1,167 @@
+#include "HardwareSerial.h"
+
+#include <deque>
+#include <string>
+
+#include "sim.h"
+#include "sim_internal.h"
+
+HardwareSerial Serial;
+
+namespace
+{
+struct PendingByte
+{
+    uint64_t arrival_time_us;
+    uint8_t  value;
+};
+
+uint32_t                byte_time_us{1042};  // 10 bits per byte at 9600 baud
+std::deque<PendingByte> pending_rx;          // Bytes which are still "on the wire"
+std::deque<uint8_t>     rx_buffer;           // Bytes received by USART ISR, but not read by firmware yet
+uint32_t                rx_overflows{0};
+uint64_t                tx_busy_until_us{0};  // Time when last byte from TX buffer will be sent
+std::string             tx_output;
+
+// Emulates USART RX ISR, which runs for every received byte. Doing it lazily is exact, because RX buffer can only
+// become emptier when firmware reads from it, and firmware always calls this function before reading.
+void
+PumpRx()
+{
+    auto now = sim::NowMicros();
+    while (!pending_rx.empty() && (pending_rx.front().arrival_time_us <= now)) {
+        if (rx_buffer.size() < (SERIAL_RX_BUFFER_SIZE - 1)) {
+            rx_buffer.push_back(pending_rx.front().value);
+        }
+        else {
+            ++rx_overflows;
+        }
+        pending_rx.pop_front();
+    }
+}
+
+uint32_t
+TxBytesQueued()
+{
+    auto now = sim::NowMicros();
+    if (tx_busy_until_us <= now) {
+        return 0;
+    }
+    return static_cast<uint32_t>((tx_busy_until_us - now + byte_time_us - 1) / byte_time_us);
+}
+}  // namespace
+
+namespace sim
+{
+void
+SerialInject(const std::string& data)
+{
+    PumpRx();
+    uint64_t arrival_time = NowMicros();
+    if (!pending_rx.empty() && (pending_rx.back().arrival_time_us > arrival_time)) {
+        arrival_time = pending_rx.back().arrival_time_us;
+    }
+    for (char ch : data) {
+        arrival_time += byte_time_us;
+        pending_rx.push_back(PendingByte{arrival_time, static_cast<uint8_t>(ch)});
+    }
+}
+
+std::string
+SerialTakeOutput()
+{
+    std::string result;
+    result.swap(tx_output);
+    return result;
+}
+
+uint32_t
+SerialRxOverflows()
+{
+    PumpRx();
+    return rx_overflows;
+}
+
+namespace internal
+{
+void
+ResetSerial()
+{
+    byte_time_us = 1042;
+    pending_rx.clear();
+    rx_buffer.clear();
+    rx_overflows     = 0;
+    tx_busy_until_us = 0;
+    tx_output.clear();
+}
+}  // namespace internal
+}  // namespace sim
+
+void
+HardwareSerial::begin(unsigned long baud)
+{
+    byte_time_us = static_cast<uint32_t>((10 * 1000000UL + baud / 2) / baud);
+}
+
+void
+HardwareSerial::end()
+{
+    flush();
+}
+
+int
+HardwareSerial::available()
+{
+    PumpRx();
+    return static_cast<int>(rx_buffer.size());
+}
+
+int
+HardwareSerial::availableForWrite()
+{
+    auto queued = TxBytesQueued();
+    return (queued >= SERIAL_TX_BUFFER_SIZE - 1) ? 0 : static_cast<int>(SERIAL_TX_BUFFER_SIZE - 1 - queued);
+}
+
+int
+HardwareSerial::read()
+{
+    PumpRx();
+    if (rx_buffer.empty()) {
+        return -1;
+    }
+    uint8_t value = rx_buffer.front();
+    rx_buffer.pop_front();
+    return value;
+}
+
+int
+HardwareSerial::peek()
+{
+    PumpRx();
+    return rx_buffer.empty() ? -1 : rx_buffer.front();
+}
+
+void
+HardwareSerial::flush()
+{
+    auto now = sim::NowMicros();
+    if (tx_busy_until_us > now) {
+        sim::AdvanceMicros(tx_busy_until_us - now);
+    }
+}
+
+size_t
+HardwareSerial::write(uint8_t c)
+{
+    // When TX buffer is full, write() blocks until USART sends one more byte
+    if (TxBytesQueued() >= SERIAL_TX_BUFFER_SIZE - 1) {
+        auto free_slot_time = tx_busy_until_us - static_cast<uint64_t>(SERIAL_TX_BUFFER_SIZE - 2) * byte_time_us;
+        sim::AdvanceMicros(free_slot_time - sim::NowMicros());
+    }
+
+    auto now         = sim::NowMicros();
+    tx_busy_until_us = ((tx_busy_until_us > now) ? tx_busy_until_us : now) + byte_time_us;
+    tx_output.push_back(static_cast<char>(c));
+    return 1;
+}
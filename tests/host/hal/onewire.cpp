@@ -0,0 +1,398 @@
+#include "OneWire.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <vector>
+
+#include "sim.h"
+#include "sim_internal.h"
+
+namespace
+{
+// DS18B20 commands
+constexpr uint8_t kSearchRom{0xF0};
+constexpr uint8_t kMatchRom{0x55};
+constexpr uint8_t kSkipRom{0xCC};
+constexpr uint8_t kConvertT{0x44};
+constexpr uint8_t kReadScratchpad{0xBE};
+constexpr uint8_t kWriteScratchpad{0x4E};
+constexpr uint8_t kCopyScratchpad{0x48};
+constexpr uint8_t kReadPowerSupply{0xB4};
+
+constexpr uint32_t kMaxConversionTimeUs{750000};
+
+struct Ds18b20
+{
+    uint8_t  pin;
+    uint8_t  rom[8];
+    float    temperature;
+    uint8_t  scratchpad[9];
+    bool     selected;
+    bool     converting;
+    uint64_t conversion_end_us;
+};
+
+enum class BusState : uint8_t
+{
+    kIdle,          // Nothing to do until next reset
+    kRomCommand,    // Reset was made. Waiting for ROM command
+    kMatchRom,      // Receiving 8 bytes of ROM code
+    kFunction,      // Waiting for function command
+    kWriteScratchpad,
+    kReadScratchpad,
+    kConverting,  // Read slots return 0 while conversion is in progress
+    kReadPowerSupply
+};
+
+struct Bus
+{
+    uint8_t  pin;
+    BusState state;
+    uint8_t  byte_index;
+    uint8_t  match_rom[8];
+};
+
+std::vector<Ds18b20> devices;
+std::vector<Bus>     buses;
+
+Bus&
+GetBus(uint8_t pin)
+{
+    for (auto& bus : buses) {
+        if (bus.pin == pin) {
+            return bus;
+        }
+    }
+    buses.push_back(Bus{pin, BusState::kIdle, 0, {}});
+    return buses.back();
+}
+
+uint8_t
+ResolutionOf(const Ds18b20& device)
+{
+    return 9 + ((device.scratchpad[4] >> 5) & 0x03);
+}
+
+void
+UpdateScratchpadCrc(Ds18b20& device)
+{
+    device.scratchpad[8] = OneWire::crc8(device.scratchpad, 8);
+}
+
+void
+FinishConversionIfReady(Ds18b20& device)
+{
+    if (!device.converting || (sim::NowMicros() < device.conversion_end_us)) {
+        return;
+    }
+    device.converting = false;
+
+    auto raw = static_cast<int16_t>(lround(device.temperature * 16.0f));
+    // Undefined low bits are zero for lower resolutions
+    raw &= static_cast<int16_t>(0xFFFF << (12 - ResolutionOf(device)));
+    device.scratchpad[0] = static_cast<uint8_t>(raw & 0xFF);
+    device.scratchpad[1] = static_cast<uint8_t>((raw >> 8) & 0xFF);
+    UpdateScratchpadCrc(device);
+}
+
+Ds18b20*
+FindDevice(const uint8_t (&rom)[8])
+{
+    for (auto& device : devices) {
+        if (memcmp(device.rom, rom, 8) == 0) {
+            return &device;
+        }
+    }
+    return nullptr;
+}
+
+void
+SpendSlots(uint32_t slots)
+{
+    sim::AdvanceMicros(static_cast<uint64_t>(slots) * sim::kOneWireSlotCostUs);
+}
+}  // namespace
+
+namespace sim
+{
+void
+AddDs18b20(uint8_t pin, const uint8_t (&rom)[8], float temperature)
+{
+    Ds18b20 device{};
+    device.pin = pin;
+    memcpy(device.rom, rom, 8);
+    device.temperature = temperature;
+    // Power-on state: 85 degrees, 12 bit resolution
+    const uint8_t power_on_scratchpad[8] = {0x50, 0x05, 0x4B, 0x46, 0x7F, 0xFF, 0x0C, 0x10};
+    memcpy(device.scratchpad, power_on_scratchpad, 8);
+    UpdateScratchpadCrc(device);
+    devices.push_back(device);
+}
+
+void
+SetDs18b20Temperature(const uint8_t (&rom)[8], float temperature)
+{
+    auto device = FindDevice(rom);
+    if (device != nullptr) {
+        device->temperature = temperature;
+    }
+}
+
+namespace internal
+{
+void
+ResetOneWire()
+{
+    devices.clear();
+    buses.clear();
+}
+}  // namespace internal
+}  // namespace sim
+
+OneWire::OneWire(uint8_t pin)
+{
+    begin(pin);
+}
+
+void
+OneWire::begin(uint8_t pin)
+{
+    pin_ = pin;
+    reset_search();
+}
+
+uint8_t
+OneWire::reset()
+{
+    sim::AdvanceMicros(sim::kOneWireResetCostUs);
+
+    auto& bus = GetBus(pin_);
+    bus.state = BusState::kRomCommand;
+    bool present{false};
+    for (auto& device : devices) {
+        if (device.pin == pin_) {
+            device.selected = false;
+            present         = true;
+        }
+    }
+    return present ? 1 : 0;
+}
+
+void
+OneWire::select(const uint8_t rom[8])
+{
+    write(kMatchRom);
+    for (uint8_t i = 0; i < 8; ++i) {
+        write(rom[i]);
+    }
+}
+
+void
+OneWire::skip()
+{
+    write(kSkipRom);
+}
+
+void
+OneWire::write(uint8_t value, uint8_t /*power*/)
+{
+    SpendSlots(8);
+
+    auto& bus = GetBus(pin_);
+    switch (bus.state) {
+    case BusState::kRomCommand:
+        if (value == kSkipRom) {
+            for (auto& device : devices) {
+                device.selected = (device.pin == pin_);
+            }
+            bus.state = BusState::kFunction;
+        }
+        else if (value == kMatchRom) {
+            bus.byte_index = 0;
+            bus.state      = BusState::kMatchRom;
+        }
+        else {
+            bus.state = BusState::kIdle;
+        }
+        break;
+    case BusState::kMatchRom:
+        bus.match_rom[bus.byte_index++] = value;
+        if (bus.byte_index == 8) {
+            for (auto& device : devices) {
+                device.selected = (device.pin == pin_) && (memcmp(device.rom, bus.match_rom, 8) == 0);
+            }
+            bus.state = BusState::kFunction;
+        }
+        break;
+    case BusState::kFunction:
+        bus.byte_index = 0;
+        switch (value) {
+        case kConvertT:
+            for (auto& device : devices) {
+                if (device.selected) {
+                    FinishConversionIfReady(device);
+                    device.converting        = true;
+                    device.conversion_end_us = sim::NowMicros() + (kMaxConversionTimeUs >> (12 - ResolutionOf(device)));
+                }
+            }
+            bus.state = BusState::kConverting;
+            break;
+        case kReadScratchpad:
+            bus.state = BusState::kReadScratchpad;
+            break;
+        case kWriteScratchpad:
+            bus.state = BusState::kWriteScratchpad;
+            break;
+        case kReadPowerSupply:
+            bus.state = BusState::kReadPowerSupply;
+            break;
+        case kCopyScratchpad:
+        default:
+            bus.state = BusState::kIdle;
+            break;
+        }
+        break;
+    case BusState::kWriteScratchpad:
+        // TH, TL and configuration register
+        for (auto& device : devices) {
+            if (device.selected) {
+                device.scratchpad[2 + bus.byte_index] = (bus.byte_index == 2) ? ((value & 0x60) | 0x1F) : value;
+                UpdateScratchpadCrc(device);
+            }
+        }
+        if (++bus.byte_index == 3) {
+            bus.state = BusState::kIdle;
+        }
+        break;
+    default:
+        bus.state = BusState::kIdle;
+        break;
+    }
+}
+
+void
+OneWire::write_bytes(const uint8_t* buffer, uint16_t count, bool power)
+{
+    for (uint16_t i = 0; i < count; ++i) {
+        write(buffer[i], power);
+    }
+}
+
+uint8_t
+OneWire::read()
+{
+    SpendSlots(8);
+
+    auto& bus = GetBus(pin_);
+    switch (bus.state) {
+    case BusState::kReadScratchpad: {
+        if (bus.byte_index >= 9) {
+            return 0xFF;
+        }
+        // Open drain bus: if several devices talk at the same time, result is wired AND
+        uint8_t result{0xFF};
+        for (auto& device : devices) {
+            if (device.selected) {
+                FinishConversionIfReady(device);
+                result &= device.scratchpad[bus.byte_index];
+            }
+        }
+        ++bus.byte_index;
+        return result;
+    }
+    case BusState::kConverting:
+        for (auto& device : devices) {
+            if (device.selected) {
+                FinishConversionIfReady(device);
+                if (device.converting) {
+                    return 0x00;
+                }
+            }
+        }
+        return 0xFF;
+    case BusState::kReadPowerSupply:
+        return 0xFF;  // All sensors are externally powered
+    default:
+        return 0xFF;
+    }
+}
+
+void
+OneWire::read_bytes(uint8_t* buffer, uint16_t count)
+{
+    for (uint16_t i = 0; i < count; ++i) {
+        buffer[i] = read();
+    }
+}
+
+uint8_t
+OneWire::read_bit()
+{
+    SpendSlots(1);
+
+    auto& bus = GetBus(pin_);
+    if (bus.state == BusState::kConverting) {
+        for (auto& device : devices) {
+            if (device.selected) {
+                FinishConversionIfReady(device);
+                if (device.converting) {
+                    return 0;
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+void
+OneWire::depower()
+{
+}
+
+void
+OneWire::reset_search()
+{
+    search_index_ = 0;
+}
+
+bool
+OneWire::search(uint8_t* new_address, bool /*search_mode*/)
+{
+    // Devices are returned in order they were added to the bus. Timing is the same as for real search: reset,
+    // command byte and 64 triplets of bit slots.
+    uint8_t index{0};
+    for (auto& device : devices) {
+        if (device.pin != pin_) {
+            continue;
+        }
+        if (index++ == search_index_) {
+            reset();
+            write(kSearchRom);
+            SpendSlots(64 * 3);
+            GetBus(pin_).state = BusState::kIdle;
+            memcpy(new_address, device.rom, 8);
+            ++search_index_;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint8_t
+OneWire::crc8(const uint8_t* address, uint8_t length)
+{
+    uint8_t crc{0};
+    while (length--) {
+        uint8_t in_byte = *address++;
+        for (uint8_t i = 8; i; i--) {
+            uint8_t mix = (crc ^ in_byte) & 0x01;
+            crc >>= 1;
+            if (mix) {
+                crc ^= 0x8C;
+            }
+            in_byte >>= 1;
+        }
+    }
+    return crc;
+}
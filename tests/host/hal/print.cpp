@@ -0,0 +1,180 @@
+#include "Print.h"
+
+#include <stdio.h>
+#include <string.h>
+
+size_t
+Print::write(const uint8_t* buffer, size_t size)
+{
+    size_t n = 0;
+    while (size-- > 0) {
+        n += write(*buffer++);
+    }
+    return n;
+}
+
+size_t
+Print::write(const char* str)
+{
+    return (str == nullptr) ? 0 : write(reinterpret_cast<const uint8_t*>(str), strlen(str));
+}
+
+size_t
+Print::write(const char* buffer, size_t size)
+{
+    return write(reinterpret_cast<const uint8_t*>(buffer), size);
+}
+
+size_t
+Print::print(const __FlashStringHelper* str)
+{
+    return write(reinterpret_cast<const char*>(str));
+}
+
+size_t
+Print::print(const String& str)
+{
+    return write(str.c_str(), str.length());
+}
+
+size_t
+Print::print(const char str[])
+{
+    return write(str);
+}
+
+size_t
+Print::print(char c)
+{
+    return write(static_cast<uint8_t>(c));
+}
+
+size_t
+Print::print(unsigned char value, int base)
+{
+    return print(static_cast<unsigned long>(value), base);
+}
+
+size_t
+Print::print(int value, int base)
+{
+    return print(static_cast<long>(value), base);
+}
+
+size_t
+Print::print(unsigned int value, int base)
+{
+    return print(static_cast<unsigned long>(value), base);
+}
+
+size_t
+Print::print(long value, int base)
+{
+    if (base == 0) {
+        return write(static_cast<uint8_t>(value));
+    }
+    if ((base == DEC) && (value < 0)) {
+        return print('-') + PrintNumber(-static_cast<unsigned long>(value), DEC);
+    }
+    return PrintNumber(static_cast<unsigned long>(value), base);
+}
+
+size_t
+Print::print(unsigned long value, int base)
+{
+    if (base == 0) {
+        return write(static_cast<uint8_t>(value));
+    }
+    return PrintNumber(value, base);
+}
+
+size_t
+Print::print(double value, int digits)
+{
+    char buf[40];
+    snprintf(buf, sizeof(buf), "%.*f", digits, value);
+    return write(buf);
+}
+
+size_t
+Print::println(const __FlashStringHelper* str)
+{
+    return print(str) + println();
+}
+
+size_t
+Print::println(const String& str)
+{
+    return print(str) + println();
+}
+
+size_t
+Print::println(const char str[])
+{
+    return print(str) + println();
+}
+
+size_t
+Print::println(char c)
+{
+    return print(c) + println();
+}
+
+size_t
+Print::println(unsigned char value, int base)
+{
+    return print(value, base) + println();
+}
+
+size_t
+Print::println(int value, int base)
+{
+    return print(value, base) + println();
+}
+
+size_t
+Print::println(unsigned int value, int base)
+{
+    return print(value, base) + println();
+}
+
+size_t
+Print::println(long value, int base)
+{
+    return print(value, base) + println();
+}
+
+size_t
+Print::println(unsigned long value, int base)
+{
+    return print(value, base) + println();
+}
+
+size_t
+Print::println(double value, int digits)
+{
+    return print(value, digits) + println();
+}
+
+size_t
+Print::println()
+{
+    return write("\r\n");
+}
+
+size_t
+Print::PrintNumber(unsigned long value, uint8_t base)
+{
+    char  buf[8 * sizeof(long) + 1];
+    char* str = &buf[sizeof(buf) - 1];
+    *str      = '\0';
+    if (base < 2) {
+        base = 10;
+    }
+    do {
+        char digit = static_cast<char>(value % base);
+        value /= base;
+        *--str = (digit < 10) ? (digit + '0') : (digit + 'A' - 10);
+    } while (value != 0);
+    return write(str);
+}
@@ -0,0 +1,66 @@
+#ifndef SIM_H_
+#define SIM_H_
+
+#include <stdint.h>
+#include <time.h>
+
+#include <string>
+
+// Control interface of the simulated Arduino HAL. Firmware code never includes this header, only host-side
+// benchmarks and tests do.
+//
+// Simulated time is not wall-clock time. It only moves when somebody calls AdvanceMicros() or when the HAL itself
+// models the cost of a blocking operation: analogRead() conversion, OneWire slots, I2C transactions to the RTC and
+// waiting for free space in the Serial TX buffer. So (micros() after Loop() - micros() before Loop()) is the time
+// real hardware would spend blocked inside the HAL, which is exactly what we want to profile.
+//
+// Interrupt handlers, which firmware defines with ISR(), are called from AdvanceMicros() at the simulated time when
+// their interrupt occurs, so they preempt firmware code exactly at the points where it blocks.
+namespace sim
+{
+// Approximate costs of blocking HAL operations on 16 MHz ATmega328P
+constexpr uint32_t kAnalogReadCostUs{112};
+constexpr uint32_t kAdcConversionUs{104};  // 13 ADC clocks at 125 kHz, conversion runs in background
+constexpr uint32_t kOneWireResetCostUs{960};
+constexpr uint32_t kOneWireSlotCostUs{70};
+constexpr uint32_t kRtcTransactionCostUs{1000};
+constexpr uint16_t kSerialBufferSize{64};
+
+// Drops all simulated state (clock, pins, EEPROM, serial buffers, OneWire devices, RTC)
+void Reset();
+
+uint64_t NowMicros();
+void     AdvanceMicros(uint64_t us);
+uint64_t SleptMicros();  // Total time, which firmware spent in sleep_cpu()
+
+// Analog inputs and outputs
+void     SetAnalogInput(uint8_t pin, uint16_t value);  // value is in range [0..1023]
+uint16_t GetAnalogOutput(uint8_t pin);
+uint8_t  GetDigitalOutput(uint8_t pin);
+
+// Serial port. Injected bytes arrive one by one with the speed configured by Serial.begin(), starting from the
+// current simulated time. Bytes which arrive while the RX buffer is full are lost, like on real hardware.
+void        SerialInject(const std::string& data);
+std::string SerialTakeOutput();
+uint32_t    SerialRxOverflows();
+
+// EEPROM (1 KB, erased state is 0xFF)
+constexpr uint16_t kEepromSize{1024};
+uint8_t  EepromRead(uint16_t address);
+uint32_t EepromWriteCount();
+
+// DS18B20 sensors on OneWire bus connected to given pin
+void AddDs18b20(uint8_t pin, const uint8_t (&rom)[8], float temperature);
+void SetDs18b20Temperature(const uint8_t (&rom)[8], float temperature);
+
+// DS1307 RTC. Time continues running from given value together with simulated clock. When firmware enables SQW
+// output through Wire, INT0 is raised at the start of each RTC second.
+void   SetRtcTime(time_t time);
+time_t GetRtcTime();
+
+// Number of heap allocations made by String
+uint32_t StringAllocations();
+
+}  // namespace sim
+
+#endif  // SIM_H_
@@ -0,0 +1,26 @@
+#ifndef SIM_INTERNAL_H_
+#define SIM_INTERNAL_H_
+
+#include <stdint.h>
+
+// Glue between parts of simulated HAL. Not for use in tests.
+namespace sim
+{
+namespace internal
+{
+void OnStringAllocation();
+
+void ResetPins();
+void ResetSerial();
+void ResetEeprom();
+void ResetOneWire();
+void ResetRtc();
+
+// Time of the first falling edge of DS1307 SQW output after <after_us>, or UINT64_MAX if output is disabled
+uint64_t GetNextRtcSqwEdge(uint64_t after_us);
+void     SetRtcControl(uint8_t control);
+
+}  // namespace internal
+}  // namespace sim
+
+#endif  // SIM_INTERNAL_H_
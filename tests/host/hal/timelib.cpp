@@ -0,0 +1,67 @@
+#include "TimeLib.h"
+
+namespace
+{
+constexpr uint8_t kMonthDays[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+bool
+IsLeapYear(uint16_t years_since_1970)
+{
+    uint16_t year = years_since_1970 + 1970;
+    return ((year % 4) == 0) && (((year % 100) != 0) || ((year % 400) == 0));
+}
+}  // namespace
+
+void
+breakTime(time_t time, tmElements_t& tm)
+{
+    uint32_t t = static_cast<uint32_t>(time);
+    tm.Second  = t % 60;
+    t /= 60;
+    tm.Minute = t % 60;
+    t /= 60;
+    tm.Hour = t % 24;
+    t /= 24;
+    tm.Wday = ((t + 4) % 7) + 1;  // Sunday is day 1
+
+    uint16_t year = 0;
+    uint32_t days = 0;
+    while ((days += (IsLeapYear(year) ? 366 : 365)) <= t) {
+        ++year;
+    }
+    tm.Year = static_cast<uint8_t>(year);
+    days -= IsLeapYear(year) ? 366 : 365;
+    t -= days;
+
+    uint8_t month = 0;
+    for (month = 0; month < 12; ++month) {
+        uint8_t month_length = ((month == 1) && IsLeapYear(year)) ? 29 : kMonthDays[month];
+        if (t >= month_length) {
+            t -= month_length;
+        }
+        else {
+            break;
+        }
+    }
+    tm.Month = month + 1;
+    tm.Day   = static_cast<uint8_t>(t + 1);
+}
+
+time_t
+makeTime(const tmElements_t& tm)
+{
+    uint32_t seconds = static_cast<uint32_t>(tm.Year) * (SECS_PER_DAY * 365);
+    for (uint16_t i = 0; i < tm.Year; ++i) {
+        if (IsLeapYear(i)) {
+            seconds += SECS_PER_DAY;
+        }
+    }
+    for (uint8_t i = 1; i < tm.Month; ++i) {
+        seconds += SECS_PER_DAY * (((i == 2) && IsLeapYear(tm.Year)) ? 29 : kMonthDays[i - 1]);
+    }
+    seconds += (tm.Day - 1) * SECS_PER_DAY;
+    seconds += tm.Hour * SECS_PER_HOUR;
+    seconds += tm.Minute * SECS_PER_MIN;
+    seconds += tm.Second;
+    return static_cast<time_t>(seconds);
+}
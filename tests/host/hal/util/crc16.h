@@ -0,0 +1,28 @@
+#ifndef UTIL_CRC16_H_
+#define UTIL_CRC16_H_
+
+#include <stdint.h>
+
+// CRC-8 with polynomial x^8 + x^2 + x + 1 (0x07) and initial value 0, the same as avr-libc's implementation
+static inline uint8_t
+_crc8_ccitt_update(uint8_t crc, uint8_t data)
+{
+    crc ^= data;
+    for (uint8_t i = 0; i < 8; ++i) {
+        crc = (crc & 0x80) ? static_cast<uint8_t>((crc << 1) ^ 0x07) : static_cast<uint8_t>(crc << 1);
+    }
+    return crc;
+}
+
+// CRC-16 with polynomial x^16 + x^15 + x^2 + 1 (0xA001 reflected), the same as avr-libc's implementation
+static inline uint16_t
+_crc16_update(uint16_t crc, uint8_t data)
+{
+    crc ^= data;
+    for (uint8_t i = 0; i < 8; ++i) {
+        crc = (crc & 1) ? static_cast<uint16_t>((crc >> 1) ^ 0xA001) : static_cast<uint16_t>(crc >> 1);
+    }
+    return crc;
+}
+
+#endif  // UTIL_CRC16_H_
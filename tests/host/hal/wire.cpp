@@ -0,0 +1,50 @@
+#include "Wire.h"
+
+#include "sim.h"
+#include "sim_internal.h"
+
+TwoWire Wire;
+
+namespace
+{
+constexpr uint8_t kDs1307Address{0x68};
+constexpr uint8_t kDs1307ControlRegister{0x07};
+}  // namespace
+
+void
+TwoWire::begin()
+{
+}
+
+void
+TwoWire::beginTransmission(uint8_t address)
+{
+    address_ = address;
+    length_  = 0;
+}
+
+size_t
+TwoWire::write(uint8_t data)
+{
+    if (length_ >= sizeof(data_)) {
+        return 0;
+    }
+    data_[length_++] = data;
+    return 1;
+}
+
+uint8_t
+TwoWire::endTransmission()
+{
+    sim::AdvanceMicros(sim::kRtcTransactionCostUs);
+    if (address_ != kDs1307Address) {
+        return 2;  // NACK on address
+    }
+    // The first byte is register pointer, next bytes are written to consecutive registers
+    for (uint8_t i = 1; i < length_; ++i) {
+        if (data_[0] + i - 1 == kDs1307ControlRegister) {
+            sim::internal::SetRtcControl(data_[i]);
+        }
+    }
+    return 0;
+}
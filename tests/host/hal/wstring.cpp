@@ -0,0 +1,441 @@
+#include "WString.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim_internal.h"
+
+namespace
+{
+void
+FormatInteger(char* buffer, size_t size, unsigned long value, unsigned char base, bool negative)
+{
+    char  tmp[33];
+    char* p = &tmp[sizeof(tmp) - 1];
+    *p      = 0;
+    do {
+        auto digit = static_cast<char>(value % base);
+        *--p       = (digit < 10) ? ('0' + digit) : ('A' + digit - 10);
+        value /= base;
+    } while (value != 0);
+    snprintf(buffer, size, "%s%s", negative ? "-" : "", p);
+}
+}  // namespace
+
+String::String(const char* cstr)
+{
+    if (cstr != nullptr) {
+        Copy(cstr, strlen(cstr));
+    }
+}
+
+String::String(const String& str)
+{
+    Copy(str.c_str(), str.length_);
+}
+
+String::String(String&& str)
+  : buffer_{str.buffer_}
+  , capacity_{str.capacity_}
+  , length_{str.length_}
+{
+    str.buffer_   = nullptr;
+    str.capacity_ = 0;
+    str.length_   = 0;
+}
+
+String::String(const __FlashStringHelper* str)
+  : String(reinterpret_cast<const char*>(str))
+{
+}
+
+String::String(char c)
+{
+    char buf[2] = {c, 0};
+    Copy(buf, 1);
+}
+
+String::String(unsigned char value, unsigned char base)
+  : String(static_cast<unsigned long>(value), base)
+{
+}
+
+String::String(int value, unsigned char base)
+  : String(static_cast<long>(value), base)
+{
+}
+
+String::String(unsigned int value, unsigned char base)
+  : String(static_cast<unsigned long>(value), base)
+{
+}
+
+String::String(long value, unsigned char base)
+{
+    char buf[34];
+    if ((base == 10) && (value < 0)) {
+        FormatInteger(buf, sizeof(buf), -static_cast<unsigned long>(value), base, true);
+    }
+    else {
+        FormatInteger(buf, sizeof(buf), static_cast<unsigned long>(value), base, false);
+    }
+    Copy(buf, strlen(buf));
+}
+
+String::String(unsigned long value, unsigned char base)
+{
+    char buf[34];
+    FormatInteger(buf, sizeof(buf), value, base, false);
+    Copy(buf, strlen(buf));
+}
+
+String::String(float value, unsigned char decimal_places)
+  : String(static_cast<double>(value), decimal_places)
+{
+}
+
+String::String(double value, unsigned char decimal_places)
+{
+    char buf[40];
+    snprintf(buf, sizeof(buf), "%.*f", decimal_places, value);
+    Copy(buf, strlen(buf));
+}
+
+String::~String()
+{
+    free(buffer_);
+}
+
+String&
+String::operator=(const String& rhs)
+{
+    if (this != &rhs) {
+        Copy(rhs.c_str(), rhs.length_);
+    }
+    return *this;
+}
+
+String&
+String::operator=(String&& rhs)
+{
+    if (this != &rhs) {
+        free(buffer_);
+        buffer_       = rhs.buffer_;
+        capacity_     = rhs.capacity_;
+        length_       = rhs.length_;
+        rhs.buffer_   = nullptr;
+        rhs.capacity_ = 0;
+        rhs.length_   = 0;
+    }
+    return *this;
+}
+
+String&
+String::operator=(const char* cstr)
+{
+    if (cstr == nullptr) {
+        Invalidate();
+    }
+    else {
+        Copy(cstr, strlen(cstr));
+    }
+    return *this;
+}
+
+String&
+String::operator=(const __FlashStringHelper* str)
+{
+    return *this = reinterpret_cast<const char*>(str);
+}
+
+bool
+String::concat(const String& str)
+{
+    return concat(str.c_str(), str.length_);
+}
+
+bool
+String::concat(const char* cstr)
+{
+    return (cstr != nullptr) && concat(cstr, strlen(cstr));
+}
+
+bool
+String::concat(const char* cstr, unsigned int length)
+{
+    if (length == 0) {
+        return true;
+    }
+    if (!Reserve(length_ + length)) {
+        return false;
+    }
+    memmove(buffer_ + length_, cstr, length);
+    length_ += length;
+    buffer_[length_] = 0;
+    return true;
+}
+
+bool
+String::concat(char c)
+{
+    return concat(&c, 1);
+}
+
+bool
+String::concat(const __FlashStringHelper* str)
+{
+    return concat(reinterpret_cast<const char*>(str));
+}
+
+String&
+String::operator+=(const String& rhs)
+{
+    concat(rhs);
+    return *this;
+}
+
+String&
+String::operator+=(const char* cstr)
+{
+    concat(cstr);
+    return *this;
+}
+
+String&
+String::operator+=(char c)
+{
+    concat(c);
+    return *this;
+}
+
+String
+operator+(const String& lhs, const String& rhs)
+{
+    String result{lhs};
+    result.concat(rhs);
+    return result;
+}
+
+String
+operator+(const String& lhs, const char* cstr)
+{
+    String result{lhs};
+    result.concat(cstr);
+    return result;
+}
+
+String
+operator+(const String& lhs, char c)
+{
+    String result{lhs};
+    result.concat(c);
+    return result;
+}
+
+String
+operator+(const String& lhs, const __FlashStringHelper* rhs)
+{
+    String result{lhs};
+    result.concat(rhs);
+    return result;
+}
+
+String
+operator+(const char* cstr, const String& rhs)
+{
+    String result{cstr};
+    result.concat(rhs);
+    return result;
+}
+
+unsigned int
+String::length() const
+{
+    return length_;
+}
+
+const char*
+String::c_str() const
+{
+    return (buffer_ != nullptr) ? buffer_ : "";
+}
+
+bool
+String::equals(const String& s) const
+{
+    return (length_ == s.length_) && (strcmp(c_str(), s.c_str()) == 0);
+}
+
+bool
+String::equals(const char* cstr) const
+{
+    return strcmp(c_str(), (cstr != nullptr) ? cstr : "") == 0;
+}
+
+bool
+String::operator==(const String& rhs) const
+{
+    return equals(rhs);
+}
+
+bool
+String::operator==(const char* cstr) const
+{
+    return equals(cstr);
+}
+
+bool
+String::operator!=(const String& rhs) const
+{
+    return !equals(rhs);
+}
+
+bool
+String::operator!=(const char* cstr) const
+{
+    return !equals(cstr);
+}
+
+bool
+String::startsWith(const String& prefix) const
+{
+    return (length_ >= prefix.length_) && (strncmp(c_str(), prefix.c_str(), prefix.length_) == 0);
+}
+
+char
+String::charAt(unsigned int index) const
+{
+    return (index < length_) ? buffer_[index] : 0;
+}
+
+char
+String::operator[](unsigned int index) const
+{
+    return charAt(index);
+}
+
+char&
+String::operator[](unsigned int index)
+{
+    static char dummy_writable_char;
+    if (index >= length_) {
+        dummy_writable_char = 0;
+        return dummy_writable_char;
+    }
+    return buffer_[index];
+}
+
+int
+String::indexOf(char ch) const
+{
+    return indexOf(ch, 0);
+}
+
+int
+String::indexOf(char ch, unsigned int from_index) const
+{
+    if (from_index >= length_) {
+        return -1;
+    }
+    const char* found = strchr(buffer_ + from_index, ch);
+    return (found == nullptr) ? -1 : static_cast<int>(found - buffer_);
+}
+
+String
+String::substring(unsigned int begin_index) const
+{
+    return substring(begin_index, length_);
+}
+
+String
+String::substring(unsigned int begin_index, unsigned int end_index) const
+{
+    if (begin_index > end_index) {
+        unsigned int tmp = end_index;
+        end_index        = begin_index;
+        begin_index      = tmp;
+    }
+    String result;
+    if (begin_index >= length_) {
+        return result;
+    }
+    if (end_index > length_) {
+        end_index = length_;
+    }
+    result.concat(buffer_ + begin_index, end_index - begin_index);
+    return result;
+}
+
+void
+String::trim()
+{
+    if (length_ == 0) {
+        return;
+    }
+    unsigned int begin = 0;
+    while ((begin < length_) && ((buffer_[begin] == ' ') || (buffer_[begin] == '\t') || (buffer_[begin] == '\r') ||
+                                 (buffer_[begin] == '\n'))) {
+        ++begin;
+    }
+    unsigned int end = length_;
+    while ((end > begin) && ((buffer_[end - 1] == ' ') || (buffer_[end - 1] == '\t') || (buffer_[end - 1] == '\r') ||
+                             (buffer_[end - 1] == '\n'))) {
+        --end;
+    }
+    length_ = end - begin;
+    memmove(buffer_, buffer_ + begin, length_);
+    buffer_[length_] = 0;
+}
+
+long
+String::toInt() const
+{
+    return atol(c_str());
+}
+
+float
+String::toFloat() const
+{
+    return static_cast<float>(atof(c_str()));
+}
+
+void
+String::Invalidate()
+{
+    free(buffer_);
+    buffer_   = nullptr;
+    capacity_ = 0;
+    length_   = 0;
+}
+
+bool
+String::Reserve(unsigned int size)
+{
+    if ((buffer_ != nullptr) && (capacity_ >= size)) {
+        return true;
+    }
+    auto new_buffer = static_cast<char*>(realloc(buffer_, size + 1));
+    if (new_buffer == nullptr) {
+        return false;
+    }
+    sim::internal::OnStringAllocation();
+    if (buffer_ == nullptr) {
+        new_buffer[0] = 0;
+    }
+    buffer_   = new_buffer;
+    capacity_ = size;
+    return true;
+}
+
+void
+String::Copy(const char* cstr, unsigned int length)
+{
+    if (!Reserve(length)) {
+        Invalidate();
+        return;
+    }
+    length_ = length;
+    memmove(buffer_, cstr, length);
+    buffer_[length_] = 0;
+}
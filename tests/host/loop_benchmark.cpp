@@ -0,0 +1,153 @@
+// Runs real LampController::Loop() against simulated HAL and reports how long main loop iterations take.
+//
+// Usage: loop_benchmark [iterations]
+//
+// Two measurements are made for each iteration:
+// - simulated time: time which ATmega328P would spend blocked inside HAL (OneWire, I2C, ADC, Serial TX). Time,
+//   which firmware sleeps until the next deadline, is not included;
+// - host time: how long host CPU executes firmware code. It is useful only for relative comparisons.
+// Firmware's own code is accounted as constant kLoopOverheadUs of simulated time per iteration.
+// At the end per-stage statistics of firmware itself are requested by "ESP: perf" command and printed.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <string>
+
+#include <lamp_controller.h>
+
+#include "hal/sim.h"
+
+namespace
+{
+constexpr uint32_t kLoopOverheadUs{20};
+constexpr uint32_t kEspRequestPeriodUs{500000};
+
+// The same sensors, as ThermoSensors has calibration data for
+constexpr uint8_t kSensor1[8] = {0x28, 0xB6, 0x16, 0x75, 0xD0, 0x01, 0x3C, 0xA2};
+constexpr uint8_t kSensor2[8] = {0x28, 0x7B, 0x22, 0x75, 0xD0, 0x01, 0x3C, 0xEC};
+
+// Requests, which ESP sends while WebUI is open
+const char* const kEspRequests[] = {"ESP: gt\n", "ESP: ga\n", "ESP: gb\n", "ESP: gsd\n"};
+
+struct Stats
+{
+    void
+    Add(uint64_t value)
+    {
+        min = (count == 0 || value < min) ? value : min;
+        max = (value > max) ? value : max;
+        sum += value;
+        ++count;
+    }
+
+    uint64_t min{0};
+    uint64_t max{0};
+    uint64_t sum{0};
+    uint64_t count{0};
+};
+
+void
+PrintStats(const char* name, const char* unit, const Stats& stats)
+{
+    printf("%-16s min %8llu %s, mean %10.1f %s, max %8llu %s\n",
+           name,
+           static_cast<unsigned long long>(stats.min),
+           unit,
+           (stats.count != 0) ? static_cast<double>(stats.sum) / stats.count : 0.0,
+           unit,
+           static_cast<unsigned long long>(stats.max),
+           unit);
+}
+
+size_t
+CountOccurrences(const std::string& str, const char* pattern)
+{
+    size_t count{0};
+    for (auto pos = str.find(pattern); pos != std::string::npos; pos = str.find(pattern, pos + 1)) {
+        ++count;
+    }
+    return count;
+}
+}  // namespace
+
+int
+main(int argc, char** argv)
+{
+    uint32_t iterations = (argc > 1) ? static_cast<uint32_t>(strtoul(argv[1], nullptr, 10)) : 100000;
+
+    sim::Reset();
+    sim::AddDs18b20(5, kSensor1, 25.0f);
+    sim::AddDs18b20(5, kSensor2, 26.0f);
+    sim::SetRtcTime(1577836800);  // 00:00:00 01/01/2020
+    sim::SetAnalogInput(A0, 0);   // Potentiometer in automatic mode
+
+    LampController lamp_controller;
+    lamp_controller.Setup();
+    sim::SerialTakeOutput();
+
+    Stats       simulated;
+    Stats       host;
+    uint32_t    slow_iterations{0};
+    uint32_t    requests_sent{0};
+    uint64_t    next_request_time = sim::NowMicros();
+    std::string output;
+
+    for (uint32_t i = 0; i < iterations; ++i) {
+        if (sim::NowMicros() >= next_request_time) {
+            sim::SerialInject(kEspRequests[requests_sent++ % (sizeof(kEspRequests) / sizeof(kEspRequests[0]))]);
+            next_request_time += kEspRequestPeriodUs;
+        }
+
+        auto sim_start   = sim::NowMicros();
+        auto slept_start = sim::SleptMicros();
+        auto host_start  = std::chrono::steady_clock::now();
+        lamp_controller.Loop();
+        auto host_end = std::chrono::steady_clock::now();
+        sim::AdvanceMicros(kLoopOverheadUs);
+        auto sim_delta = sim::NowMicros() - sim_start - (sim::SleptMicros() - slept_start);
+
+        simulated.Add(sim_delta);
+        host.Add(std::chrono::duration_cast<std::chrono::nanoseconds>(host_end - host_start).count());
+        if (sim_delta > 1000) {
+            ++slow_iterations;
+        }
+        output += sim::SerialTakeOutput();
+    }
+
+    auto acks = CountOccurrences(output, " ACK ");
+
+    // Let firmware finish pending replies, then request its own statistics
+    for (uint32_t i = 0; i < 10000; ++i) {
+        lamp_controller.Loop();
+        sim::AdvanceMicros(kLoopOverheadUs);
+    }
+    sim::SerialTakeOutput();
+    sim::SerialInject("ESP: perf\n");
+    std::string perf_output;
+    for (uint32_t i = 0; i < 10000; ++i) {
+        lamp_controller.Loop();
+        sim::AdvanceMicros(kLoopOverheadUs);
+        perf_output += sim::SerialTakeOutput();
+    }
+    printf("Iterations:      %u (%.3f s of simulated time)\n", iterations, sim::NowMicros() / 1000000.0);
+    PrintStats("Simulated loop:", "us", simulated);
+    PrintStats("Host loop:", "ns", host);
+    printf("Iterations > 1ms: %u\n", slow_iterations);
+    printf("ESP requests:    %u sent, %zu answered\n", requests_sent, acks);
+    printf("Serial RX overflows: %u\n", sim::SerialRxOverflows());
+    printf("String allocations: %u\n", sim::StringAllocations());
+    printf("Firmware statistics (stage count min mean max histogram):\n%s", perf_output.c_str());
+
+    // Smoke check: firmware should answer all requests except, may be, the last one
+    if (acks + 1 < requests_sent) {
+        fprintf(stderr, "ERROR: firmware did not answer ESP requests\n");
+        return 1;
+    }
+    if (perf_output.find("TOESP: perf ACK") == std::string::npos) {
+        fprintf(stderr, "ERROR: firmware did not answer perf request\n");
+        return 1;
+    }
+    return 0;
+}
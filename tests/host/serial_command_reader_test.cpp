@@ -0,0 +1,155 @@
+// Tests of binary framing of SerialCommandReader: CRC-8 check, resynchronization after damaged frame, replies.
+
+#include <string>
+
+#include <devices/serial_command_reader.h>
+
+#include "check.h"
+#include "hal/sim.h"
+
+namespace
+{
+using CommandType = SerialCommandReader::Command::CommandType;
+
+constexpr uint8_t  kStartOfFrame{0xA5};
+constexpr uint32_t kTimeoutUs{200000};
+
+// Reference implementation: polynomial 0x07, initial value 0, as protocol defines
+uint8_t
+Crc8(const std::string& data)
+{
+    uint8_t crc{0};
+    for (auto ch : data) {
+        crc ^= static_cast<uint8_t>(ch);
+        for (uint8_t bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x80) ? ((crc << 1) ^ 0x07) : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+std::string
+MakeFrame(CommandType type, uint8_t sequence_number, const std::string& payload)
+{
+    std::string frame{static_cast<char>(payload.size()), static_cast<char>(type), static_cast<char>(sequence_number)};
+    frame += payload;
+    frame += static_cast<char>(Crc8(frame));
+    return static_cast<char>(kStartOfFrame) + frame;
+}
+
+// Sends data and runs reader, until it has command or until timeout. Returns true, if command is ready
+bool
+Receive(SerialCommandReader& reader, const std::string& data)
+{
+    sim::SerialInject(data);
+    for (uint64_t end = sim::NowMicros() + kTimeoutUs; sim::NowMicros() < end; sim::AdvanceMicros(1000)) {
+        reader.Loop();
+        if (reader.IsCommandReady()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+TestValidFrame(SerialCommandReader& reader)
+{
+    CHECK(Receive(reader, MakeFrame(CommandType::SET_SUNRISE_DURATION, 7, std::string{"\x1E\x00", 2})));
+    auto command = reader.ReadCommand();
+    CHECK(command.is_binary);
+    CHECK(command.type == CommandType::SET_SUNRISE_DURATION);
+    CHECK_EQ(command.sequence_number, 7);
+    CHECK_EQ(command.arguments_length, 2);
+    CHECK_EQ(static_cast<uint8_t>(command.arguments[0]), 0x1E);
+    CHECK_EQ(static_cast<uint8_t>(command.arguments[1]), 0x00);
+}
+
+void
+TestCorruptedByteIsDropped(SerialCommandReader& reader)
+{
+    auto dropped_frames = reader.GetNumOfDroppedFrames();
+
+    // Every byte after the start of frame is covered by CRC
+    auto frame = MakeFrame(CommandType::SET_BRIGHTNESS, 8, std::string{"\x00\x02", 2});
+    for (size_t i = 1; i < frame.size(); ++i) {
+        auto corrupted = frame;
+        corrupted[i] ^= 0x10;
+        if (i == 1) {
+            // Damaged length makes frame longer, so its end is found only by inactivity timeout
+            corrupted += std::string(0x10, '\0');
+        }
+        CHECK(!Receive(reader, corrupted));
+    }
+    CHECK_EQ(reader.GetNumOfDroppedFrames() - dropped_frames, frame.size() - 1);
+
+    // Receiver is synchronized again at the next start of frame
+    CHECK(Receive(reader, MakeFrame(CommandType::GET_TIME, 9, "")));
+    auto command = reader.ReadCommand();
+    CHECK(command.type == CommandType::GET_TIME);
+    CHECK_EQ(command.sequence_number, 9);
+    CHECK_EQ(command.arguments_length, 0);
+}
+
+void
+TestFrameAfterDamagedFrame(SerialCommandReader& reader)
+{
+    // Valid frame follows the damaged one immediately, without gap
+    auto damaged = MakeFrame(CommandType::GET_ALARM, 10, std::string{"\x01", 1});
+    damaged[4] ^= 0x01;
+    CHECK(Receive(reader, damaged + MakeFrame(CommandType::GET_ALARM, 11, std::string{"\x02", 1})));
+    auto command = reader.ReadCommand();
+    CHECK(command.type == CommandType::GET_ALARM);
+    CHECK_EQ(command.sequence_number, 11);
+    CHECK_EQ(static_cast<uint8_t>(command.arguments[0]), 2);
+}
+
+void
+TestTooLongFrameIsDropped(SerialCommandReader& reader)
+{
+    auto dropped_frames = reader.GetNumOfDroppedFrames();
+    CHECK(!Receive(reader, std::string{static_cast<char>(kStartOfFrame), static_cast<char>(0xF0)}));
+    CHECK_EQ(reader.GetNumOfDroppedFrames() - dropped_frames, 1);
+
+    CHECK(Receive(reader, MakeFrame(CommandType::GET_BRIGHTNESS, 12, "")));
+    CHECK(reader.ReadCommand().type == CommandType::GET_BRIGHTNESS);
+}
+
+void
+TestTextLineInBinaryMode(SerialCommandReader& reader)
+{
+    CHECK(Receive(reader, "ESP: gsd\n"));
+    auto command = reader.ReadCommand();
+    CHECK(!command.is_binary);
+    CHECK(command.type == CommandType::GET_SUNRISE_DURATION);
+}
+
+void
+TestReply()
+{
+    SerialCommandReader::Command command{CommandType::GET_BRIGHTNESS, nullptr, 0, true, 13};
+    const uint8_t                payload[] = {1, 0x34, 0x12};
+    sim::SerialTakeOutput();
+    SerialCommandReader::WriteBinaryReply(command, SerialCommandReader::BinaryStatus::kOk, payload, sizeof(payload));
+
+    std::string expected{"\x04\x09\x0D\x00\x01\x34\x12", 7};
+    expected += static_cast<char>(Crc8(expected));
+    CHECK(sim::SerialTakeOutput() == static_cast<char>(kStartOfFrame) + expected);
+}
+}  // namespace
+
+int
+main()
+{
+    sim::Reset();
+    SerialCommandReader reader;
+    reader.Setup();
+    reader.SetBinaryModeEnabled(true);
+
+    TestValidFrame(reader);
+    TestCorruptedByteIsDropped(reader);
+    TestFrameAfterDamagedFrame(reader);
+    TestTooLongFrameIsDropped(reader);
+    TestTextLineInBinaryMode(reader);
+    TestReply();
+    return CheckResult();
+}
@@ -0,0 +1,229 @@
+// Tests of Telemetry encoding: samples are decoded from the dump, as ESP does it, and compared with recorded ones.
+
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+#include <response_writer.h>
+#include <telemetry.h>
+
+#include "check.h"
+#include "hal/sim.h"
+
+namespace
+{
+constexpr uint32_t kPeriodMs{10000};
+constexpr uint8_t  kNumOfValues{ThermoSensors::kMaxNumOfSensors + 4};
+constexpr uint8_t  kTimeBit{kNumOfValues};
+
+struct State
+{
+    uint32_t time_s;
+    uint16_t values[kNumOfValues];
+};
+
+class Source : public Telemetry::Source
+{
+public:
+    void
+    FillTelemetrySample(Telemetry::Sample& sample) override
+    {
+        sample = next;
+    }
+
+    Telemetry::Sample next;
+};
+
+State
+ToState(const Telemetry::Sample& sample)
+{
+    State state;
+    state.time_s = millis() / 1000;
+    for (uint8_t i = 0; i < ThermoSensors::kMaxNumOfSensors; ++i) {
+        state.values[i] = sample.temperatures[i];
+    }
+    state.values[ThermoSensors::kMaxNumOfSensors]     = sample.fan_speed;
+    state.values[ThermoSensors::kMaxNumOfSensors + 1] = sample.led_level;
+    state.values[ThermoSensors::kMaxNumOfSensors + 2] = sample.thermal_factor;
+    state.values[ThermoSensors::kMaxNumOfSensors + 3] = sample.mode;
+    return state;
+}
+
+// Reference decoder of "tm" reply: P N TIME V0 V1 ... V7 DATA
+class Decoder
+{
+public:
+    explicit Decoder(const std::string& dump)
+      : str_{dump.c_str()}
+    {
+    }
+
+    bool
+    Decode(std::vector<State>& states)
+    {
+        auto  period_s       = ReadNumber();
+        auto  num_of_samples = ReadNumber();
+        State state;
+        state.time_s = ReadNumber();
+        for (auto& value : state.values) {
+            value = ReadNumber();
+        }
+        while (*str_ != 0) {
+            data_.push_back(strtoul(std::string(str_, 2).c_str(), nullptr, 16));
+            str_ += 2;
+        }
+
+        for (uint32_t i = 0; i < num_of_samples; ++i) {
+            uint16_t mask = ReadVarint();
+            for (uint8_t bit = 0; bit < kNumOfValues; ++bit) {
+                if (mask & (1 << bit)) {
+                    state.values[bit] += UnZigZag(ReadVarint());
+                }
+            }
+            state.time_s += period_s;
+            if (mask & (1 << kTimeBit)) {
+                state.time_s += UnZigZag(ReadVarint());
+            }
+            states.push_back(state);
+        }
+        return position_ == data_.size();
+    }
+
+private:
+    uint32_t
+    ReadNumber()
+    {
+        char* end;
+        auto  value = strtoul(str_, &end, 10);
+        str_        = (*end == ' ') ? end + 1 : end;
+        return value;
+    }
+
+    uint16_t
+    ReadVarint()
+    {
+        uint32_t value{0};
+        for (uint8_t shift = 0; position_ < data_.size(); shift += 7) {
+            uint8_t byte = data_[position_++];
+            value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+        }
+        return value;
+    }
+
+    static int16_t
+    UnZigZag(uint16_t value)
+    {
+        return (value & 1) ? -static_cast<int16_t>(value >> 1) - 1 : static_cast<int16_t>(value >> 1);
+    }
+
+    const char*          str_;
+    std::vector<uint8_t> data_;
+    size_t               position_{0};
+};
+
+// Records samples and checks, that dump restores the newest of them
+void
+CheckRoundTrip(const std::vector<Telemetry::Sample>& samples, const std::vector<uint32_t>& gaps_ms)
+{
+    sim::Reset();
+    Source             source;
+    Telemetry          telemetry(source, kPeriodMs);
+    std::vector<State> recorded;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        sim::AdvanceMicros(((i < gaps_ms.size()) ? gaps_ms[i] : kPeriodMs) * 1000ULL);
+        source.next = samples[i];
+        telemetry.Run();
+        recorded.push_back(ToState(samples[i]));
+    }
+
+    sim::SerialTakeOutput();
+    ResponseWriter writer{Serial};
+    telemetry.Write(writer);
+    std::vector<State> decoded;
+    CHECK(Decoder(sim::SerialTakeOutput()).Decode(decoded));
+
+    CHECK(!decoded.empty());
+    CHECK(decoded.size() <= recorded.size());
+    auto offset = recorded.size() - decoded.size();
+    for (size_t i = 0; i < decoded.size(); ++i) {
+        const auto& expected = recorded[offset + i];
+        CHECK_EQ(decoded[i].time_s, expected.time_s);
+        for (uint8_t bit = 0; bit < kNumOfValues; ++bit) {
+            CHECK_EQ(decoded[i].values[bit], expected.values[bit]);
+        }
+    }
+}
+
+Telemetry::Sample
+MakeSample(Q8_8 temperature, uint8_t fan_speed, uint16_t led_level)
+{
+    return {{temperature, ThermoSensors::kInvalidTemperature, temperature, ThermoSensors::kInvalidTemperature},
+            fan_speed,
+            led_level,
+            kQ8_8One,
+            0};
+}
+
+// Deltas of all sizes: every varint length and both signs of zigzag, including the largest 16-bit steps
+void
+TestDeltas()
+{
+    const int32_t                  deltas[] = {0, 1, -1, 63, -64, 64, -65, 8191, -8192, 8192, -8193, 32767, -32768};
+    std::vector<Telemetry::Sample> samples;
+    Q8_8                           temperature{IntToQ8_8(25)};
+    uint16_t                       led_level{0};
+    for (auto delta : deltas) {
+        temperature += delta;
+        led_level -= delta;
+        samples.push_back(MakeSample(temperature, static_cast<uint8_t>(delta), led_level));
+    }
+    CheckRoundTrip(samples, {});
+}
+
+// Values wrap around, so a delta is the shortest way between any two 16-bit values
+void
+TestWrapAround()
+{
+    std::vector<Telemetry::Sample> samples;
+    const uint16_t                 levels[] = {0, 0xFFFF, 0, 0x8000, 0x7FFF, 0xFFFF, 0x8001, 1};
+    for (auto level : levels) {
+        samples.push_back(MakeSample(static_cast<Q8_8>(level), 0, level));
+    }
+    CheckRoundTrip(samples, {});
+}
+
+// Late and early samples store time delta
+void
+TestTimeDeltas()
+{
+    std::vector<Telemetry::Sample> samples(8, MakeSample(IntToQ8_8(30), 100, 1000));
+    CheckRoundTrip(samples, {kPeriodMs, kPeriodMs + 1000, kPeriodMs - 3000, 600000, kPeriodMs, 1000});
+}
+
+// When buffer is full, the oldest samples are dropped, and the rest are still decoded from updated base state
+void
+TestOldSamplesAreDropped()
+{
+    std::vector<Telemetry::Sample> samples;
+    for (uint16_t i = 0; i < 500; ++i) {
+        samples.push_back(MakeSample(IntToQ8_8(25) + rand() % 512, rand() % 256, rand()));
+    }
+    CheckRoundTrip(samples, {});
+}
+}  // namespace
+
+int
+main()
+{
+    srand(1);
+    TestDeltas();
+    TestWrapAround();
+    TestTimeDeltas();
+    TestOldSamplesAreDropped();
+    return CheckResult();
+}
@@ -0,0 +1,103 @@
+// Tests of PID fan control of ThermalController: integral term doesn't wind up, while fan speed is saturated.
+
+#include <devices/fan.h>
+#include <devices/led_driver.h>
+#include <devices/thermalcontroller.hpp>
+#include <devices/thermosensors.hpp>
+#include <perf_monitor.h>
+#include <scheduler.h>
+
+#include "check.h"
+#include "hal/sim.h"
+
+namespace
+{
+constexpr uint8_t kSensorsPin{5};
+// Sensor without calibration data, so temperature is reported as is
+constexpr uint8_t kSensor[8] = {0x28, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x9E};
+
+// P, I and D are 16 per C, 1 per C per second, and none
+constexpr ThermalController::FanControlSettings kPidSettings{
+    IntToQ8_8(35), IntToQ8_8(16), IntToQ8_8(1), 0, 0, ThermalController::FanControlMode::kPid};
+
+struct Lamp
+{
+    Lamp()
+      : scheduler(perf_monitor)
+      , led_driver(9, 8000)
+      , fan(3, Pwm::PWMSpeed::HZ_31372)
+      , thermo_sensors(kSensorsPin)
+      , thermal_controller(thermo_sensors, fan, led_driver)
+    {
+        led_driver.Setup();
+        fan.Setup();
+        thermo_sensors.Setup();
+        scheduler.AddTask(&thermo_sensors, PerfMonitor::Stage::kThermoSensors, thermo_sensors.GetPeriodMs());
+        scheduler.AddTask(&thermal_controller, PerfMonitor::Stage::kThermalController);
+    }
+
+    // Keeps temperature for given time
+    void
+    Run(float temperature, uint32_t seconds)
+    {
+        sim::SetDs18b20Temperature(kSensor, temperature);
+        for (uint64_t end = sim::NowMicros() + seconds * 1000000ULL; sim::NowMicros() < end;) {
+            scheduler.Loop();
+            sim::AdvanceMicros(1000);
+        }
+        sim::SerialTakeOutput();
+    }
+
+    PerfMonitor       perf_monitor;
+    Scheduler         scheduler;
+    LedDriver         led_driver;
+    FanPWM            fan;
+    ThermoSensors     thermo_sensors;
+    ThermalController thermal_controller;
+};
+
+void
+TestNoWindupAtFullSpeed()
+{
+    sim::Reset();
+    sim::AddDs18b20(kSensorsPin, kSensor, 35.0f);
+    Lamp lamp;
+    CHECK(lamp.thermal_controller.SetFanControl(kPidSettings));
+    lamp.Run(35.0f, 5);
+
+    // Error 7 C: proportional term is 112, integral reaches the rest of full speed in ~20 s and then stops growing
+    lamp.Run(42.0f, 300);
+    CHECK_EQ(lamp.thermal_controller.GetFanSpeed(), 255);
+
+    // Error -1 C: with wound up integral fan would stay near full speed for minutes
+    lamp.Run(34.0f, 5);
+    CHECK(lamp.thermal_controller.GetFanSpeed() > 100);
+    CHECK(lamp.thermal_controller.GetFanSpeed() < 160);
+}
+
+void
+TestNoWindupWhenStopped()
+{
+    sim::Reset();
+    sim::AddDs18b20(kSensorsPin, kSensor, 35.0f);
+    Lamp lamp;
+    CHECK(lamp.thermal_controller.SetFanControl(kPidSettings));
+    lamp.Run(35.0f, 5);
+
+    // Error -10 C: fan is stopped, and integral should not go down to -255
+    lamp.Run(25.0f, 600);
+    CHECK_EQ(lamp.thermal_controller.GetFanSpeed(), 0);
+
+    // Error 2 C: proportional term alone is 32
+    lamp.Run(37.0f, 5);
+    CHECK(lamp.thermal_controller.GetFanSpeed() >= 32);
+}
+}  // namespace
+
+int
+main()
+{
+    TestNoWindupAtFullSpeed();
+    TestNoWindupWhenStopped();
+    return CheckResult();
+}
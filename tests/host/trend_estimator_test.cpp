@@ -0,0 +1,122 @@
+// Tests of TrendEstimator: its slope is compared with least squares fit calculated in floating point.
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <trend_estimator.h>
+
+#include "check.h"
+
+namespace
+{
+// Slope of least squares line through samples, which are ordered from the oldest one
+double
+ReferenceSlope(const Q8_8* samples, uint8_t size)
+{
+    double mean_x{(size - 1) / 2.0};
+    double mean_y{0};
+    for (uint8_t i = 0; i < size; ++i) {
+        mean_y += samples[i];
+    }
+    mean_y /= size;
+
+    double covariance{0};
+    double variance{0};
+    for (uint8_t i = 0; i < size; ++i) {
+        covariance += (i - mean_x) * (samples[i] - mean_y);
+        variance += (i - mean_x) * (i - mean_x);
+    }
+    return covariance / variance;
+}
+
+// Reciprocal of divisor is rounded, so error grows with slope
+bool
+IsClose(Q8_8 slope, double reference)
+{
+    return fabs(slope - reference) <= 1 + fabs(reference) / 256;
+}
+
+template <uint8_t Size>
+void
+TestLinearRamp(Q8_8 start, Q8_8 slope)
+{
+    TrendEstimator<Size> estimator;
+    for (uint8_t i = 0; i < Size; ++i) {
+        CHECK(!estimator.IsReady());
+        CHECK_EQ(estimator.GetSlope(), 0);
+        estimator.AddSample(start + slope * i);
+    }
+    CHECK(estimator.IsReady());
+    CHECK(IsClose(estimator.GetSlope(), slope));
+}
+
+// Window slides over random samples, so every position of the oldest sample in the ring is checked
+template <uint8_t Size>
+void
+TestRandomSamples(Q8_8 amplitude)
+{
+    Q8_8                 samples[Size * 4];
+    TrendEstimator<Size> estimator;
+    for (uint8_t i = 0; i < Size * 4; ++i) {
+        samples[i] = IntToQ8_8(30) + rand() % (2 * amplitude + 1) - amplitude;
+        estimator.AddSample(samples[i]);
+        if (i + 1 < Size) {
+            continue;
+        }
+        CHECK(IsClose(estimator.GetSlope(), ReferenceSlope(samples + i + 1 - Size, Size)));
+    }
+}
+
+void
+TestReset()
+{
+    TrendEstimator<4> estimator;
+    for (uint8_t i = 0; i < 4; ++i) {
+        estimator.AddSample(IntToQ8_8(i));
+    }
+    CHECK_EQ(estimator.GetSlope(), IntToQ8_8(1));
+
+    // Samples before reset don't affect the slope
+    estimator.Reset();
+    CHECK(!estimator.IsReady());
+    for (uint8_t i = 0; i < 4; ++i) {
+        estimator.AddSample(IntToQ8_8(10 - i));
+    }
+    CHECK_EQ(estimator.GetSlope(), IntToQ8_8(-1));
+}
+
+// The largest possible weighted sum doesn't overflow
+void
+TestExtremeSamples()
+{
+    const Q8_8        samples[] = {INT16_MIN, INT16_MIN, INT16_MAX, INT16_MAX, INT16_MIN, INT16_MIN};
+    TrendEstimator<4> estimator;
+    for (uint8_t i = 0; i < sizeof(samples) / sizeof(samples[0]); ++i) {
+        estimator.AddSample(samples[i]);
+        if (i >= 3) {
+            CHECK(IsClose(estimator.GetSlope(), ReferenceSlope(samples + i - 3, 4)));
+        }
+    }
+}
+}  // namespace
+
+int
+main()
+{
+    TestLinearRamp<4>(IntToQ8_8(25), 3);
+    TestLinearRamp<8>(IntToQ8_8(25), 3);
+    TestLinearRamp<8>(IntToQ8_8(60), -IntToQ8_8(2));
+    TestLinearRamp<8>(IntToQ8_8(-10), IntToQ8_8(1) / 16);
+    TestLinearRamp<16>(IntToQ8_8(0), IntToQ8_8(1));
+    TestLinearRamp<16>(IntToQ8_8(40), 0);
+
+    srand(1);
+    TestRandomSamples<5>(IntToQ8_8(2));
+    TestRandomSamples<8>(IntToQ8_8(1));
+    TestRandomSamples<8>(IntToQ8_8(100));
+    TestRandomSamples<16>(IntToQ8_8(50));
+
+    TestReset();
+    TestExtremeSamples();
+    return CheckResult();
+}
@@ -10,11 +10,9 @@ main()
     ThermalController thermal_controller(sensors, fan, led_driver);
 
     while (true) {
-        float temperatures[2];
-        sensors.GetTemperatures(temperatures);
-        std::cout << "T = " << temperatures[0]
+        std::cout << "T = " << sensors.GetTemperature(0) / static_cast<float>(kQ8_8One)
                   << "; FanSpeed = " << std::to_string(((float)fan.GetSpeed() / 255.0) * 100)
-                  << "; ThermalFactor = " << std::to_string(led_driver.SetThermalFactor()) << std::endl;
+                  << "; ThermalFactor = " << std::to_string(led_driver.SetThermalFactor() / static_cast<float>(kQ8_8One)) << std::endl;
         std::cout << "Enter T (0 - exit): ";
 
         float t;
@@ -25,7 +23,7 @@ main()
             return 0;
         }
         sensors.SetTemperature(t);
-        thermal_controller.Loop();
+        thermal_controller.Run();
     }
 
     return 0;
@@ -7,10 +7,16 @@
 #include <iostream>
 #include <string>
 
+#include "../../src/fixed_point.h"
+
 #define PROGMEM
 #define F(x)    (x)
 #define PSTR(x) (x)
 
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+
+#define constrain(value, low, high) ((value) < (low) ? (low) : ((value) > (high) ? (high) : (value)))
+
 struct String
 {
     String()
@@ -58,24 +64,33 @@ class ThermoSensors
 public:
     ThermoSensors() = default;
     void
-    GetTemperatures(float (&temperatures)[2]) const
+    SetAttentionTemperature(Q8_8 /*temperature*/)
+    {
+    }
+    uint8_t
+    GetNumOfSensors() const
+    {
+        return 2;
+    }
+    Q8_8
+    GetTemperature(uint8_t /*index*/) const
     {
-        temperatures[0] = t_;
-        temperatures[0] = t_;
+        return t_;
     }
     void
     SetTemperature(float T)
     {
-        t_ = T;
+        t_ = static_cast<Q8_8>(T * kQ8_8One);
     }
     void
     Loop()
     {
     }
-    constexpr static float kInvalidTemperature = -127;
+    constexpr static uint8_t kMaxNumOfSensors    = 4;
+    constexpr static Q8_8    kInvalidTemperature = IntToQ8_8(-127);
 
 private:
-    float t_{20.0};
+    Q8_8 t_{IntToQ8_8(20)};
 };
 
 class FanPWM
@@ -103,32 +118,47 @@ class LedDriver
 public:
     LedDriver() = default;
     void
-    SetThermalFactor(float k)
+    SetThermalFactor(Q8_8 k)
     {
         thermal_factor_ = k;
     }
-    float
+    Q8_8
     SetThermalFactor() const
     {
         return thermal_factor_;
     }
+    uint16_t
+    GetOutputLevel() const
+    {
+        return (0xFFFFL * thermal_factor_) >> 8;
+    }
 
 private:
-    float thermal_factor_{1.0};
+    Q8_8 thermal_factor_{kQ8_8One};
 };
 
 struct SerialType
 {
+    static void
+    print(std::string const& str)
+    {
+        std::cout << str;
+    }
     static void
     println(std::string const& str)
     {
         std::cout << str << std::endl;
     }
+    static void
+    println(int value)
+    {
+        std::cout << value << std::endl;
+    }
 };
 extern SerialType Serial;
 
-static float
-max(float l, float r)
+static Q8_8
+max(Q8_8 l, Q8_8 r)
 {
     return std::max(l, r);
 }